@@ -0,0 +1,39 @@
+#pragma once
+
+// ベンチマーク用のマクロ一覧を作る
+// 実際の設定に近い形（修飾キー + 文字キー + ファンクションキーのホットキー、ところどころにホットストリング、
+// COMBO / TEXT / WAIT / RAW が1～6個）のマクロを、決まった乱数の種から作ります。
+
+#include <string>
+#include <vector>
+
+#include "bench/bench_util.h"
+#include "engine/macro_engine.h"
+
+inline std::vector<Macro> MakeBenchMacros(size_t count, BenchRandom& rng) {
+    std::vector<Macro> macros(count);
+    for (size_t n = 0; n < count; n++) {
+        Macro& m = macros[n];
+        m.hotkeys.push_back(VKC_CONTROL);
+        m.hotkeys.push_back((VkCode)('A' + n % 26));
+        m.hotkeys.push_back((VkCode)(0x70 + (n / 26) % 12));
+        if (n % 16 == 0) m.hotstring = ";abbr" + std::to_string(n);
+        if (n % 5 == 0) m.concurrency = CONCURRENCY_QUEUE_ONE;
+        for (uint32_t i = 1 + rng.Below(6); i > 0; i--) {
+            MacroAction a;
+            a.type = (MacroActionType)rng.Below(4);
+            a.waitMs = 0;
+            if (a.type == ACTION_COMBO) {
+                a.comboKeys = { VKC_CONTROL, (VkCode)('A' + rng.Below(26)) };
+            } else if (a.type == ACTION_TEXT) {
+                a.text = "line " + std::to_string(i) + ", with comma\nand newline あいう";
+            } else if (a.type == ACTION_WAIT) {
+                a.waitMs = (int)rng.Below(1000);
+            } else {
+                for (uint32_t k = 0; k < 6; k++) a.rawEvents.push_back({ (VkCode)('A' + k), (uint8_t)(k % 2), 0, k * 7 });
+            }
+            m.actions.push_back(a);
+        }
+    }
+    return macros;
+}
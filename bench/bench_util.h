@@ -0,0 +1,44 @@
+#pragma once
+
+// ベンチマーク用の小さな道具
+// 各ベンチマークは1つの実行ファイルで、結果を表にして標準出力に書きます。
+// 引数に --quick を付けると規模を小さくして短時間で終わらせます（ctest で動作だけ確かめる用）。
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+inline bool BenchQuickMode(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) return true;
+    }
+    return false;
+}
+
+inline int64_t BenchNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 最適化で計算が消されないよう、結果をここに捨てる
+inline void BenchKeep(uint64_t value) {
+    static volatile uint64_t sink;
+    sink = sink + value;
+}
+
+// 決まった種から作る乱数（実行ごとに同じ入力で測る）
+class BenchRandom {
+public:
+    explicit BenchRandom(uint64_t seed) : state_(seed ? seed : 1) {}
+    uint64_t Next() {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return state_;
+    }
+    // [0, n)
+    uint32_t Below(uint32_t n) { return (uint32_t)(Next() % n); }
+
+private:
+    uint64_t state_;
+};
@@ -0,0 +1,93 @@
+// マクロ実行の送信イベント数/秒を、実行のたびにアクション列を変換する場合と、
+// 変換済みの EventStream をたどるだけの場合とで比べる
+//   compile+run : 毎回 CompileActions してから実行する（変換を実行時に行っていた以前のやり方に相当）
+//   run         : 読み込み・編集時に一度だけ変換した EventStream を実行する (MacroExecutor と同じ)
+// 送信先は何もしないシンク、時計は眠らない時計なので、待ち時間を除いた CPU 側の手間だけを測ります。
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bench/bench_util.h"
+#include "engine/key_state.h"
+#include "engine/macro_engine.h"
+#include "tests/fake_clock.h"
+
+// 受け取ったイベント数を数えるだけのシンク
+class CountingInputSink : public IInputSink {
+public:
+    void Send(const InputEvent* events, size_t count) override {
+        events_ += count;
+        if (count > 0) BenchKeep(events[count - 1].code);
+    }
+    uint64_t events_ = 0;
+};
+
+struct Workload {
+    const char* name;
+    std::vector<MacroAction> actions;
+};
+
+// ASCII とひらがなを混ぜた chars 文字の文字列 (UTF-8)
+static std::string MakeText(size_t chars) {
+    std::string text;
+    for (size_t i = 0; i < chars; i++) {
+        if (i % 4 == 3) text += "\xE3\x81\x82"; // "あ"
+        else text += (char)('a' + i % 26);
+    }
+    return text;
+}
+
+static std::vector<Workload> MakeWorkloads() {
+    std::vector<Workload> workloads(3);
+    workloads[0].name = "combo x4";
+    for (int i = 0; i < 4; i++) workloads[0].actions.push_back({ ACTION_COMBO, { VKC_CONTROL, VKC_SHIFT, (VkCode)('A' + i) }, "", 0 });
+    workloads[1].name = "text 100";
+    workloads[1].actions.push_back({ ACTION_TEXT, {}, MakeText(100), 0 });
+    workloads[2].name = "mixed 1000";
+    for (int i = 0; i < 10; i++) {
+        workloads[2].actions.push_back({ ACTION_COMBO, { VKC_CONTROL, 'V' }, "", 0 });
+        workloads[2].actions.push_back({ ACTION_TEXT, {}, MakeText(100), 0 });
+    }
+    return workloads;
+}
+
+// runs 回実行したときの 送信イベント数/秒
+static double Measure(const std::vector<MacroAction>& actions, bool precompiled, size_t runs) {
+    CountingInputSink sink;
+    KeyStateBitmap keys;
+    FakeMacroClock clock;
+    ExecutionEnv env = { &sink, &keys, &clock, nullptr };
+
+    EventStream compiled;
+    CompileActions(actions, compiled);
+
+    int64_t start = BenchNowNs();
+    for (size_t i = 0; i < runs; i++) {
+        if (precompiled) {
+            ExecuteEventStream(compiled, env);
+        } else {
+            EventStream stream;
+            CompileActions(actions, stream);
+            ExecuteEventStream(stream, env);
+        }
+    }
+    double seconds = (double)(BenchNowNs() - start) / 1e9;
+    return sink.events_ / seconds;
+}
+
+int main(int argc, char** argv) {
+    const bool quick = BenchQuickMode(argc, argv);
+    const size_t kRuns = quick ? 200 : 20000;
+
+    std::printf("events per second (null sink, no sleeping)\n");
+    std::printf("%12s %8s %14s %14s %8s\n", "macro", "events", "compile+run", "run", "ratio");
+    for (const Workload& w : MakeWorkloads()) {
+        EventStream stream;
+        CompileActions(w.actions, stream);
+        double before = Measure(w.actions, false, kRuns);
+        double after = Measure(w.actions, true, kRuns);
+        std::printf("%12s %8zu %14.0f %14.0f %8.2f\n", w.name, stream.events.size(), before, after, after / before);
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+// 押されたキー1回あたりのホットキー判定の時間を、登録マクロ数ごとに比べる
+//   scan  : 全マクロを順に調べる (FindTriggeredMacro。以前のフックと同じやり方)
+//   index : 発動キーの索引から候補だけを調べる (HotkeyIndex::FindTriggered)
+// hit はホットキーになっている文字キー、miss はどのマクロにも含まれない数字キーを押したとき。
+// 普段の入力のほとんどは miss で、このときの時間がすべてのキー入力に上乗せされます。
+
+#include <cstdio>
+#include <vector>
+
+#include "bench/bench_util.h"
+#include "engine/hotkey_index.h"
+#include "engine/key_state.h"
+
+// 修飾キー0～2個 + 文字キー1つのホットキーを count 個作る
+static std::vector<Macro> MakeMacros(size_t count, BenchRandom& rng) {
+    static const VkCode modifiers[] = { VKC_CONTROL, VKC_SHIFT, VKC_MENU, VKC_LCONTROL };
+    std::vector<Macro> macros(count);
+    for (Macro& m : macros) {
+        uint32_t modCount = rng.Below(3);
+        for (uint32_t i = 0; i < modCount; i++) m.hotkeys.push_back(modifiers[rng.Below(4)]);
+        m.hotkeys.push_back((VkCode)('A' + rng.Below(26)));
+        m.actions.push_back({ ACTION_COMBO, { 'X' }, "", 0 });
+    }
+    return macros;
+}
+
+struct Timing {
+    double scanNs;
+    double indexNs;
+};
+
+// 左 Ctrl を押したまま pressed のキーを順に押したときの、1回あたりの時間
+static Timing Measure(const std::vector<Macro>& macros, const HotkeyIndex& index, const std::vector<VkCode>& pressed) {
+    KeyStateBitmap keys;
+    keys.OnKeyEvent(VKC_LCONTROL, true);
+    uint64_t found = 0;
+
+    int64_t start = BenchNowNs();
+    for (VkCode vk : pressed) found += FindTriggeredMacro(macros, vk, keys) != nullptr;
+    Timing t;
+    t.scanNs = (double)(BenchNowNs() - start) / pressed.size();
+
+    // フックと同じく、押されたキーを含めた押下状態で引く
+    const KeyMask held = keys.Snapshot();
+    start = BenchNowNs();
+    for (VkCode vk : pressed) {
+        KeyMask now = held;
+        now.Set(vk);
+        found += index.FindTriggered(vk, now) >= 0;
+    }
+    t.indexNs = (double)(BenchNowNs() - start) / pressed.size();
+
+    BenchKeep(found);
+    return t;
+}
+
+int main(int argc, char** argv) {
+    const bool quick = BenchQuickMode(argc, argv);
+    const size_t counts[] = { 10, 100, 1000, 10000 };
+    const size_t kEvents = quick ? 2000 : 200000;
+
+    std::printf("ns per key press (left Ctrl held)\n");
+    std::printf("%8s %12s %12s %12s %12s\n", "macros", "hit scan", "hit index", "miss scan", "miss index");
+    for (size_t count : counts) {
+        BenchRandom rng(count);
+        std::vector<Macro> macros = MakeMacros(count, rng);
+        HotkeyIndex index;
+        index.Build(macros);
+
+        std::vector<VkCode> hits(kEvents), misses(kEvents);
+        for (VkCode& vk : hits) vk = (VkCode)('A' + rng.Below(26));
+        for (VkCode& vk : misses) vk = (VkCode)('0' + rng.Below(10));
+
+        Timing hit = Measure(macros, index, hits);
+        Timing miss = Measure(macros, index, misses);
+        std::printf("%8zu %12.1f %12.1f %12.1f %12.1f\n", count, hit.scanNs, hit.indexNs, miss.scanNs, miss.indexNs);
+    }
+    return 0;
+}
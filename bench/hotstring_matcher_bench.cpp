@@ -0,0 +1,92 @@
+// ホットストリングの照合 (HotstringMatcher) の作成時間と1文字あたりの時間を、パターン数ごとに測る
+//   build : Build で Aho-Corasick の遷移表を作る時間
+//   dfa   : Advance で1文字進める時間（フックがキー入力ごとに行う処理）
+//   scan  : 入力履歴の末尾を全パターンと比べる素朴な照合（比較用。同じ結果になることも確かめる）
+// パターンは少ない文字種から作り、互いに重なり合う（あるパターンが別のパターンの途中で終わる）ようにします。
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bench/bench_util.h"
+#include "engine/hotstring_matcher.h"
+
+static char Lower(char c) { return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c; }
+
+// 素朴な照合: history の末尾で終わる最長のパターン（同じ長さなら先のマクロ）の番号
+static int ScanMatch(const std::vector<Macro>& macros, const std::string& history) {
+    int best = -1;
+    size_t bestLength = 0;
+    for (size_t i = 0; i < macros.size(); i++) {
+        const std::string& p = macros[i].hotstring;
+        if (p.size() > history.size() || p.size() <= bestLength) continue;
+        size_t offset = history.size() - p.size();
+        size_t k = 0;
+        while (k < p.size() && Lower(history[offset + k]) == Lower(p[k])) k++;
+        if (k == p.size()) {
+            best = (int)i;
+            bestLength = p.size();
+        }
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    const bool quick = BenchQuickMode(argc, argv);
+    const size_t counts[] = { 100, 1000, 10000 };
+    const size_t kChars = quick ? 20000 : 2000000;
+    const size_t kScanChars = quick ? 2000 : 20000;
+    static const char alphabet[] = "abcdefghij;";
+    const uint32_t kAlphabet = sizeof(alphabet) - 1;
+
+    std::printf("%8s %8s %10s %10s %10s %8s\n", "patterns", "states", "build ms", "dfa ns", "scan ns", "matches");
+    for (size_t count : counts) {
+        BenchRandom rng(count);
+        std::vector<Macro> macros(count);
+        for (Macro& m : macros) {
+            for (uint32_t n = 3 + rng.Below(6); n > 0; n--) m.hotstring += alphabet[rng.Below(kAlphabet)];
+            if (rng.Below(4) == 0) m.hotstring[0] = (char)(m.hotstring[0] - 'a' + 'A'); // 大文字と小文字は区別しない
+        }
+
+        // 入力: ランダムな文字の間に、ときどきパターンそのものを混ぜる
+        std::string input;
+        while (input.size() < kChars) {
+            if (rng.Below(8) == 0) input += macros[rng.Below((uint32_t)count)].hotstring;
+            else input += alphabet[rng.Below(kAlphabet)];
+        }
+
+        HotstringMatcher matcher;
+        int64_t start = BenchNowNs();
+        matcher.Build(macros);
+        double buildMs = (BenchNowNs() - start) / 1e6;
+
+        uint32_t state = HotstringMatcher::kRootState;
+        uint64_t matches = 0;
+        start = BenchNowNs();
+        for (char c : input) matches += matcher.Advance(state, (char16_t)(unsigned char)c) >= 0;
+        double dfaNs = (double)(BenchNowNs() - start) / input.size();
+
+        // 素朴な照合は時間がかかるので先頭の一部だけで測り、DFA と結果を突き合わせる
+        std::vector<int> expected(kScanChars);
+        std::string history;
+        start = BenchNowNs();
+        for (size_t i = 0; i < kScanChars; i++) {
+            history += input[i];
+            expected[i] = ScanMatch(macros, history);
+        }
+        double scanNs = (double)(BenchNowNs() - start) / kScanChars;
+
+        state = HotstringMatcher::kRootState;
+        for (size_t i = 0; i < kScanChars; i++) {
+            int got = matcher.Advance(state, (char16_t)(unsigned char)input[i]);
+            if (got != expected[i]) {
+                std::printf("mismatch at %zu: dfa %d, scan %d\n", i, got, expected[i]);
+                return 1;
+            }
+        }
+        BenchKeep(matches);
+        std::printf("%8zu %8zu %10.2f %10.1f %10.1f %8llu\n", count, matcher.StateCount(), buildMs, dfaNs, scanNs,
+                    (unsigned long long)matches);
+    }
+    return 0;
+}
@@ -0,0 +1,62 @@
+// 起動時の読み込み時間を、設定ファイルを解析する場合とキャッシュを読む場合とで比べる
+//   parse : ParseMacros + BuildMacroTable（キャッシュが無いか古いとき。LoadMacrosCached の後半と同じ）
+//   cache : HashMacroSource + ReadMacroCache（キャッシュが使えるとき。メモリマップした領域の代わりに
+//           メモリ上のバッファから読む。ファイルのマップにかかる時間は含まない）
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bench/bench_macros.h"
+#include "bench/bench_util.h"
+#include "engine/macro_cache.h"
+#include "engine/macro_file.h"
+#include "engine/macro_table.h"
+
+int main(int argc, char** argv) {
+    const bool quick = BenchQuickMode(argc, argv);
+    const size_t counts[] = { 1000, 10000, 20000 };
+    const int kRepeats = quick ? 1 : 5;
+
+    std::printf("startup load (best of %d)\n", kRepeats);
+    std::printf("%8s %10s %10s %10s %10s %10s\n", "macros", "source KB", "cache KB", "parse ms", "cache ms", "ratio");
+    for (size_t count : counts) {
+        if (quick && count > 1000) break;
+        BenchRandom rng(count);
+        std::string source = SerializeMacros(MakeBenchMacros(count, rng));
+        MacroCacheKey key = { source.size(), 0, HashMacroSource(source.data(), source.size()) };
+
+        std::vector<Macro> macros;
+        ParseMacros(source.data(), source.size(), macros);
+        std::unique_ptr<MacroTable> table = BuildMacroTable(macros);
+        std::string cache = BuildMacroCache(key, macros, table->macros);
+
+        double parseMs = 1e30, cacheMs = 1e30;
+        for (int r = 0; r < kRepeats; r++) {
+            std::vector<Macro> parsed;
+            int64_t start = BenchNowNs();
+            ParseMacros(source.data(), source.size(), parsed);
+            std::unique_ptr<MacroTable> built = BuildMacroTable(parsed);
+            double ms = (BenchNowNs() - start) / 1e6;
+            if (ms < parseMs) parseMs = ms;
+            BenchKeep(built->macros.size());
+
+            std::vector<Macro> cached;
+            std::unique_ptr<MacroTable> read;
+            start = BenchNowNs();
+            MacroCacheKey actual = { source.size(), 0, HashMacroSource(source.data(), source.size()) };
+            bool hit = ReadMacroCache(cache.data(), cache.size(), actual, cached, read);
+            ms = (BenchNowNs() - start) / 1e6;
+            if (!hit) {
+                std::printf("cache rejected\n");
+                return 1;
+            }
+            if (ms < cacheMs) cacheMs = ms;
+            BenchKeep(read->macros.size());
+        }
+        std::printf("%8zu %10zu %10zu %10.2f %10.2f %10.2f\n", count, source.size() / 1024, cache.size() / 1024,
+                    parseMs, cacheMs, parseMs / cacheMs);
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+// 設定ファイルの読み書きの時間を測る
+// v1: 行数ごとの読み込み時間。1つのマクロの行が続けて並び、ところどころに壊れた行・コメントが
+//     混じったファイルを生成します。
+//       parse : メモリ上の内容を ParseMacros で解析する
+//       load  : 一時ファイルに書いてから LoadMacrosFromFile で読む（ファイルの読み込みを含む）
+// v2: マクロ数ごとの保存 (SerializeMacros) と読み込み (ParseMacros) の速さ (MB/s)
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bench/bench_macros.h"
+#include "bench/bench_util.h"
+#include "engine/macro_file.h"
+
+// 約 lines 行の v1 形式のファイル内容を作る
+static std::string MakeV1File(size_t lines, BenchRandom& rng) {
+    std::string out;
+    char buf[128];
+    size_t written = 0;
+    for (uint32_t n = 0; written < lines; n++) {
+        // ホットキーは Ctrl / Shift / Alt の組み合わせ + 文字キー + ファンクションキー (+ 数字キー) で、番号ごとに違う
+        std::string hotkeys;
+        static const char* modifiers[] = { "0x11", "0x10", "0x12" };
+        for (int i = 0; i < 3; i++) {
+            if (n & (1u << i)) hotkeys += std::string(modifiers[i]) + ", ";
+        }
+        snprintf(buf, sizeof(buf), "0x%X, 0x%X", 0x41 + (n >> 3) % 26, 0x70 + (n / (8 * 26)) % 12);
+        hotkeys += buf;
+        if (n / (8 * 26 * 12) > 0) {
+            snprintf(buf, sizeof(buf), ", 0x%X", 0x30 + n / (8 * 26 * 12));
+            hotkeys += buf;
+        }
+
+        uint32_t actions = 2 + rng.Below(14);
+        if (rng.Below(4) == 0) {
+            out += hotkeys + ", POLICY, queue:repeat\n";
+            written++;
+        }
+        for (uint32_t i = 0; i < actions; i++) {
+            switch (rng.Below(4)) {
+            case 0:
+                snprintf(buf, sizeof(buf), ", COMBO, 17:%u\n", 65 + rng.Below(26));
+                break;
+            case 1:
+                snprintf(buf, sizeof(buf), ", TEXT, text line %u of macro %u\n", i, n);
+                break;
+            case 2:
+                snprintf(buf, sizeof(buf), ", WAIT, %u\n", 10 + rng.Below(500));
+                break;
+            default:
+                // 読み飛ばされる行（未対応の種類・カンマ不足）
+                snprintf(buf, sizeof(buf), rng.Below(2) ? ", KEYDOWN, 65\n" : "\n# comment %u\n", i);
+                break;
+            }
+            out += hotkeys + buf;
+            written++;
+        }
+    }
+    return out;
+}
+
+// v2 形式の保存・読み込みの速さ
+static void MeasureV2(bool quick, int repeats) {
+    const size_t counts[] = { 1000, 10000, 100000 };
+    std::printf("\nv2 save / parse (best of %d)\n", repeats);
+    std::printf("%8s %10s %10s %10s %10s %10s\n", "macros", "KB", "save ms", "parse ms", "save MB/s", "parse MB/s");
+    for (size_t count : counts) {
+        if (quick && count > 1000) break;
+        BenchRandom rng(count);
+        std::vector<Macro> macros = MakeBenchMacros(count, rng);
+
+        double saveMs = 1e30, parseMs = 1e30;
+        std::string text;
+        for (int r = 0; r < repeats; r++) {
+            int64_t start = BenchNowNs();
+            text = SerializeMacros(macros);
+            double ms = (BenchNowNs() - start) / 1e6;
+            if (ms < saveMs) saveMs = ms;
+
+            std::vector<Macro> parsed;
+            start = BenchNowNs();
+            ParseMacros(text.data(), text.size(), parsed);
+            ms = (BenchNowNs() - start) / 1e6;
+            if (ms < parseMs) parseMs = ms;
+            if (parsed.size() != macros.size()) std::printf("round trip lost macros: %zu -> %zu\n", macros.size(), parsed.size());
+        }
+        std::printf("%8zu %10zu %10.2f %10.2f %10.1f %10.1f\n", count, text.size() / 1024, saveMs, parseMs,
+                    text.size() / 1e3 / saveMs, text.size() / 1e3 / parseMs);
+    }
+}
+
+int main(int argc, char** argv) {
+    const bool quick = BenchQuickMode(argc, argv);
+    const size_t sizes[] = { 10000, 100000 };
+    const int kRepeats = quick ? 1 : 5;
+    const std::string path = "macro_file_bench.tmp";
+
+    // LoadMacrosFromFile は読み込むたびにログを出すので、表は最後にまとめて出す
+    std::string table;
+    char row[160];
+    for (size_t lines : sizes) {
+        if (quick && lines > 10000) break;
+        BenchRandom rng(lines);
+        std::string text = MakeV1File(lines, rng);
+
+        FILE* f = fopen(path.c_str(), "wb");
+        if (!f) return 1;
+        fwrite(text.data(), 1, text.size(), f);
+        fclose(f);
+
+        double parseMs = 1e30, loadMs = 1e30;
+        size_t macroCount = 0;
+        for (int r = 0; r < kRepeats; r++) {
+            std::vector<Macro> macros;
+            int64_t start = BenchNowNs();
+            ParseMacros(text.data(), text.size(), macros);
+            double ms = (BenchNowNs() - start) / 1e6;
+            if (ms < parseMs) parseMs = ms;
+            macroCount = macros.size();
+
+            macros.clear();
+            start = BenchNowNs();
+            if (!LoadMacrosFromFile(path, macros)) return 1;
+            ms = (BenchNowNs() - start) / 1e6;
+            if (ms < loadMs) loadMs = ms;
+            BenchKeep(macros.size());
+        }
+        snprintf(row, sizeof(row), "%8zu %8zu %10zu %10.2f %10.2f %10.1f\n", lines, macroCount, text.size() / 1024,
+                 parseMs, loadMs, text.size() / 1e3 / parseMs);
+        table += row;
+    }
+    std::remove(path.c_str());
+
+    std::printf("v1 load time (best of %d)\n", kRepeats);
+    std::printf("%8s %8s %10s %10s %10s %10s\n", "lines", "macros", "KB", "parse ms", "load ms", "MB/s");
+    std::printf("%s", table.c_str());
+
+    MeasureV2(quick, kRepeats);
+    return 0;
+}
@@ -0,0 +1,81 @@
+// 登録済みショートカット一覧 (macro_list_view.cpp) の1フレームの描画時間を、マクロ数ごとに測る
+// Dear ImGui の null バックエンドで、画面への出力をせずに ImGui 側の手間だけを測ります。
+//   top      : 一覧の先頭を表示（すべて折りたたみ）
+//   middle   : 一覧の中ほどまでスクロールしたところ
+//   expanded : すべて展開した一覧の中ほど（アクションの行も並ぶ）
+//   refresh  : マクロを変更した直後のフレーム（表示用の文字列の作り直しを含む）
+
+#include <cstdio>
+#include <vector>
+
+#include "backends/imgui_impl_null.h"
+#include "bench/bench_macros.h"
+#include "bench/bench_util.h"
+#include "imgui.h"
+#include "macro_list_view.h"
+
+// main.cpp と同じく、画面いっぱいのウィンドウに一覧を描く
+static void DrawFrame(MacroListView& view, const std::vector<Macro>& macros, const LayerStack& layers, float scrollRatio) {
+    ImGui_ImplNull_NewFrame();
+    ImGui::NewFrame();
+    ImGui::SetNextWindowPos(ImVec2(0, 0));
+    ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize);
+    ImGui::Begin("MainPanel", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
+    MacroListClicks clicks = DrawMacroList(view, macros, layers);
+    BenchKeep((uint64_t)(clicks.deleteIndex + clicks.editIndex));
+    if (scrollRatio >= 0.0f) ImGui::SetScrollY(ImGui::GetScrollMaxY() * scrollRatio);
+    ImGui::End();
+    ImGui::Render();
+    ImGui_ImplNullRender_RenderDrawData(ImGui::GetDrawData());
+}
+
+// frames 回描いたときの1フレームあたりの時間 (us)
+static double MeasureFrames(MacroListView& view, const std::vector<Macro>& macros, const LayerStack& layers,
+                            float scrollRatio, int frames, bool refresh) {
+    int64_t total = 0;
+    for (int f = 0; f < frames; f++) {
+        if (refresh) view.dirty = true;
+        int64_t start = BenchNowNs();
+        DrawFrame(view, macros, layers, scrollRatio);
+        total += BenchNowNs() - start;
+    }
+    return total / 1e3 / frames;
+}
+
+int main(int argc, char** argv) {
+    const bool quick = BenchQuickMode(argc, argv);
+    const size_t counts[] = { 1000, 10000 };
+    const int kFrames = quick ? 5 : 300;
+
+    ImGui::CreateContext();
+    ImGui::GetIO().IniFilename = nullptr;
+    ImGui_ImplNull_Init();
+
+    LayerStack layers = {};
+    std::printf("us per frame (null backend, %d frames)\n", kFrames);
+    std::printf("%8s %10s %10s %10s %10s %8s\n", "macros", "top", "middle", "expanded", "refresh", "rows");
+    for (size_t count : counts) {
+        BenchRandom rng(count);
+        std::vector<Macro> macros = MakeBenchMacros(count, rng);
+        MacroListView view;
+
+        // 1フレーム目はフォントの作成などを含むので測らない
+        DrawFrame(view, macros, layers, 0.0f);
+        double top = MeasureFrames(view, macros, layers, 0.0f, kFrames, false);
+        // スクロール位置は次のフレームで反映されるので、1フレーム空けてから測る
+        DrawFrame(view, macros, layers, 0.5f);
+        double middle = MeasureFrames(view, macros, layers, 0.5f, kFrames, false);
+        double refresh = MeasureFrames(view, macros, layers, 0.5f, quick ? 1 : 10, true);
+
+        for (MacroListEntry& entry : view.entries) entry.open = true;
+        view.dirty = true;
+        DrawFrame(view, macros, layers, 0.5f);
+        double expanded = MeasureFrames(view, macros, layers, 0.5f, kFrames, false);
+
+        std::printf("%8zu %10.1f %10.1f %10.1f %10.1f %8zu\n", count, top, middle, expanded, refresh, view.rows.size());
+    }
+
+    ImGui_ImplNull_Shutdown();
+    ImGui::DestroyContext();
+    return 0;
+}
@@ -0,0 +1,33 @@
+﻿#include "compiled_macro.h"
+
+CompiledMacroPtr CompileMacro(const Macro& macro, uint32_t id, const CompileOptions& options) {
+    std::shared_ptr<CompiledMacro> compiled = std::make_shared<CompiledMacro>();
+    compiled->id = id;
+    compiled->hotkeys = macro.hotkeys;
+    // 押しっぱなし時間とキー間隔はマクロごとの設定を使う
+    CompileOptions macroOptions = options;
+    macroOptions.holdMs = macro.holdMs > 0 ? (uint32_t)macro.holdMs : 0;
+    macroOptions.interKeyMs = macro.interKeyMs > 0 ? (uint32_t)macro.interKeyMs : 0;
+    // ホットストリングは最後の1文字をフックで止めるので、それより前に入力された文字を消す
+    macroOptions.eraseChars = 0;
+    if (!macro.hotstring.empty()) {
+        size_t typed = Utf8ToUtf16(macro.hotstring).size();
+        macroOptions.eraseChars = typed > 1 ? (uint32_t)(typed - 1) : 0;
+    }
+    CompileActions(macro.actions, compiled->stream, macroOptions);
+    compiled->concurrency = macro.concurrency;
+    compiled->allowAutoRepeat = macro.allowAutoRepeat;
+    FindLayerSwitch(macro.actions, compiled->layerSwitch, compiled->layerSwitchId);
+    return compiled;
+}
+
+void FindLayerSwitch(const std::vector<MacroAction>& actions, LayerSwitchMode& mode, uint32_t& layerId) {
+    mode = LAYER_SWITCH_NONE;
+    layerId = 0;
+    for (const auto& action : actions) {
+        if (action.type != ACTION_LAYER_TOGGLE && action.type != ACTION_LAYER_HOLD) continue;
+        mode = action.type == ACTION_LAYER_HOLD ? LAYER_SWITCH_HOLD : LAYER_SWITCH_TOGGLE;
+        layerId = LayerId(action.text);
+        return;
+    }
+}
@@ -0,0 +1,56 @@
+﻿#pragma once
+
+// 実行用に確定させたマクロ
+// 登録済みマクロ (Macro) は UI から編集されるため、実行側には作成後に変更されない
+// CompiledMacro を shared_ptr で渡します。アクション列は読み込み・編集の時点で
+// EventStream に変換しておき、実行時には変換しません。実行待ち・実行中のマクロは、その間に
+// 一覧が編集されても最後まで同じ内容で動きます。
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "macro_engine.h"
+#include "macro_layers.h"
+
+// 実行状態（MacroExecutor だけが触る）
+struct MacroRunState {
+    // 0: 待機なし / 1: 実行待ちまたは実行中 / 2: さらにもう1回の実行を予約済み
+    std::atomic<uint32_t> pending{0};
+    // CONCURRENCY_RESTART で増やし、実行中の回に中止を知らせる
+    std::atomic<uint32_t> cancelGeneration{0};
+
+    // これまでの実行回数と、送信回数・送信イベント数の累計
+    std::atomic<uint64_t> runs{0};
+    std::atomic<uint64_t> submissions{0};
+    std::atomic<uint64_t> events{0};
+};
+
+// 発動したときのレイヤーの切り替え（アクション列の最初の ACTION_LAYER_* から決める）
+enum LayerSwitchMode {
+    LAYER_SWITCH_NONE,
+    LAYER_SWITCH_TOGGLE, // 有効・無効を入れ替える
+    LAYER_SWITCH_HOLD    // 起動キーを押している間だけ有効にする
+};
+
+struct CompiledMacro {
+    uint32_t id;                      // 登録済み一覧での番号（ログ・計測用）
+    std::vector<VkCode> hotkeys;
+    EventStream stream;               // アクション列を変換した送信イベント列
+    MacroConcurrency concurrency;
+    bool allowAutoRepeat;
+    LayerSwitchMode layerSwitch;      // フックが行うレイヤーの切り替え
+    uint32_t layerSwitchId;           // 切り替えるレイヤー (LayerId)
+
+    // 内容は変更しないが、実行状態だけは const のまま更新する
+    mutable MacroRunState runState;
+};
+
+typedef std::shared_ptr<const CompiledMacro> CompiledMacroPtr;
+
+// actions の最初の ACTION_LAYER_* から、発動したときのレイヤーの切り替えを決める
+void FindLayerSwitch(const std::vector<MacroAction>& actions, LayerSwitchMode& mode, uint32_t& layerId);
+
+// id は一覧での番号。options の holdMs / interKeyMs / eraseChars はマクロ自身の設定で上書きされます
+CompiledMacroPtr CompileMacro(const Macro& macro, uint32_t id, const CompileOptions& options = CompileOptions());
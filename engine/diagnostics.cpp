@@ -0,0 +1,37 @@
+﻿#include "diagnostics.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+std::string HistogramCsvHeader() {
+    return "time_unix_ms,metric,count,mean_us,p50_us,p90_us,p99_us,p999_us,max_us\n";
+}
+
+std::string FormatHistogramCsv(int64_t unixMs, const NamedHistogram* items, size_t count) {
+    std::string out;
+    for (size_t i = 0; i < count; i++) {
+        const LatencyHistogram& h = *items[i].histogram;
+        char line[256];
+        snprintf(line, sizeof(line), "%lld,%s,%llu,%.1f,%llu,%llu,%llu,%llu,%llu\n",
+                 (long long)unixMs, items[i].name, (unsigned long long)h.Count(), h.Mean(),
+                 (unsigned long long)h.Percentile(50), (unsigned long long)h.Percentile(90),
+                 (unsigned long long)h.Percentile(99), (unsigned long long)h.Percentile(99.9),
+                 (unsigned long long)h.Max());
+        out += line;
+    }
+    return out;
+}
+
+bool AppendHistogramCsv(const std::string& filename, const NamedHistogram* items, size_t count) {
+    std::ofstream file(filename, std::ios::binary | std::ios::app);
+    if (!file.is_open()) return false;
+    // 追記モードでは書く前の位置が末尾なので、0 なら新しいファイル
+    file.seekp(0, std::ios::end);
+    if (file.tellp() == std::streampos(0)) file << HistogramCsvHeader();
+
+    int64_t unixMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    file << FormatHistogramCsv(unixMs, items, count);
+    return (bool)file;
+}
@@ -0,0 +1,25 @@
+﻿#pragma once
+
+// 計測結果 (LatencyHistogram) の書き出し
+// 書き出すたびに CSV へ1指標1行で追記するので、定期的に書き出せば時系列として集計できます。
+//   time_unix_ms,metric,count,mean_us,p50_us,p90_us,p99_us,p999_us,max_us
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "histogram.h"
+
+struct NamedHistogram {
+    const char* name;
+    const LatencyHistogram* histogram;
+};
+
+// CSV の見出し行（改行付き）
+std::string HistogramCsvHeader();
+
+// items を CSV の行にする（1指標1行、改行付き）
+std::string FormatHistogramCsv(int64_t unixMs, const NamedHistogram* items, size_t count);
+
+// filename に追記する（新しいファイルなら見出し行も書く）
+bool AppendHistogramCsv(const std::string& filename, const NamedHistogram* items, size_t count);
@@ -0,0 +1,105 @@
+﻿#include "event_log.h"
+
+#include <chrono>
+
+void EventLog::Push(LogEventType event, uint32_t macroId, int64_t arg) {
+    LogRecord record;
+    record.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    record.macroId = macroId;
+    record.event = event;
+    record.arg = arg;
+    if (!ring_.TryPush(record)) dropped_.fetch_add(1, std::memory_order_relaxed);
+}
+
+LogWriter::LogWriter(EventLog& log, const std::string& filename, size_t recentLines)
+    : log_(log), filename_(filename), file_(nullptr), recentLimit_(recentLines), reportedDropped_(0),
+      running_(false), stopping_(false) {}
+
+LogWriter::~LogWriter() {
+    Stop();
+}
+
+void LogWriter::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) return;
+    file_ = std::fopen(filename_.c_str(), "a");
+    running_ = true;
+    stopping_ = false;
+    thread_ = std::thread(&LogWriter::WriterLoop, this);
+}
+
+void LogWriter::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) return;
+        stopping_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+    Drain();
+    if (file_) std::fclose(file_);
+    file_ = nullptr;
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+}
+
+std::vector<std::string> LogWriter::RecentLines() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::vector<std::string>(recent_.begin(), recent_.end());
+}
+
+void LogWriter::WriterLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        // 積む側は起こさない（起こすにはロックが要る）ので、一定間隔で見に行く
+        cond_.wait_for(lock, std::chrono::milliseconds(100));
+        lock.unlock();
+        Drain();
+        lock.lock();
+    }
+}
+
+void LogWriter::Drain() {
+    std::vector<std::string> lines;
+    LogRecord record;
+    while (log_.TryPop(record)) lines.push_back(Format(record));
+
+    uint64_t dropped = log_.Dropped();
+    if (dropped != reportedDropped_) {
+        lines.push_back("[WARN] log buffer full, dropped " + std::to_string(dropped - reportedDropped_) + " records");
+        reportedDropped_ = dropped;
+    }
+    if (lines.empty()) return;
+
+    if (file_) {
+        for (const auto& line : lines) {
+            std::fputs(line.c_str(), file_);
+            std::fputc('\n', file_);
+        }
+        std::fflush(file_);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& line : lines) {
+        recent_.push_back(std::move(line));
+        if (recent_.size() > recentLimit_) recent_.pop_front();
+    }
+}
+
+std::string LogWriter::Format(const LogRecord& record) {
+    static const char* const kNames[] = {
+        "triggered", "started", "finished", "cancelled", "ignored", "restarted", "dropped", "toggled"
+    };
+    const char* name = (record.event < sizeof(kNames) / sizeof(kNames[0])) ? kNames[record.event] : "unknown";
+
+    char buf[128];
+    double sec = (double)record.timeNs / 1e9;
+    if (record.macroId == kNoMacroId) {
+        std::snprintf(buf, sizeof(buf), "%.6f [MACRO] %s arg=%lld", sec, name, (long long)record.arg);
+    } else {
+        std::snprintf(buf, sizeof(buf), "%.6f [MACRO] #%u %s arg=%lld", sec, record.macroId + 1, name,
+                      (long long)record.arg);
+    }
+    return buf;
+}
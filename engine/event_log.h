@@ -0,0 +1,90 @@
+﻿#pragma once
+
+// フック・実行スレッド用のログ
+// フックのスレッドで文字列を組み立てたりファイルに書いたりすると、フックの制限時間
+// (LowLevelHooksTimeout) を超えて Windows にフックを外されることがあります。
+// そこでフックと実行スレッドは固定長の LogRecord を EventLog（ロックフリーのリングバッファ）に
+// 積むだけにし、文字列にしてファイルへ書くのは LogWriter のスレッドが行います。
+// バッファが満杯のときは積まずに捨て、捨てた数だけを数えます。
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+
+enum LogEventType : uint16_t {
+    LOG_MACRO_TRIGGERED,   // ホットキーが押された (arg: 押されたキー)
+    LOG_MACRO_STARTED,     // 実行を始めた
+    LOG_MACRO_FINISHED,    // 実行し終えた (arg: 送信したイベント数)
+    LOG_MACRO_CANCELLED,   // 再発動で中断された (arg: 送信したイベント数)
+    LOG_MACRO_IGNORED,     // 実行中・キーリピートのため無視した
+    LOG_MACRO_RESTARTED,   // 実行中の回を中断して再実行する
+    LOG_MACRO_DROPPED,     // キューが満杯で捨てた
+    LOG_MACROS_TOGGLED     // Ctrl+F12 でマクロを有効/無効にした (arg: 1 なら有効)
+};
+
+// マクロに関係しない記録の macroId
+const uint32_t kNoMacroId = 0xFFFFFFFF;
+
+struct LogRecord {
+    int64_t timeNs;       // steady_clock の時刻
+    uint32_t macroId;     // CompiledMacro::id（登録済み一覧での番号）
+    LogEventType event;
+    int64_t arg;
+};
+
+class EventLog {
+public:
+    explicit EventLog(size_t capacity) : ring_(capacity), dropped_(0) {}
+
+    // ロックもメモリ確保もせずに積む（満杯なら捨てる）。どのスレッドからでも呼べます。
+    void Push(LogEventType event, uint32_t macroId, int64_t arg = 0);
+
+    // 積まれた記録を古い順に取り出す（LogWriter が使う）
+    bool TryPop(LogRecord& out) { return ring_.TryPop(out); }
+
+    // 満杯で捨てた記録の数（累計）
+    uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    BoundedQueue<LogRecord> ring_;
+    std::atomic<uint64_t> dropped_;
+};
+
+// EventLog を定期的に取り出してファイルに書くスレッド
+// 直近の行は UI で表示できるように RecentLines で取り出せます。
+class LogWriter {
+public:
+    LogWriter(EventLog& log, const std::string& filename, size_t recentLines = 200);
+    ~LogWriter();
+
+    void Start();
+    void Stop(); // 残っている記録を書き終えてから止まる
+
+    std::vector<std::string> RecentLines();
+
+private:
+    void WriterLoop();
+    void Drain();
+    static std::string Format(const LogRecord& record);
+
+    EventLog& log_;
+    std::string filename_;
+    std::FILE* file_;
+    size_t recentLimit_;
+    std::thread thread_;
+    uint64_t reportedDropped_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool running_;
+    bool stopping_;
+    std::deque<std::string> recent_;
+};
@@ -0,0 +1,88 @@
+﻿#pragma once
+
+// 時間の分布を記録するヒストグラム（マイクロ秒単位）
+// 16µs 未満は 1µs 刻み、それ以上は 2 のべき乗ごとの区間を 8 等分した刻みで数えます
+// （相対誤差 12.5% 以内）。記録はロックを取らずに複数スレッドから行えます。
+
+#include <atomic>
+#include <cstdint>
+
+class LatencyHistogram {
+public:
+    static const int kBucketCount = 16 + 40 * 8;
+
+    LatencyHistogram() { Reset(); }
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void Record(uint64_t us) {
+        buckets_[BucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(us, std::memory_order_relaxed);
+        uint64_t prev = max_.load(std::memory_order_relaxed);
+        while (us > prev && !max_.compare_exchange_weak(prev, us, std::memory_order_relaxed)) {}
+    }
+
+    void Reset() {
+        for (auto& b : buckets_) b.store(0, std::memory_order_relaxed);
+        count_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t Max() const { return max_.load(std::memory_order_relaxed); }
+    double Mean() const {
+        uint64_t n = Count();
+        return n ? (double)sum_.load(std::memory_order_relaxed) / (double)n : 0.0;
+    }
+
+    // p (0?100) パーセンタイルの値。該当する区間の上端を返します（最大値は超えない）。
+    uint64_t Percentile(double p) const {
+        uint64_t n = Count();
+        if (n == 0) return 0;
+        uint64_t rank = (uint64_t)(p / 100.0 * (double)n + 0.5);
+        if (rank < 1) rank = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < kBucketCount; i++) {
+            seen += buckets_[i].load(std::memory_order_relaxed);
+            if (seen >= rank) {
+                uint64_t upper = BucketUpper(i);
+                uint64_t mx = Max();
+                return upper < mx ? upper : mx;
+            }
+        }
+        return Max();
+    }
+
+    uint64_t BucketCount(int i) const { return buckets_[i].load(std::memory_order_relaxed); }
+
+    // 区間 i に入る値の範囲 [BucketLower(i), BucketUpper(i)]
+    static uint64_t BucketLower(int i) {
+        if (i < 16) return (uint64_t)i;
+        int e = 4 + (i - 16) / 8;
+        int sub = (i - 16) % 8;
+        return (uint64_t)(8 + sub) << (e - 3);
+    }
+    static uint64_t BucketUpper(int i) {
+        if (i < 16) return (uint64_t)i;
+        int e = 4 + (i - 16) / 8;
+        return BucketLower(i) + ((uint64_t)1 << (e - 3)) - 1;
+    }
+
+private:
+    static int BucketOf(uint64_t us) {
+        if (us < 16) return (int)us;
+        int e = 63;
+        while (!((us >> e) & 1)) e--;
+        if (e > 43) return kBucketCount - 1;
+        int sub = (int)((us >> (e - 3)) & 7);
+        return 16 + (e - 4) * 8 + sub;
+    }
+
+    std::atomic<uint64_t> buckets_[kBucketCount];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
@@ -0,0 +1,72 @@
+﻿#include "hotkey_index.h"
+
+HotkeyIndex::HotkeyIndex() {
+    for (int i = 0; i <= kKeyCount; i++) offsets_[i] = 0;
+}
+
+// ホットキー hk が成立しうる「押されたキー」を列挙する（共通修飾キーは左右にも展開）
+static int ExpandTriggerKeys(VkCode hk, VkCode out[3]) {
+    int n = 0;
+    out[n++] = hk;
+    if (hk == VKC_CONTROL) { out[n++] = VKC_LCONTROL; out[n++] = VKC_RCONTROL; }
+    else if (hk == VKC_MENU) { out[n++] = VKC_LMENU; out[n++] = VKC_RMENU; }
+    else if (hk == VKC_SHIFT) { out[n++] = VKC_LSHIFT; out[n++] = VKC_RSHIFT; }
+    return n;
+}
+
+void HotkeyIndex::Build(const std::vector<Macro>& macros) {
+    masks_.resize(macros.size());
+    for (size_t m = 0; m < macros.size(); m++) masks_[m] = MakeHotkeyMask(macros[m]);
+
+    // 1回目: 各キーの候補数を数える / 2回目: 詰めて書き込む
+    // 同じマクロが同じキーに二重登録されないよう、キーごとに最後に登録したマクロ番号を覚えておく
+    uint32_t counts[kKeyCount] = {};
+    uint32_t lastMacro[kKeyCount];
+    const std::vector<VkCode> remaps = RemapTargets(macros);
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (int k = 0; k < kKeyCount; k++) lastMacro[k] = UINT32_MAX;
+
+        if (pass == 1) {
+            offsets_[0] = 0;
+            for (int k = 0; k < kKeyCount; k++) offsets_[k + 1] = offsets_[k] + counts[k];
+            entries_.assign(offsets_[kKeyCount], 0);
+            for (int k = 0; k < kKeyCount; k++) counts[k] = 0;
+        }
+
+        for (uint32_t m = 0; m < (uint32_t)macros.size(); m++) {
+            // デュアルロールキーは TapHoldTable、1:1 の置き換えは KeyRemapTable が扱う
+            if (macros[m].holdKey != 0 || remaps[m] != 0) continue;
+            for (VkCode hk : macros[m].hotkeys) {
+                VkCode keys[3];
+                int n = ExpandTriggerKeys(hk, keys);
+                for (int i = 0; i < n; i++) {
+                    VkCode vk = keys[i];
+                    if (vk >= kKeyCount || lastMacro[vk] == m) continue;
+                    lastMacro[vk] = m;
+                    if (pass == 1) entries_[offsets_[vk] + counts[vk]] = m;
+                    counts[vk]++;
+                }
+            }
+        }
+    }
+}
+
+const uint32_t* HotkeyIndex::Candidates(VkCode pressedVk, size_t* count) const {
+    if (pressedVk >= kKeyCount) {
+        *count = 0;
+        return nullptr;
+    }
+    *count = offsets_[pressedVk + 1] - offsets_[pressedVk];
+    return entries_.data() + offsets_[pressedVk];
+}
+
+int HotkeyIndex::FindTriggered(VkCode pressedVk, const KeyMask& held) const {
+    size_t count;
+    const uint32_t* candidates = Candidates(pressedVk, &count);
+    for (size_t i = 0; i < count; i++) {
+        // 発動キーであることは索引で保証済みなので、残りのキーが押されているかだけ確認する
+        if (held.Contains(masks_[candidates[i]])) return (int)candidates[i];
+    }
+    return -1;
+}
@@ -0,0 +1,37 @@
+﻿#pragma once
+
+// ホットキーの発動キー → 候補マクロ の索引
+// フック内で毎回すべてのマクロを走査しないように、押されたキーのコードから
+// そのキーを含むマクロだけを直接引けるようにしておきます。
+// 共通修飾キー (Ctrl/Shift/Alt) を含むマクロは、左右それぞれのキーの欄にも登録済みです。
+// マクロの追加・編集・削除のたびに Build し直してください。
+
+#include <cstdint>
+#include <vector>
+
+#include "key_state.h"
+#include "macro_engine.h"
+
+class HotkeyIndex {
+public:
+    HotkeyIndex();
+
+    // macros から索引を作り直す
+    void Build(const std::vector<Macro>& macros);
+
+    // pressedVk を発動キーとして含むマクロの番号 (macros 内の添字、昇順) を返す
+    const uint32_t* Candidates(VkCode pressedVk, size_t* count) const;
+
+    // 候補の中から、今押されたキーで発動するマクロの番号を探す（無ければ -1）
+    // held は pressedVk を押した後の押下状態 (KeyStateBitmap::Snapshot)。
+    int FindTriggered(VkCode pressedVk, const KeyMask& held) const;
+
+private:
+    static const int kKeyCount = 256;
+
+    // CSR 形式: キー vk の候補は entries_[offsets_[vk] .. offsets_[vk + 1])
+    uint32_t offsets_[kKeyCount + 1];
+    std::vector<uint32_t> entries_;
+    // マクロごとのホットキーのマスク (MakeHotkeyMask)
+    std::vector<KeyMask> masks_;
+};
@@ -0,0 +1,88 @@
+﻿#include "hotstring_matcher.h"
+
+#include <deque>
+
+const uint32_t HotstringMatcher::kRootState;
+
+// 英字は小文字にそろえる
+static char16_t FoldCase(char16_t c) {
+    return (c >= u'A' && c <= u'Z') ? (char16_t)(c - u'A' + u'a') : c;
+}
+
+HotstringMatcher::HotstringMatcher() : classOf_(0x10000, 0), classCount_(0) {}
+
+void HotstringMatcher::Build(const std::vector<Macro>& macros) {
+    std::vector<std::u16string> patterns(macros.size());
+    for (size_t m = 0; m < macros.size(); m++) {
+        if (macros[m].hotstring.empty()) continue;
+        patterns[m] = Utf8ToUtf16(macros[m].hotstring);
+        for (char16_t& c : patterns[m]) c = FoldCase(c);
+    }
+
+    // 1. 出てくる文字にクラス番号を振る（0 は「それ以外の文字」）
+    classOf_.assign(0x10000, 0);
+    uint32_t classes = 1;
+    for (const auto& p : patterns) {
+        for (char16_t c : p) {
+            if (classOf_[c] == 0) classOf_[c] = (uint16_t)classes++;
+        }
+    }
+    for (char16_t c = u'A'; c <= u'Z'; c++) classOf_[c] = classOf_[FoldCase(c)];
+
+    next_.clear();
+    match_.clear();
+    if (classes == 1) {
+        classCount_ = 0;
+        return;
+    }
+    classCount_ = classes;
+
+    // 2. トライを作る（遷移の無い欄は kNone）
+    const uint32_t kNone = UINT32_MAX;
+    next_.assign(classCount_, kNone);
+    match_.assign(1, -1);
+    for (size_t m = 0; m < patterns.size(); m++) {
+        uint32_t state = kRootState;
+        for (char16_t c : patterns[m]) {
+            uint32_t& slot = next_[(size_t)state * classCount_ + classOf_[c]];
+            if (slot == kNone) {
+                slot = (uint32_t)match_.size();
+                match_.push_back(-1);
+                next_.resize(next_.size() + classCount_, kNone);
+            }
+            // resize で slot の参照が無効になっていることがあるので引き直す
+            state = next_[(size_t)state * classCount_ + classOf_[c]];
+        }
+        if (!patterns[m].empty() && match_[state] < 0) match_[state] = (int32_t)m;
+    }
+
+    // 3. 幅優先で失敗遷移を求め、遷移の無い欄を失敗先の遷移で埋める
+    // 浅い状態から埋めるので、失敗先の欄は常に埋め終わっている。
+    std::vector<uint32_t> fail(match_.size(), kRootState);
+    std::deque<uint32_t> queue;
+    for (uint32_t c = 0; c < classCount_; c++) {
+        uint32_t& slot = next_[c];
+        if (slot == kNone) {
+            slot = kRootState;
+        } else {
+            fail[slot] = kRootState;
+            queue.push_back(slot);
+        }
+    }
+    while (!queue.empty()) {
+        uint32_t state = queue.front();
+        queue.pop_front();
+        // 自分で終わるものが無ければ、失敗先（自分の接尾辞）で終わるものを引き継ぐ
+        if (match_[state] < 0) match_[state] = match_[fail[state]];
+        const uint32_t* failRow = &next_[(size_t)fail[state] * classCount_];
+        uint32_t* row = &next_[(size_t)state * classCount_];
+        for (uint32_t c = 0; c < classCount_; c++) {
+            if (row[c] == kNone) {
+                row[c] = failRow[c];
+            } else {
+                fail[row[c]] = failRow[c];
+                queue.push_back(row[c]);
+            }
+        }
+    }
+}
@@ -0,0 +1,43 @@
+﻿#pragma once
+
+// ホットストリング（入力した文字列で発動するマクロ）の照合
+// すべてのマクロのホットストリングから Aho-Corasick のオートマトンを作り、失敗遷移まで
+// 埋めた遷移表 (DFA) にしておきます。フックは1文字ごとに表を1回引くだけで、入力履歴を
+// 走査しません。同じ位置で終わるホットストリングが複数あれば、長いほうが発動します。
+// 英字の大文字と小文字は区別しません（Shift や CapsLock の状態によらず発動する）。
+// マクロの追加・編集・削除のたびに Build し直してください。
+
+#include <cstdint>
+#include <vector>
+
+#include "macro_engine.h"
+
+class HotstringMatcher {
+public:
+    static const uint32_t kRootState = 0;
+
+    HotstringMatcher();
+
+    // macros の hotstring から作り直す（空のものは無視。同じ文字列が複数あれば先のマクロ）
+    void Build(const std::vector<Macro>& macros);
+
+    bool Empty() const { return classCount_ == 0; }
+    size_t StateCount() const { return match_.size(); }
+
+    // state を文字 c の分だけ進め、c で入力し終えたホットストリングのマクロ番号を返す（無ければ -1）
+    // state は呼び出し側が持ち、最初は kRootState にしておく。
+    int Advance(uint32_t& state, char16_t c) const {
+        if (classCount_ == 0) return -1;
+        state = next_[(size_t)state * classCount_ + classOf_[c]];
+        return match_[state];
+    }
+
+private:
+    // 文字 → 文字クラス（ホットストリングに出てこない文字はすべてクラス 0）
+    std::vector<uint16_t> classOf_;
+    uint32_t classCount_;
+    // 遷移表: next_[state * classCount_ + class]
+    std::vector<uint32_t> next_;
+    // その状態で入力し終えた最長のホットストリングのマクロ番号（無ければ -1）
+    std::vector<int32_t> match_;
+};
@@ -0,0 +1,40 @@
+﻿#include "key_capture.h"
+
+#include <algorithm>
+
+void KeyCapture::SetEnabled(bool enabled, const IKeyStateProvider& held) {
+    if (enabled_.load(std::memory_order_relaxed) == enabled) return;
+    // 記録を始める前 / 止めた後に、残っているキーを捨てる
+    VkCode vk;
+    if (!enabled) enabled_.store(false, std::memory_order_relaxed);
+    while (queue_.TryPop(vk)) {}
+    heldAtStart_.clear();
+    if (enabled) {
+        // マウスボタン (1～6) は除く
+        for (VkCode k = 8; k < 240; k++) {
+            if (held.IsKeyDown(k)) heldAtStart_.push_back(k);
+        }
+        enabled_.store(true, std::memory_order_relaxed);
+    }
+}
+
+// 左右の修飾キーを共通コードにまとめて、まだ無ければ keys に加える
+static void AddKey(std::vector<VkCode>& keys, VkCode vk) {
+    if (vk == VKC_LCONTROL || vk == VKC_RCONTROL) vk = VKC_CONTROL;
+    if (vk == VKC_LSHIFT || vk == VKC_RSHIFT) vk = VKC_SHIFT;
+    if (vk == VKC_LMENU || vk == VKC_RMENU) vk = VKC_MENU;
+    if (std::find(keys.begin(), keys.end(), vk) == keys.end()) keys.push_back(vk);
+}
+
+void KeyCapture::DrainInto(std::vector<VkCode>& keys) {
+    for (VkCode held : heldAtStart_) AddKey(keys, held);
+    heldAtStart_.clear();
+    VkCode vk;
+    while (queue_.TryPop(vk)) AddKey(keys, vk);
+}
+
+void KeyCapture::DrainOrdered(std::vector<VkCode>& keys) {
+    heldAtStart_.clear();
+    VkCode vk;
+    while (queue_.TryPop(vk)) keys.push_back(vk);
+}
@@ -0,0 +1,42 @@
+﻿#pragma once
+
+// 記録 UI 用のキー入力の受け渡し
+// 起動キーやコンボを記録している間だけ、フックが受け取ったキー押下を SpscQueue に積み、
+// UI スレッドが毎フレーム取り出します。GetAsyncKeyState で全キーを毎フレーム調べる必要がなく、
+// フレームの合間の短い押下も取りこぼしません。
+
+#include <atomic>
+#include <vector>
+
+#include "macro_engine.h"
+#include "spsc_queue.h"
+#include "vk_codes.h"
+
+class KeyCapture {
+public:
+    KeyCapture() : queue_(256), enabled_(false) {}
+
+    // UI スレッドから: 記録中かどうかを設定する（記録していない間に積まれたものは捨てる）
+    // 記録を始めた時点で held 上で押されているキー（修飾キーを押しながら記録開始した場合など）も記録に含めます。
+    void SetEnabled(bool enabled, const IKeyStateProvider& held);
+
+    bool Enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // フックのスレッドから: キーが押された（記録中でなければ何もしない）
+    void OnKeyDown(VkCode vk) {
+        if (enabled_.load(std::memory_order_relaxed)) queue_.TryPush(vk);
+    }
+
+    // UI スレッドから: 積まれたキーを keys に加える
+    // 左右の修飾キーは共通コード (Ctrl/Shift/Alt) にまとめ、既に含まれているキーは加えません。
+    void DrainInto(std::vector<VkCode>& keys);
+
+    // UI スレッドから: 積まれたキーを押された順にそのまま keys の後ろに加える（キー列の記録用）
+    // 同じキーの繰り返しや左右の区別も残し、記録開始時に押されていたキーは含めません。
+    void DrainOrdered(std::vector<VkCode>& keys);
+
+private:
+    SpscQueue<VkCode> queue_;
+    std::atomic<bool> enabled_;
+    std::vector<VkCode> heldAtStart_; // 記録開始時に押されていたキー（UI スレッドだけが触る）
+};
@@ -0,0 +1,168 @@
+﻿#include "key_sequence.h"
+
+#include <algorithm>
+#include <cstring>
+
+const uint32_t KeySequenceTrie::kRootState;
+const uint32_t KeySequenceTrie::kNoState;
+
+KeySequenceTrie::KeySequenceTrie() : next_(256, kNoState), macro_(1, -1), timeoutMs_(1, 0) {}
+
+void KeySequenceTrie::Build(const std::vector<Macro>& macros) {
+    next_.assign(256, kNoState);
+    macro_.assign(1, -1);
+    timeoutMs_.assign(1, 0);
+
+    for (size_t m = 0; m < macros.size(); m++) {
+        const Macro& macro = macros[m];
+        if (macro.sequence.empty() || macro.sequence.size() > kMaxSequenceKeys || macro.sequenceTimeoutMs <= 0) {
+            continue;
+        }
+        // 範囲外のキーを含むキー列は、途中までの状態も作らずに飛ばす
+        // （作ると、マクロを持たない行き止まりの状態ができてしまう）
+        if (std::any_of(macro.sequence.begin(), macro.sequence.end(), [](VkCode vk) { return vk >= 256; })) continue;
+
+        uint32_t state = kRootState;
+        for (VkCode vk : macro.sequence) {
+            // 続くキーがあるので、この状態では次のキーを待つ
+            timeoutMs_[state] = std::max(timeoutMs_[state], (uint32_t)macro.sequenceTimeoutMs);
+            size_t slot = (size_t)state * 256 + vk;
+            if (next_[slot] == kNoState) {
+                next_[slot] = (uint32_t)macro_.size();
+                next_.resize(next_.size() + 256, kNoState);
+                macro_.push_back(-1);
+                timeoutMs_.push_back(0);
+            }
+            // resize で next_ は移動していることがあるので、添字で引き直す
+            state = next_[slot];
+        }
+        if (macro_[state] < 0) macro_[state] = (int32_t)m;
+    }
+}
+
+KeySequenceTracker::KeySequenceTracker() : generation_(0), state_(KeySequenceTrie::kRootState), deadlineNs_(0), depth_(0) {
+    memset(swallowUp_, 0, sizeof(swallowUp_));
+}
+
+void KeySequenceTracker::AppendEvent(KeySequenceOutput& out, VkCode vk, bool down) {
+    InputEvent& ev = out.replay[out.replayCount++];
+    ev.type = down ? EVENT_KEY_DOWN : EVENT_KEY_UP;
+    ev.extended = IsExtendedKey(vk);
+    ev.code = vk;
+}
+
+void KeySequenceTracker::Reset() {
+    state_ = KeySequenceTrie::kRootState;
+    depth_ = 0;
+}
+
+void KeySequenceTracker::Fire(int macro, KeySequenceOutput& out) {
+    out.fireMacro = macro;
+    // 押したままのキーは、離したときにアプリへ届かないように止める
+    for (uint32_t i = 0; i < depth_; i++) {
+        if (!buffer_[i].released) swallowUp_[buffer_[i].vk >> 6] |= 1ULL << (buffer_[i].vk & 63);
+    }
+    Reset();
+}
+
+void KeySequenceTracker::Replay(KeySequenceOutput& out) {
+    // 止めていた順に押し直す。押したままのキーは、これから届く本物の離す操作に任せる
+    for (uint32_t i = 0; i < depth_; i++) {
+        AppendEvent(out, buffer_[i].vk, true);
+        if (buffer_[i].released) AppendEvent(out, buffer_[i].vk, false);
+    }
+    Reset();
+}
+
+void KeySequenceTracker::Step(const KeySequenceTrie& trie, uint32_t next, VkCode vk, int64_t nowNs,
+                              KeySequenceOutput& out) {
+    buffer_[depth_].vk = vk;
+    buffer_[depth_].released = false;
+    depth_++;
+    state_ = next;
+    if (!trie.HasNext(next)) {
+        Fire(trie.MacroAt(next), out);
+        return;
+    }
+    // 短いキー列が長いキー列の先頭でもあるときは、続きを待ってから決める
+    deadlineNs_ = nowNs + (int64_t)trie.TimeoutMs(next) * 1000000;
+}
+
+void KeySequenceTracker::Resolve(const KeySequenceTrie& trie, KeySequenceOutput& out) {
+    // 途中までで発動するマクロがあれば発動し、無ければ止めていたキーを送り直す
+    int macro = trie.MacroAt(state_);
+    if (macro >= 0) {
+        Fire(macro, out);
+    } else {
+        Replay(out);
+    }
+}
+
+bool KeySequenceTracker::OnKeyDown(const KeySequenceTrie& trie, uint64_t tableGeneration, VkCode vk, bool isRepeat,
+                                   int64_t nowNs, KeySequenceOutput& out) {
+    out.fireMacro = -1;
+    out.replayCount = 0;
+
+    if (generation_ != tableGeneration) {
+        // 古い表のマクロ番号は使えないので、発動はせずに送り直すだけにする
+        Replay(out);
+        generation_ = tableGeneration;
+    }
+    if (vk >= 256) return false;
+    // 発動に使ったキーを押し続けたときのキーリピートはアプリへ届けない
+    if (isRepeat && ((swallowUp_[vk >> 6] >> (vk & 63)) & 1)) return true;
+
+    if (depth_ > 0) {
+        if (isRepeat && buffer_[depth_ - 1].vk == vk && nowNs < deadlineNs_) {
+            return true; // 待っている間のキーリピートは捨てる
+        }
+        uint32_t next = nowNs < deadlineNs_ ? trie.Next(state_, vk) : KeySequenceTrie::kNoState;
+        if (next != KeySequenceTrie::kNoState) {
+            Step(trie, next, vk, nowNs, out);
+            return true;
+        }
+        // 時間切れか続きが一致しない
+        Resolve(trie, out);
+    }
+
+    uint32_t next = isRepeat ? KeySequenceTrie::kNoState : trie.Next(KeySequenceTrie::kRootState, vk);
+    if (next != KeySequenceTrie::kNoState) {
+        Step(trie, next, vk, nowNs, out);
+        return true;
+    }
+    if (out.replayCount == 0) return false;
+    // 送り直したキーより先に今のキーが届かないよう、今のキーも止めて送り直しの後ろに付ける
+    AppendEvent(out, vk, true);
+    return true;
+}
+
+bool KeySequenceTracker::OnKeyUp(VkCode vk) {
+    if (vk >= 256) return false;
+    uint64_t bit = 1ULL << (vk & 63);
+    if (swallowUp_[vk >> 6] & bit) {
+        swallowUp_[vk >> 6] &= ~bit;
+        return true;
+    }
+    for (uint32_t i = 0; i < depth_; i++) {
+        if (buffer_[i].vk == vk && !buffer_[i].released) {
+            buffer_[i].released = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool KeySequenceTracker::OnTimeout(const KeySequenceTrie& trie, uint64_t tableGeneration, int64_t nowNs,
+                                   KeySequenceOutput& out) {
+    out.fireMacro = -1;
+    out.replayCount = 0;
+    if (depth_ == 0) return false;
+    if (generation_ != tableGeneration) {
+        Replay(out);
+        generation_ = tableGeneration;
+        return true;
+    }
+    if (nowNs < deadlineNs_) return false;
+    Resolve(trie, out);
+    return true;
+}
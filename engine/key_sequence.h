@@ -0,0 +1,95 @@
+﻿#pragma once
+
+// キー列（リーダーキー）で発動するマクロの照合
+// 「無変換 → J → K」のように順に押すキー列をトライにし、各状態に 256 キー分の遷移表を持たせます。
+// フックは押されたキーごとに表を1回引くだけで、キー列を始めないキーは遷移表を1回見るだけで通します。
+//
+// KeySequenceTrie はマクロ表と一緒に作り直す不変の表、KeySequenceTracker はフックのスレッドが持つ
+// 照合の途中経過です。途中まで一致したキーはいったん止めて覚えておき、続きが一致しなかったときや
+// 次のキーを待つ時間が過ぎたときは、止めていたキーを送り直します（キーが消えたり順序が入れ替わったりしない）。
+
+#include <cstdint>
+#include <vector>
+
+#include "macro_engine.h"
+
+// キー列の長さの上限（これより長いキー列は登録しない）
+const size_t kMaxSequenceKeys = 8;
+
+class KeySequenceTrie {
+public:
+    static const uint32_t kRootState = 0;
+    static const uint32_t kNoState = UINT32_MAX;
+
+    KeySequenceTrie();
+
+    // macros の sequence から作り直す（空・長すぎるものは無視。同じキー列が複数あれば先のマクロ）
+    void Build(const std::vector<Macro>& macros);
+
+    bool Empty() const { return macro_.size() <= 1; }
+    size_t StateCount() const { return macro_.size(); }
+
+    // state で vk を押したときの次の状態（続かなければ kNoState）
+    uint32_t Next(uint32_t state, VkCode vk) const {
+        return vk < 256 ? next_[(size_t)state * 256 + vk] : kNoState;
+    }
+    // state までのキー列で発動するマクロの番号（無ければ -1）
+    int MacroAt(uint32_t state) const { return macro_[state]; }
+    // state から続くキー列があるか
+    bool HasNext(uint32_t state) const { return timeoutMs_[state] > 0; }
+    // state で次のキーを待つ時間 (ms)。続くマクロの sequenceTimeoutMs の最大値
+    uint32_t TimeoutMs(uint32_t state) const { return timeoutMs_[state]; }
+
+private:
+    std::vector<uint32_t> next_; // next_[state * 256 + vk]
+    std::vector<int32_t> macro_;
+    std::vector<uint32_t> timeoutMs_;
+};
+
+// 照合の結果、フックがすること
+struct KeySequenceOutput {
+    int fireMacro;         // 発動するマクロの番号（-1 なら無し）
+    uint32_t replayCount;  // 送り直すイベントの数
+    InputEvent replay[kMaxSequenceKeys * 2 + 1]; // 止めていたキー（と今のキー）の押す・離す
+};
+
+class KeySequenceTracker {
+public:
+    KeySequenceTracker();
+
+    // 途中まで一致していて、次のキーを待っているか
+    bool Pending() const { return depth_ > 0; }
+    // 待つのをやめる時刻（Pending のときだけ意味がある）
+    int64_t DeadlineNs() const { return deadlineNs_; }
+
+    // キーが押された。キーを止めるなら true（out は毎回初期化される）
+    // tableGeneration は trie を持つ表の通し番号 (DispatchTable::generation)。前回と違う（マクロ表が
+    // 差し替わったかレイヤーが切り替わった）ときは、途中のキーを送り直して最初から照合する。
+    bool OnKeyDown(const KeySequenceTrie& trie, uint64_t tableGeneration, VkCode vk, bool isRepeat, int64_t nowNs,
+                   KeySequenceOutput& out);
+    // キーが離された。止めるなら true（止めた押下に対応する離す操作）
+    bool OnKeyUp(VkCode vk);
+    // 待つ時間が過ぎていれば、途中まで一致したマクロを発動するか止めていたキーを送り直す
+    // 過ぎていなければ何もせず false を返す（out は毎回初期化される）。
+    bool OnTimeout(const KeySequenceTrie& trie, uint64_t tableGeneration, int64_t nowNs, KeySequenceOutput& out);
+
+private:
+    struct Buffered {
+        VkCode vk;
+        bool released; // 止めている間に離されたか
+    };
+
+    void Step(const KeySequenceTrie& trie, uint32_t next, VkCode vk, int64_t nowNs, KeySequenceOutput& out);
+    void Fire(int macro, KeySequenceOutput& out);
+    void Replay(KeySequenceOutput& out);
+    void Resolve(const KeySequenceTrie& trie, KeySequenceOutput& out);
+    void Reset();
+    static void AppendEvent(KeySequenceOutput& out, VkCode vk, bool down);
+
+    uint64_t generation_; // 照合中の表の通し番号（0 なら無し）
+    uint32_t state_;
+    int64_t deadlineNs_;
+    Buffered buffer_[kMaxSequenceKeys];
+    uint32_t depth_;
+    uint64_t swallowUp_[4]; // 発動に使ったキーの離す操作も止める（256 ビット）
+};
@@ -0,0 +1,49 @@
+﻿#include "key_state.h"
+
+KeyMask MakeHotkeyMask(const Macro& macro) {
+    KeyMask mask;
+    for (VkCode hk : macro.hotkeys) mask.Set(hk);
+    return mask;
+}
+
+KeyStateBitmap::KeyStateBitmap() {
+    Reset();
+}
+
+void KeyStateBitmap::SetBit(VkCode vk, bool down) {
+    uint64_t bit = 1ull << (vk & 63);
+    std::atomic<uint64_t>& word = bits_[vk >> 6];
+    // 書き込むのはフックのスレッドだけなので、読み出して書き戻すだけで十分
+    uint64_t value = word.load(std::memory_order_relaxed);
+    word.store(down ? (value | bit) : (value & ~bit), std::memory_order_relaxed);
+}
+
+bool KeyStateBitmap::OnKeyEvent(VkCode vk, bool down) {
+    // 0 番は「押されることのないキー」として予約しているので記録しない
+    if (vk == 0 || vk >= 256) return false;
+    bool wasDown = IsKeyDown(vk);
+    SetBit(vk, down);
+
+    // 左右の修飾キーが変化したら、共通コードのビットを「左右どちらかが押されている」に合わせる
+    VkCode generic = 0, left = 0, right = 0;
+    if (vk == VKC_LCONTROL || vk == VKC_RCONTROL) { generic = VKC_CONTROL; left = VKC_LCONTROL; right = VKC_RCONTROL; }
+    else if (vk == VKC_LSHIFT || vk == VKC_RSHIFT) { generic = VKC_SHIFT; left = VKC_LSHIFT; right = VKC_RSHIFT; }
+    else if (vk == VKC_LMENU || vk == VKC_RMENU) { generic = VKC_MENU; left = VKC_LMENU; right = VKC_RMENU; }
+    if (generic) SetBit(generic, IsKeyDown(left) || IsKeyDown(right));
+    return wasDown;
+}
+
+void KeyStateBitmap::Reset() {
+    for (auto& word : bits_) word.store(0, std::memory_order_relaxed);
+}
+
+bool KeyStateBitmap::IsKeyDown(VkCode vk) const {
+    if (vk >= 256) return false;
+    return (bits_[vk >> 6].load(std::memory_order_relaxed) >> (vk & 63)) & 1;
+}
+
+KeyMask KeyStateBitmap::Snapshot() const {
+    KeyMask mask;
+    for (int i = 0; i < 4; i++) mask.bits[i] = bits_[i].load(std::memory_order_relaxed);
+    return mask;
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+// 256ビットのキー押下状態
+// フックが受け取ったキーイベントから物理キーの状態を自前で管理し、
+// ホットキー判定を GetAsyncKeyState の呼び出しなしでビット演算だけで行えるようにします。
+
+#include <atomic>
+#include <cstdint>
+
+#include "macro_engine.h"
+
+// キーの集合（仮想キーコード 0?255 を1ビットずつ）
+struct KeyMask {
+    uint64_t bits[4];
+
+    KeyMask() : bits() {}
+
+    void Set(VkCode vk) {
+        // 範囲外のコードは、決して押されることのない 0 番として扱う
+        if (vk >= 256) vk = 0;
+        bits[vk >> 6] |= 1ull << (vk & 63);
+    }
+    bool Test(VkCode vk) const {
+        return vk < 256 && (bits[vk >> 6] >> (vk & 63)) & 1;
+    }
+    // required のキーがすべて含まれているか
+    bool Contains(const KeyMask& required) const {
+        return (bits[0] & required.bits[0]) == required.bits[0] &&
+               (bits[1] & required.bits[1]) == required.bits[1] &&
+               (bits[2] & required.bits[2]) == required.bits[2] &&
+               (bits[3] & required.bits[3]) == required.bits[3];
+    }
+};
+
+// ホットキーの構成キーから、判定に使うマスクを作る
+// 共通修飾キー (VKC_CONTROL など) はそのまま共通コードのビットになります。
+// KeyStateBitmap は左右どちらかが押されていれば共通コードのビットも立てるので、
+// 「左右どちらでもよい」という意味はマスクの比較だけで表現できます。
+KeyMask MakeHotkeyMask(const Macro& macro);
+
+// フックが更新する物理キーの押下状態
+// 書き込みはフックのスレッド (OnKeyEvent) のみ、読み込みはどのスレッドからでも可能です。
+class KeyStateBitmap : public IKeyStateProvider {
+public:
+    KeyStateBitmap();
+
+    // キーの押下/解放を反映する（フックのスレッドから呼ぶ）
+    // 戻り値は反映前に押されていたかどうか（押下中の押下はキーリピート）
+    bool OnKeyEvent(VkCode vk, bool down);
+    // すべてのキーを離した状態に戻す
+    void Reset();
+
+    bool IsKeyDown(VkCode vk) const override;
+    KeyMask Snapshot() const;
+
+private:
+    void SetBit(VkCode vk, bool down);
+
+    std::atomic<uint64_t> bits_[4];
+};
@@ -0,0 +1,281 @@
+﻿#include "macro_cache.h"
+
+#include <cstring>
+
+#include "macro_file.h"
+
+// 形式を変えたとき（EventStream の作り方を変えたときも含む）は kCacheVersion を上げる
+static const char kCacheMagic[8] = { 'W', 'H', 'P', 'C', 'A', 'C', 'H', 'E' };
+static const uint32_t kCacheVersion = 6;
+
+// ファイル上のレイアウト（すべて 4 バイト境界に置く）
+// [CacheHeader][CacheMacro * macroCount][CacheAction * ...][InputEvent * ...][CacheSpan * ...][VkCode / 文字列 / RawKeyEvent]
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t macroCount;
+    uint64_t sourceSize;
+    uint64_t sourceMtime;
+    uint64_t sourceHash;
+    uint64_t totalSize;
+};
+
+struct CacheRange {
+    uint32_t offset; // ファイル先頭からのバイト位置
+    uint32_t count;  // 要素数（文字列ならバイト数）
+};
+
+struct CacheMacro {
+    CacheRange hotkeys;  // VkCode
+    CacheRange actions;  // CacheAction
+    CacheRange events;   // InputEvent
+    CacheRange spans;    // CacheSpan
+    CacheRange hotstring; // UTF-8
+    CacheRange layer;     // UTF-8
+    CacheRange sequence;  // VkCode
+    int32_t sequenceTimeoutMs;
+    uint32_t holdKey;
+    int32_t tapTimeoutMs;
+    uint32_t permissiveHold;
+    uint32_t concurrency;
+    uint32_t allowAutoRepeat;
+    int32_t holdMs;
+    int32_t interKeyMs;
+};
+
+struct CacheAction {
+    uint32_t type;
+    int32_t waitMs;
+    CacheRange comboKeys; // VkCode
+    CacheRange text;      // UTF-8
+    CacheRange rawEvents; // RawKeyEvent
+};
+
+struct CacheSpan {
+    uint32_t first;
+    uint32_t count;
+    uint32_t delayMs;
+    uint32_t cancellable;
+};
+
+static_assert(sizeof(InputEvent) == 4, "InputEvent はキャッシュにそのまま書くので 4 バイトに保つ");
+static_assert(sizeof(RawKeyEvent) == 8, "RawKeyEvent はキャッシュにそのまま書くので 8 バイトに保つ");
+
+uint64_t HashMacroSource(const void* data, size_t size) {
+    const unsigned char* p = (const unsigned char*)data;
+    uint64_t h = 0x9E3779B97F4A7C15ULL ^ (uint64_t)size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 32;
+    }
+    uint64_t tail = 0;
+    for (size_t k = 0; i + k < size; k++) tail |= (uint64_t)p[i + k] << (k * 8);
+    h = (h ^ tail) * 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 29;
+    return h;
+}
+
+// 領域を足していく書き込み用のバッファ
+class CacheWriter {
+public:
+    // count 個の T を置く領域を確保して範囲を返す
+    template <typename T>
+    CacheRange Reserve(size_t count) {
+        Align();
+        CacheRange r = { (uint32_t)buf_.size(), (uint32_t)count };
+        buf_.resize(buf_.size() + sizeof(T) * count);
+        return r;
+    }
+    template <typename T>
+    CacheRange Append(const T* items, size_t count) {
+        CacheRange r = Reserve<T>(count);
+        if (count) memcpy(&buf_[r.offset], items, sizeof(T) * count);
+        return r;
+    }
+    template <typename T>
+    void Put(uint32_t offset, const T& value) { memcpy(&buf_[offset], &value, sizeof(T)); }
+
+    std::string& Buffer() { return buf_; }
+
+private:
+    void Align() { while (buf_.size() % 4) buf_.push_back('\0'); }
+    std::string buf_;
+};
+
+std::string BuildMacroCache(const MacroCacheKey& key, const std::vector<Macro>& macros,
+                            const std::vector<CompiledMacroPtr>& compiled) {
+    CacheWriter w;
+    CacheRange header = w.Reserve<CacheHeader>(1);
+    // 設定ファイルに書かれるマクロだけを、書かれる順に並べる（ParseMacros で読み直した一覧と同じにする）
+    const std::vector<size_t> saved = SavedMacroOrder(macros);
+    CacheRange macroRecords = w.Reserve<CacheMacro>(saved.size());
+
+    for (size_t r = 0; r < saved.size(); r++) {
+        size_t i = saved[r];
+        const Macro& m = macros[i];
+        const EventStream& stream = compiled[i]->stream;
+
+        CacheMacro rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.hotkeys = w.Append(m.hotkeys.data(), m.hotkeys.size());
+        rec.hotstring = w.Append(m.hotstring.data(), m.hotstring.size());
+        rec.layer = w.Append(m.layer.data(), m.layer.size());
+        rec.sequence = w.Append(m.sequence.data(), m.sequence.size());
+        rec.sequenceTimeoutMs = m.sequenceTimeoutMs;
+        rec.holdKey = m.holdKey;
+        rec.tapTimeoutMs = m.tapTimeoutMs;
+        rec.permissiveHold = m.permissiveHold ? 1 : 0;
+        rec.actions = w.Reserve<CacheAction>(m.actions.size());
+        for (size_t a = 0; a < m.actions.size(); a++) {
+            const MacroAction& src = m.actions[a];
+            CacheAction act;
+            memset(&act, 0, sizeof(act));
+            act.type = (uint32_t)src.type;
+            act.waitMs = src.waitMs;
+            act.comboKeys = w.Append(src.comboKeys.data(), src.comboKeys.size());
+            act.text = w.Append(src.text.data(), src.text.size());
+            act.rawEvents = w.Append(src.rawEvents.data(), src.rawEvents.size());
+            w.Put(rec.actions.offset + (uint32_t)(a * sizeof(CacheAction)), act);
+        }
+        rec.events = w.Append(stream.events.data(), stream.events.size());
+        rec.spans = w.Reserve<CacheSpan>(stream.spans.size());
+        for (size_t s = 0; s < stream.spans.size(); s++) {
+            const EventSpan& src = stream.spans[s];
+            CacheSpan span = { src.first, src.count, src.delayMs, src.cancellable ? 1u : 0u };
+            w.Put(rec.spans.offset + (uint32_t)(s * sizeof(CacheSpan)), span);
+        }
+        rec.concurrency = (uint32_t)m.concurrency;
+        rec.allowAutoRepeat = m.allowAutoRepeat ? 1 : 0;
+        rec.holdMs = m.holdMs;
+        rec.interKeyMs = m.interKeyMs;
+        w.Put(macroRecords.offset + (uint32_t)(r * sizeof(CacheMacro)), rec);
+    }
+
+    CacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, kCacheMagic, sizeof(kCacheMagic));
+    h.version = kCacheVersion;
+    h.macroCount = (uint32_t)saved.size();
+    h.sourceSize = key.sourceSize;
+    h.sourceMtime = key.sourceMtime;
+    h.sourceHash = key.sourceHash;
+    h.totalSize = w.Buffer().size();
+    w.Put(header.offset, h);
+    return w.Buffer();
+}
+
+// 範囲がファイル内に収まっているか確認してから読むためのヘルパー
+class CacheReader {
+public:
+    CacheReader(const void* data, size_t size) : base_((const char*)data), size_(size) {}
+
+    template <typename T>
+    bool Check(const CacheRange& r) const {
+        return r.offset <= size_ && (uint64_t)r.count * sizeof(T) <= size_ - r.offset;
+    }
+    template <typename T>
+    T Get(const CacheRange& r, size_t i) const {
+        T value;
+        memcpy(&value, base_ + r.offset + i * sizeof(T), sizeof(T));
+        return value;
+    }
+    template <typename T>
+    void Copy(const CacheRange& r, std::vector<T>& out) const {
+        out.resize(r.count);
+        if (r.count) memcpy(out.data(), base_ + r.offset, sizeof(T) * r.count);
+    }
+    const char* At(uint32_t offset) const { return base_ + offset; }
+
+private:
+    const char* base_;
+    size_t size_;
+};
+
+bool ReadMacroCache(const void* data, size_t size, const MacroCacheKey& key,
+                    std::vector<Macro>& macros, std::unique_ptr<MacroTable>& table) {
+    if (size < sizeof(CacheHeader)) return false;
+    CacheHeader h;
+    memcpy(&h, data, sizeof(h));
+    if (memcmp(h.magic, kCacheMagic, sizeof(kCacheMagic)) != 0 || h.version != kCacheVersion ||
+        h.totalSize != size || h.sourceSize != key.sourceSize || h.sourceMtime != key.sourceMtime ||
+        h.sourceHash != key.sourceHash) {
+        return false;
+    }
+
+    CacheReader r(data, size);
+    CacheRange macroRecords = { (uint32_t)sizeof(CacheHeader), h.macroCount };
+    if (!r.Check<CacheMacro>(macroRecords)) return false;
+
+    std::vector<Macro> loaded(h.macroCount);
+    std::unique_ptr<MacroTable> loadedTable(new MacroTable());
+    loadedTable->macros.reserve(h.macroCount);
+
+    for (uint32_t i = 0; i < h.macroCount; i++) {
+        CacheMacro rec = r.Get<CacheMacro>(macroRecords, i);
+        if (!r.Check<VkCode>(rec.hotkeys) || !r.Check<CacheAction>(rec.actions) ||
+            !r.Check<InputEvent>(rec.events) || !r.Check<CacheSpan>(rec.spans) || !r.Check<char>(rec.hotstring) ||
+            !r.Check<char>(rec.layer) ||
+            !r.Check<VkCode>(rec.sequence) ||
+            rec.concurrency > CONCURRENCY_PARALLEL) {
+            return false;
+        }
+
+        Macro& m = loaded[i];
+        r.Copy(rec.hotkeys, m.hotkeys);
+        m.hotstring.assign(r.At(rec.hotstring.offset), rec.hotstring.count);
+        m.layer.assign(r.At(rec.layer.offset), rec.layer.count);
+        r.Copy(rec.sequence, m.sequence);
+        m.sequenceTimeoutMs = rec.sequenceTimeoutMs;
+        m.holdKey = (VkCode)rec.holdKey;
+        m.tapTimeoutMs = rec.tapTimeoutMs;
+        m.permissiveHold = rec.permissiveHold != 0;
+        m.actions.resize(rec.actions.count);
+        for (uint32_t a = 0; a < rec.actions.count; a++) {
+            CacheAction act = r.Get<CacheAction>(rec.actions, a);
+            if (act.type > ACTION_LAYER_HOLD || !r.Check<VkCode>(act.comboKeys) || !r.Check<char>(act.text) ||
+                !r.Check<RawKeyEvent>(act.rawEvents)) {
+                return false;
+            }
+            MacroAction& dst = m.actions[a];
+            dst.type = (MacroActionType)act.type;
+            dst.waitMs = act.waitMs;
+            r.Copy(act.comboKeys, dst.comboKeys);
+            dst.text.assign(r.At(act.text.offset), act.text.count);
+            r.Copy(act.rawEvents, dst.rawEvents);
+        }
+        m.concurrency = (MacroConcurrency)rec.concurrency;
+        m.allowAutoRepeat = rec.allowAutoRepeat != 0;
+        m.holdMs = rec.holdMs;
+        m.interKeyMs = rec.interKeyMs;
+
+        // 変換済みのイベント列はそのまま使う（CompileActions を通さない）
+        std::shared_ptr<CompiledMacro> compiled = std::make_shared<CompiledMacro>();
+        compiled->id = i;
+        compiled->hotkeys = m.hotkeys;
+        r.Copy(rec.events, compiled->stream.events);
+        compiled->stream.spans.resize(rec.spans.count);
+        for (uint32_t s = 0; s < rec.spans.count; s++) {
+            CacheSpan span = r.Get<CacheSpan>(rec.spans, s);
+            if ((uint64_t)span.first + span.count > rec.events.count) return false;
+            EventSpan& dst = compiled->stream.spans[s];
+            dst.first = span.first;
+            dst.count = span.count;
+            dst.delayMs = span.delayMs;
+            dst.cancellable = span.cancellable != 0;
+        }
+        compiled->concurrency = m.concurrency;
+        compiled->allowAutoRepeat = m.allowAutoRepeat;
+        FindLayerSwitch(m.actions, compiled->layerSwitch, compiled->layerSwitchId);
+        loadedTable->macros.push_back(compiled);
+    }
+
+    // レイヤーごとの索引・照合表はホットキー・文字数に比例する軽い処理なので作り直す
+    BuildDispatchTables(*loadedTable, loaded);
+
+    macros.swap(loaded);
+    table = std::move(loadedTable);
+    return true;
+}
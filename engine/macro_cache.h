@@ -0,0 +1,37 @@
+﻿#pragma once
+
+// 変換済みマクロ表のキャッシュ (macros.txt.cache)
+// 起動のたびに macros.txt を解析・変換しなくて済むように、Macro と変換済みのイベント列を
+// そのまま並べたバイナリを設定ファイルの隣に置きます。中の参照はすべてファイル先頭からの
+// オフセットなので、メモリマップした領域をそのまま読めます。
+// 元ファイルのサイズ・更新時刻・内容のハッシュが一致しないキャッシュは使いません。
+// ファイルのマップと書き込みは macro_win32 (LoadMacrosCached / WriteMacroCache) が行います。
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "macro_engine.h"
+#include "macro_table.h"
+
+// キャッシュの元になった設定ファイルの情報
+struct MacroCacheKey {
+    uint64_t sourceSize;
+    uint64_t sourceMtime;  // 更新時刻（OS の値そのまま）
+    uint64_t sourceHash;   // HashMacroSource の値
+};
+
+// 設定ファイルの内容のハッシュ（8バイトずつ処理するので、解析よりずっと速い）
+uint64_t HashMacroSource(const void* data, size_t size);
+
+// macros と、それを変換した compiled (MacroTable::macros) をキャッシュのバイナリにする
+// SerializeMacros と同じく SavedMacroOrder の順に書くので、保存した設定ファイルを
+// ParseMacros で読み直した一覧と同じ並びになります。
+std::string BuildMacroCache(const MacroCacheKey& key, const std::vector<Macro>& macros,
+                            const std::vector<CompiledMacroPtr>& compiled);
+
+// キャッシュを読む。key が一致しないか内容が壊れていれば false（macros / table は変更しない）
+bool ReadMacroCache(const void* data, size_t size, const MacroCacheKey& key,
+                    std::vector<Macro>& macros, std::unique_ptr<MacroTable>& table);
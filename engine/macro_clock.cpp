@@ -0,0 +1,28 @@
+﻿#include "macro_clock.h"
+
+#include <chrono>
+#include <thread>
+
+int64_t SteadyMacroClock::NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SteadyMacroClock::SleepUntil(int64_t deadlineNs) {
+    // OS の sleep は指定より遅れて起きることがあるので、期限の 1ms 手前までだけ眠る
+    const int64_t kSpinNs = 1000000;
+    for (;;) {
+        int64_t remaining = deadlineNs - NowNs();
+        if (remaining <= 0) return;
+        if (remaining > kSpinNs) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(remaining - kSpinNs));
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+IMacroClock& DefaultMacroClock() {
+    static SteadyMacroClock clock;
+    return clock;
+}
@@ -0,0 +1,27 @@
+﻿#pragma once
+
+// マクロ実行用の時計
+// 待機は「何ms眠る」ではなく「この時刻まで待つ」で行い、長いマクロでも誤差が積み重ならないようにします。
+// Windows では QueryPerformanceCounter と高分解能タイマーを使う実装 (macro_win32.h) を使います。
+
+#include <cstdint>
+
+class IMacroClock {
+public:
+    virtual ~IMacroClock() {}
+    // 単調増加する現在時刻（ナノ秒）
+    virtual int64_t NowNs() = 0;
+    // deadlineNs まで待つ（deadlineNs より前には戻らない）
+    virtual void SleepUntil(int64_t deadlineNs) = 0;
+};
+
+// std::chrono::steady_clock による実装
+// 期限の少し手前まで眠り、残りは譲りながら待つことで寝過ごしを抑えます。
+class SteadyMacroClock : public IMacroClock {
+public:
+    int64_t NowNs() override;
+    void SleepUntil(int64_t deadlineNs) override;
+};
+
+// プロセス全体で共有する SteadyMacroClock
+IMacroClock& DefaultMacroClock();
@@ -0,0 +1,384 @@
+﻿#include "macro_engine.h"
+
+#include <algorithm>
+
+// UTF-8 (std::string) を UTF-16 (std::u16string) に変換する
+std::u16string Utf8ToUtf16(const std::string& str) {
+    std::u16string out;
+    out.reserve(str.size());
+
+    size_t i = 0;
+    while (i < str.size()) {
+        unsigned char c = (unsigned char)str[i];
+        uint32_t cp;
+        size_t len;
+        if (c < 0x80)              { cp = c;        len = 1; }
+        else if ((c >> 5) == 0x06) { cp = c & 0x1F; len = 2; }
+        else if ((c >> 4) == 0x0E) { cp = c & 0x0F; len = 3; }
+        else if ((c >> 3) == 0x1E) { cp = c & 0x07; len = 4; }
+        else { out.push_back(0xFFFD); i++; continue; }
+
+        if (i + len > str.size()) { out.push_back(0xFFFD); break; }
+
+        bool valid = true;
+        for (size_t k = 1; k < len; k++) {
+            unsigned char cc = (unsigned char)str[i + k];
+            if ((cc & 0xC0) != 0x80) { valid = false; break; }
+            cp = (cp << 6) | (cc & 0x3F);
+        }
+        if (!valid) { out.push_back(0xFFFD); i++; continue; }
+        i += len;
+
+        if (cp >= 0x10000) {
+            // サロゲートペアに分割
+            cp -= 0x10000;
+            out.push_back((char16_t)(0xD800 + (cp >> 10)));
+            out.push_back((char16_t)(0xDC00 + (cp & 0x3FF)));
+        } else {
+            out.push_back((char16_t)cp);
+        }
+    }
+    return out;
+}
+
+bool IsMacroTriggered(const Macro& macro, VkCode pressedVk, const IKeyStateProvider& keys) {
+    if (macro.hotkeys.empty()) return false;
+
+    // 1. まず「今押されたキー」がホットキーの一部に含まれているか確認
+    bool isTriggerKey = false;
+    for (VkCode hk : macro.hotkeys) {
+        // 左右の区別なく判定（今押されたのがLかRで、設定が共通コードなら一致とみなす）
+        if (pressedVk == hk) {
+            isTriggerKey = true;
+        } else if (hk == VKC_CONTROL && (pressedVk == VKC_LCONTROL || pressedVk == VKC_RCONTROL)) {
+            isTriggerKey = true;
+        } else if (hk == VKC_MENU && (pressedVk == VKC_LMENU || pressedVk == VKC_RMENU)) {
+            isTriggerKey = true;
+        } else if (hk == VKC_SHIFT && (pressedVk == VKC_LSHIFT || pressedVk == VKC_RSHIFT)) {
+            isTriggerKey = true;
+        }
+        if (isTriggerKey) break;
+    }
+    if (!isTriggerKey) return false;
+
+    // 2. ホットキーの構成キーが「全て」押されているかチェック
+    return IsChordHeld(macro, pressedVk, keys);
+}
+
+bool IsChordHeld(const Macro& macro, VkCode pressedVk, const IKeyStateProvider& keys) {
+    for (VkCode hk : macro.hotkeys) {
+        bool isThisKeyPressed = false;
+
+        // 今まさに押されたキーそのものならOK
+        if (hk == pressedVk) {
+            isThisKeyPressed = true;
+        }
+        // 設定が共通Ctrlで、物理的にLかRのどちらかが押されているか
+        else if (hk == VKC_CONTROL) {
+            isThisKeyPressed = keys.IsKeyDown(VKC_LCONTROL) || keys.IsKeyDown(VKC_RCONTROL);
+        }
+        // 設定が共通Alt(MENU)で、物理的にLかRのどちらかが押されているか
+        else if (hk == VKC_MENU) {
+            isThisKeyPressed = keys.IsKeyDown(VKC_LMENU) || keys.IsKeyDown(VKC_RMENU);
+        }
+        // 設定が共通Shiftで、物理的にLかRのどちらかが押されているか
+        else if (hk == VKC_SHIFT) {
+            isThisKeyPressed = keys.IsKeyDown(VKC_LSHIFT) || keys.IsKeyDown(VKC_RSHIFT);
+        }
+        // その他の通常のキー
+        else {
+            isThisKeyPressed = keys.IsKeyDown(hk);
+        }
+
+        if (!isThisKeyPressed) return false;
+    }
+    return true;
+}
+
+const Macro* FindTriggeredMacro(const std::vector<Macro>& macros, VkCode pressedVk, const IKeyStateProvider& keys) {
+    // 登録されている全マクロをチェック
+    for (const auto& macro : macros) {
+        if (IsMacroTriggered(macro, pressedVk, keys)) return &macro;
+    }
+    return nullptr;
+}
+
+VkCode RemapTarget(const Macro& macro) {
+    if (macro.hotkeys.size() != 1 || macro.holdKey != 0 || macro.actions.size() != 1) return 0;
+    if (!macro.hotstring.empty() || !macro.sequence.empty()) return 0;
+    // 実行の方針や時間の指定は実行側でしか守れないので、既定のままのときだけ
+    const Macro defaults;
+    if (macro.concurrency != defaults.concurrency || macro.allowAutoRepeat != defaults.allowAutoRepeat ||
+        macro.holdMs != defaults.holdMs || macro.interKeyMs != defaults.interKeyMs) {
+        return 0;
+    }
+    const MacroAction& action = macro.actions[0];
+    if (action.type != ACTION_COMBO || action.comboKeys.size() != 1) return 0;
+    return action.comboKeys[0];
+}
+
+// 起動キー hk が押されたとみなすキー（共通修飾キーは左右にも展開）
+static int ExpandHotkey(VkCode hk, VkCode out[3]) {
+    int n = 0;
+    out[n++] = hk;
+    if (hk == VKC_CONTROL) { out[n++] = VKC_LCONTROL; out[n++] = VKC_RCONTROL; }
+    else if (hk == VKC_MENU) { out[n++] = VKC_LMENU; out[n++] = VKC_RMENU; }
+    else if (hk == VKC_SHIFT) { out[n++] = VKC_LSHIFT; out[n++] = VKC_RSHIFT; }
+    return n;
+}
+
+std::vector<VkCode> RemapTargets(const std::vector<Macro>& macros) {
+    // キーごとに、起動キーに含むマクロの数（同じマクロは1回だけ数える）
+    uint32_t users[256] = {};
+    uint32_t lastMacro[256];
+    for (int k = 0; k < 256; k++) lastMacro[k] = UINT32_MAX;
+    for (uint32_t m = 0; m < (uint32_t)macros.size(); m++) {
+        for (VkCode hk : macros[m].hotkeys) {
+            VkCode keys[3];
+            int n = ExpandHotkey(hk, keys);
+            for (int i = 0; i < n; i++) {
+                if (keys[i] >= 256 || lastMacro[keys[i]] == m) continue;
+                lastMacro[keys[i]] = m;
+                users[keys[i]]++;
+            }
+        }
+    }
+
+    std::vector<VkCode> targets(macros.size(), 0);
+    for (size_t m = 0; m < macros.size(); m++) {
+        VkCode target = RemapTarget(macros[m]);
+        if (target == 0) continue;
+        VkCode keys[3];
+        int n = ExpandHotkey(macros[m].hotkeys[0], keys);
+        bool shared = false;
+        for (int i = 0; i < n; i++) {
+            if (keys[i] >= 256 || users[keys[i]] > 1) shared = true;
+        }
+        if (!shared) targets[m] = target;
+    }
+    return targets;
+}
+
+// --- イベント列の作成 ---
+
+static void AppendEvent(EventStream& out, InputEventType type, uint16_t code, bool extended) {
+    InputEvent ev;
+    ev.type = type;
+    ev.extended = extended;
+    ev.code = code;
+    out.events.push_back(ev);
+}
+
+// 直前に追加したイベントたちを1つの送信単位にする
+static void CloseSpan(EventStream& out, uint32_t first, uint32_t delayMs, bool cancellable) {
+    EventSpan span;
+    span.first = first;
+    span.count = (uint32_t)out.events.size() - first;
+    span.delayMs = delayMs;
+    span.cancellable = cancellable;
+    out.spans.push_back(span);
+}
+
+void CompileActions(const std::vector<MacroAction>& actions, EventStream& out, const CompileOptions& options) {
+    out.events.clear();
+    out.spans.clear();
+    // 間隔指定があるときは1文字ずつ送る
+    const uint32_t chunkChars = options.interKeyMs > 0 ? 1 : (options.textChunkChars > 0 ? options.textChunkChars : 1);
+
+    // 入力済みの文字を消す BackSpace は1回の送信にまとめる
+    if (options.eraseChars > 0) {
+        uint32_t first = (uint32_t)out.events.size();
+        for (uint32_t i = 0; i < options.eraseChars; i++) {
+            AppendEvent(out, EVENT_KEY_DOWN, VKC_BACK, false);
+            AppendEvent(out, EVENT_KEY_UP, VKC_BACK, false);
+        }
+        CloseSpan(out, first, options.interKeyMs, true);
+    }
+
+    for (const auto& action : actions) {
+        if (action.type == ACTION_COMBO) {
+            if (action.comboKeys.empty()) continue;
+            if (options.interKeyMs > 0) {
+                // 1キーずつ間隔をあけて押し、全部押したら holdMs 待ってから1キーずつ離す
+                for (size_t i = 0; i < action.comboKeys.size(); i++) {
+                    VkCode k = action.comboKeys[i];
+                    uint32_t first = (uint32_t)out.events.size();
+                    AppendEvent(out, EVENT_KEY_DOWN, k, IsExtendedKey(k));
+                    CloseSpan(out, first, i + 1 == action.comboKeys.size() ? options.holdMs : options.interKeyMs, false);
+                }
+                for (size_t i = 0; i < action.comboKeys.size(); i++) {
+                    VkCode k = action.comboKeys[i];
+                    uint32_t first = (uint32_t)out.events.size();
+                    AppendEvent(out, EVENT_KEY_UP, k, IsExtendedKey(k));
+                    bool last = (i + 1 == action.comboKeys.size());
+                    CloseSpan(out, first, last ? 0 : options.interKeyMs, last);
+                }
+                continue;
+            }
+            // 全押しを1回で送信し、安定のため少し待つ
+            uint32_t first = (uint32_t)out.events.size();
+            for (VkCode k : action.comboKeys) AppendEvent(out, EVENT_KEY_DOWN, k, IsExtendedKey(k));
+            CloseSpan(out, first, options.holdMs, false);
+            // 全離しも1回で送信（逆順推奨だが同時なら順序問わず）
+            first = (uint32_t)out.events.size();
+            for (VkCode k : action.comboKeys) AppendEvent(out, EVENT_KEY_UP, k, IsExtendedKey(k));
+            CloseSpan(out, first, 0, true);
+        }
+        else if (action.type == ACTION_TEXT) {
+            // Unicode文字列送信: 1文字ずつ押して離すイベントを、chunkChars 文字ごとにまとめて送信する
+            std::u16string wstr = Utf8ToUtf16(action.text);
+            size_t i = 0;
+            while (i < wstr.size()) {
+                uint32_t first = (uint32_t)out.events.size();
+                size_t end = std::min(wstr.size(), i + chunkChars);
+                // サロゲートペアの途中では区切らない
+                if (end < wstr.size() && end > i + 1 && wstr[end - 1] >= 0xD800 && wstr[end - 1] <= 0xDBFF) end--;
+                for (; i < end; i++) {
+                    AppendEvent(out, EVENT_UNICODE_DOWN, wstr[i], false);
+                    AppendEvent(out, EVENT_UNICODE_UP, wstr[i], false);
+                }
+                CloseSpan(out, first, options.interKeyMs, true);
+            }
+        }
+        else if (action.type == ACTION_RAW) {
+            // 直前と同時のイベントは同じ送信にまとめ、次のイベントまでの時間をそのまとまりの待機にする
+            uint8_t held[256] = {}; // 0: 離れている / 1: 押されている / 2: 拡張キーとして押されている
+            uint32_t heldCount = 0;
+            uint32_t first = (uint32_t)out.events.size();
+            for (const RawKeyEvent& ev : action.rawEvents) {
+                if (ev.delayMs > 0) {
+                    if (out.events.size() > first) {
+                        CloseSpan(out, first, ev.delayMs, heldCount == 0);
+                        first = (uint32_t)out.events.size();
+                    } else if (!out.spans.empty() && out.spans.back().cancellable) {
+                        out.spans.back().delayMs += ev.delayMs;
+                    } else {
+                        CloseSpan(out, first, ev.delayMs, true);
+                    }
+                }
+                uint8_t k = (uint8_t)ev.code;
+                if (ev.down && !held[k]) heldCount++;
+                if (!ev.down && held[k]) heldCount--;
+                held[k] = ev.down ? (ev.extended ? 2 : 1) : 0;
+                AppendEvent(out, ev.down ? EVENT_KEY_DOWN : EVENT_KEY_UP, ev.code, ev.extended != 0);
+            }
+            // 押されたままで終わっているキーは離しておく
+            for (int k = 0; k < 256; k++) {
+                if (held[k]) AppendEvent(out, EVENT_KEY_UP, (uint16_t)k, held[k] == 2);
+            }
+            if (out.events.size() > first) CloseSpan(out, first, 0, true);
+        }
+        else if (action.type == ACTION_WAIT) {
+            if (action.waitMs <= 0) continue;
+            // 待機は直前の送信単位の後ろに付け足す（先頭なら送信なしの単位を作る）
+            if (!out.spans.empty() && out.spans.back().cancellable) {
+                out.spans.back().delayMs += (uint32_t)action.waitMs;
+            } else {
+                CloseSpan(out, (uint32_t)out.events.size(), (uint32_t)action.waitMs, true);
+            }
+        }
+    }
+}
+
+// --- 実行 ---
+
+// 予定時刻 deadlineNs まで待ち、遅れを記録する
+// cancel があれば短い間隔で中止を確認し、中止されたら false を返す
+static bool WaitUntil(const ExecutionEnv& env, IMacroClock& clock, int64_t deadlineNs, const CancelToken* cancel) {
+    const int64_t kSliceNs = 5000000; // 中止の確認間隔 (5ms)
+    for (;;) {
+        if (cancel && cancel->IsCancelled()) return false;
+        int64_t now = clock.NowNs();
+        if (now >= deadlineNs) {
+            if (env.timingError) env.timingError->Record((uint64_t)(now - deadlineNs) / 1000);
+            return true;
+        }
+        int64_t target = deadlineNs;
+        if (cancel && deadlineNs - now > kSliceNs) target = now + kSliceNs;
+        clock.SleepUntil(target);
+    }
+}
+
+ExecutionResult ExecuteEventStream(const EventStream& stream, const ExecutionEnv& env,
+                                   const CancelToken* cancel) {
+    IInputSink& sink = *env.sink;
+    const IKeyStateProvider& keys = *env.keys;
+    IMacroClock& clock = env.clock ? *env.clock : DefaultMacroClock();
+    const int64_t kMs = 1000000;
+
+    ExecutionResult result = { 0, 0, false, 0 };
+    auto send = [&](const InputEvent* events, uint32_t count) {
+        if (result.submissions == 0) result.firstSendNs = clock.NowNs();
+        sink.Send(events, count);
+        result.submissions++;
+        result.events += count;
+    };
+
+    // 1. フック処理が落ち着くまでほんの少し待つ
+    int64_t deadline = clock.NowNs() + 10 * kMs;
+    WaitUntil(env, clock, deadline, nullptr);
+
+    // 2. 邪魔になりそうな修飾キー（Ctrl, Shift, Alt）が押されていたら、一時的に「離す」信号を送る
+    // チェックするキー: Shift, Ctrl, Alt (左右含む)
+    static const VkCode checkList[] = { VKC_LSHIFT, VKC_RSHIFT, VKC_SHIFT,
+                                        VKC_LCONTROL, VKC_RCONTROL, VKC_CONTROL,
+                                        VKC_LMENU, VKC_RMENU, VKC_MENU };
+    const uint32_t kCheckCount = sizeof(checkList) / sizeof(checkList[0]);
+    VkCode modifiersToRestore[kCheckCount]; // 「離したよ」と記録しておく
+    InputEvent batch[kCheckCount];
+    uint32_t releasedCount = 0;
+
+    for (VkCode vk : checkList) {
+        if (keys.IsKeyDown(vk)) {
+            InputEvent& ev = batch[releasedCount];
+            ev.type = EVENT_KEY_UP; // 一旦離す
+            ev.extended = IsExtendedKey(vk);
+            ev.code = vk;
+            modifiersToRestore[releasedCount++] = vk;
+        }
+    }
+    if (releasedCount > 0) send(batch, releasedCount);
+
+    // 念のため少し待機
+    deadline += 5 * kMs;
+    WaitUntil(env, clock, deadline, nullptr);
+
+    // 3. マクロ本番を実行（各まとまりの送信予定時刻は、前の予定時刻 + 待機時間）
+    if (!(cancel && cancel->IsCancelled())) {
+        for (const EventSpan& span : stream.spans) {
+            if (span.count > 0) send(&stream.events[span.first], span.count);
+            if (span.cancellable && cancel && cancel->IsCancelled()) { result.cancelled = true; break; }
+            if (span.delayMs == 0) continue;
+            deadline += (int64_t)span.delayMs * kMs;
+            // 押しっぱなしのキーがある間は中止せずに待つ
+            if (!WaitUntil(env, clock, deadline, span.cancellable ? cancel : nullptr)) { result.cancelled = true; break; }
+        }
+    } else {
+        result.cancelled = true;
+    }
+
+    // 4. マクロ終了後の処理: 修飾キー復帰
+    uint32_t restoreCount = 0;
+    for (uint32_t i = 0; i < releasedCount; i++) {
+        VkCode vk = modifiersToRestore[i];
+        if (keys.IsKeyDown(vk)) {
+            // まだ指があるなら、論理的にも押した状態に戻す
+            InputEvent& ev = batch[restoreCount++];
+            ev.type = EVENT_KEY_DOWN;
+            ev.extended = IsExtendedKey(vk);
+            ev.code = vk;
+        }
+        // 指を離していたら何もしない（これで押しっぱなし地獄から解放されます）
+    }
+    if (restoreCount > 0) send(batch, restoreCount);
+
+    return result;
+}
+
+ExecutionResult ExecuteMacro(const std::vector<MacroAction>& actions, IInputSink& sink, const IKeyStateProvider& keys,
+                             const CancelToken* cancel) {
+    EventStream stream;
+    CompileActions(actions, stream);
+    ExecutionEnv env = { &sink, &keys, nullptr, nullptr };
+    return ExecuteEventStream(stream, env, cancel);
+}
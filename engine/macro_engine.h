@@ -0,0 +1,211 @@
+﻿#pragma once
+
+// マクロエンジン本体（プラットフォーム非依存部分）
+// トリガー判定とマクロ実行はここにまとめ、実際のキー送信と物理キー状態の取得は
+// IInputSink / IKeyStateProvider 経由で行います。
+// Windows では SendInput / GetAsyncKeyState を使う実装 (macro_win32.h) を渡し、
+// それ以外の環境では RecordingInputSink と KeyStateBitmap (key_state.h) を渡して
+// ヘッドレスで動かせます。
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "histogram.h"
+#include "macro_clock.h"
+#include "vk_codes.h"
+
+// アクションの種類
+enum MacroActionType {
+    ACTION_COMBO,   // 複数のキーを同時に押して離す (例: Ctrl+C)
+    ACTION_TEXT,    // テキストを入力する
+    ACTION_WAIT,    // 待機する
+    ACTION_RAW,     // 記録したキー操作を記録したときの間隔で再生する
+    ACTION_LAYER_TOGGLE, // text のレイヤーを有効・無効にする（フックが切り替え、キーは送らない）
+    ACTION_LAYER_HOLD    // 起動キーを押している間だけ text のレイヤーを有効にする
+};
+
+// 記録したキー操作1つ分（RAW用。RawKeyRecorder が作る）
+struct RawKeyEvent {
+    VkCode code;
+    uint8_t down;     // 1: 押す / 0: 離す
+    uint8_t extended; // 拡張キーとして記録されたか (テンキーの Enter など)
+    uint32_t delayMs; // 直前のイベントからの時間（0 なら直前のイベントと一緒に送る）
+};
+
+// マクロの個々のアクション（操作）を定義する構造体
+struct MacroAction {
+    MacroActionType type;
+    std::vector<VkCode> comboKeys; // COMBO用: キーコードのリスト
+    std::string text;              // TEXT用: 文字列 (UTF-8) / LAYER_*用: レイヤー名
+    int waitMs;                    // WAIT用: 待機時間
+    std::vector<RawKeyEvent> rawEvents; // RAW用: 記録したキー操作
+};
+
+// 実行中のマクロがもう一度発動したときの扱い
+enum MacroConcurrency {
+    CONCURRENCY_DROP,       // 実行中なら無視する
+    CONCURRENCY_QUEUE_ONE,  // 実行中なら1回分だけ予約し、終わってからもう一度実行する
+    CONCURRENCY_RESTART,    // 実行中のものを中断して最初からやり直す
+    CONCURRENCY_PARALLEL    // 並列に実行する（以前の動作）
+};
+
+// マクロ全体を定義する構造体
+struct Macro {
+    std::vector<VkCode> hotkeys;       // 複数のキーを保持できるように vector に変更
+    std::string hotstring;             // 空でなければ、この文字列を入力したときに発動する (UTF-8)
+    std::vector<VkCode> sequence;      // 空でなければ、このキーを順に押したときに発動する (例: 無変換 → J → K)
+    int sequenceTimeoutMs = 1000;      // sequence で次のキーを待つ時間
+    VkCode holdKey = 0;                // 0 以外なら hotkeys[0] はデュアルロールキー: 押し続けるとこのキー、短く押すと actions
+    int tapTimeoutMs = 200;            // holdKey: これより短く押して離したらタップ
+    bool permissiveHold = true;        // holdKey: タップの時間内でも、後から押したキーを離したらホールドにする
+    std::vector<MacroAction> actions;  // 実行する一連の操作リスト
+    std::string layer;                 // 属するレイヤーの名前（空なら基本レイヤーで、常に有効）
+    MacroConcurrency concurrency = CONCURRENCY_DROP;
+    bool allowAutoRepeat = false;      // 押しっぱなしのキーリピートでも発動させるか
+    int holdMs = 10;                   // COMBO で全押ししてから離すまでの時間
+    int interKeyMs = 0;                // キーや文字を1つずつ送る間隔（0 ならまとめて送る）
+};
+
+// --- 出力イベント ---------------------------------------------------
+enum InputEventType : uint8_t {
+    EVENT_KEY_DOWN,     // 仮想キーを押す
+    EVENT_KEY_UP,       // 仮想キーを離す
+    EVENT_UNICODE_DOWN, // UTF-16 コードユニットを押す (KEYEVENTF_UNICODE)
+    EVENT_UNICODE_UP    // UTF-16 コードユニットを離す
+};
+
+struct InputEvent {
+    InputEventType type;
+    bool extended;  // 拡張キーフラグが必要か (キーイベントのみ)
+    uint16_t code;  // KEY_* なら仮想キーコード、UNICODE_* なら UTF-16 コードユニット
+};
+
+// キー送信先。Send に渡された events はひとまとまりとして送信されます。
+class IInputSink {
+public:
+    virtual ~IInputSink() {}
+    virtual void Send(const InputEvent* events, size_t count) = 0;
+};
+
+// 物理キーの押下状態の問い合わせ先
+class IKeyStateProvider {
+public:
+    virtual ~IKeyStateProvider() {}
+    virtual bool IsKeyDown(VkCode vk) const = 0;
+};
+
+// 送信されたイベントをそのまま記録するだけのシンク（ヘッドレス実行・計測用）
+class RecordingInputSink : public IInputSink {
+public:
+    void Send(const InputEvent* events, size_t count) override {
+        events_.insert(events_.end(), events, events + count);
+        submissions_++;
+    }
+    void Clear() { events_.clear(); submissions_ = 0; }
+
+    const std::vector<InputEvent>& Events() const { return events_; }
+    size_t Submissions() const { return submissions_; }
+
+private:
+    std::vector<InputEvent> events_;
+    size_t submissions_ = 0;
+};
+
+// --- エンジン関数 ---------------------------------------------------
+
+// UTF-8 を UTF-16 に変換する（不正なバイト列は U+FFFD に置き換え）
+std::u16string Utf8ToUtf16(const std::string& str);
+
+// 今押されたキー (pressedVk) で macro のホットキーが成立するか判定する
+bool IsMacroTriggered(const Macro& macro, VkCode pressedVk, const IKeyStateProvider& keys);
+
+// macro のホットキーの構成キーがすべて押されているか判定する（pressedVk は押下中とみなす）
+bool IsChordHeld(const Macro& macro, VkCode pressedVk, const IKeyStateProvider& keys);
+
+// 登録済みマクロの中から、今押されたキーで発動するものを探す（無ければ nullptr）
+// 全マクロを順に調べる素朴な実装です。フックからは HotkeyIndex を使ってください。
+const Macro* FindTriggeredMacro(const std::vector<Macro>& macros, VkCode pressedVk, const IKeyStateProvider& keys);
+
+// macro が「キー X で キー Y を押す」だけの 1:1 の置き換えなら Y を返す（違えば 0）
+// 起動キー1つ・キー1つの COMBO 1つだけで、ホットストリング・キー列を持たず、実行の方針と時間が既定のまま
+// (CONCURRENCY_DROP・キーリピートなし・holdMs 10・interKeyMs 0) のマクロが該当します。
+VkCode RemapTarget(const Macro& macro);
+
+// 同じ表に入る macros のうち、置き換えとしてフックが押す・離すを物理キーに合わせて直接送るものの置き換え先
+// （添字は macros と同じ。0 なら HotkeyIndex で扱う）
+// RemapTarget に該当しても、起動キーを別のマクロも起動キーに含む（例: A → B と Ctrl+A）ときは置き換えにしない。
+std::vector<VkCode> RemapTargets(const std::vector<Macro>& macros);
+
+// 実行中止の合図: generation が expected から変わったら中止する
+struct CancelToken {
+    const std::atomic<uint32_t>* generation;
+    uint32_t expected;
+
+    bool IsCancelled() const { return generation->load(std::memory_order_relaxed) != expected; }
+};
+
+// --- コンパイル済みイベント列 -------------------------------------
+// アクション列を、送信するイベントの配列と「どこまで送って何ms待つか」の区切りに変換したもの。
+// 文字列の UTF-16 変換や拡張キーの判定は作成時に済ませておき、実行時は配列をたどるだけにします。
+
+// events[first .. first + count) をまとめて送信し、その後 delayMs 待つ
+struct EventSpan {
+    uint32_t first;
+    uint32_t count;
+    uint32_t delayMs;
+    bool cancellable; // このまとまりの送信後は押しっぱなしのキーがない（ここで中止してよい）
+};
+
+struct EventStream {
+    std::vector<InputEvent> events;
+    std::vector<EventSpan> spans;
+};
+
+// イベント列の作り方の設定
+struct CompileOptions {
+    // TEXT を何文字（UTF-16 コードユニット）ずつまとめて送信するか
+    // 大きいほど送信回数は減りますが、他の入力が割り込めない時間が長くなります。
+    uint32_t textChunkChars = 32;
+    // COMBO で全押ししてから離すまでの時間
+    uint32_t holdMs = 10;
+    // 0 以外なら、COMBO のキーと TEXT の文字をまとめずに1つずつこの間隔で送る
+    uint32_t interKeyMs = 0;
+    // 最初に BackSpace を送る回数（ホットストリングで入力された文字を消す）
+    uint32_t eraseChars = 0;
+};
+
+// アクション列をイベント列に変換する
+// COMBO の全押し・全離しはそれぞれ1回の送信に、TEXT は textChunkChars 文字ずつの送信にまとめます
+// （interKeyMs が指定されていれば1つずつ）。RAW は待ち時間 0 で続くイベントを1回の送信にまとめ、
+// 記録の最後で押されたままのキーは離します。
+void CompileActions(const std::vector<MacroAction>& actions, EventStream& out,
+                    const CompileOptions& options = CompileOptions());
+
+// 1回の実行で送信した量
+struct ExecutionResult {
+    uint32_t submissions; // IInputSink::Send を呼んだ回数（修飾キーの解除・復帰を含む）
+    uint32_t events;      // 送信したイベント数
+    bool cancelled;
+    int64_t firstSendNs;  // 最初に Send を呼んだ時刻（IMacroClock::NowNs、送信しなければ 0）
+};
+
+// 実行に使うもの一式
+struct ExecutionEnv {
+    IInputSink* sink;
+    const IKeyStateProvider* keys;
+    IMacroClock* clock;            // nullptr なら DefaultMacroClock()
+    LatencyHistogram* timingError; // 各待機の「予定時刻からの遅れ」(µs) の記録先（nullptr なら記録しない）
+};
+
+// コンパイル済みのイベント列を実行する（呼び出し元のスレッドでブロックします）
+// 待機は開始時刻から積み上げた予定時刻まで待つので、送信や寝過ごしの遅れが後ろに累積しません。
+// cancel が渡された場合はアクションの合間と待機中に中止を確認し、中止されたら
+// 残りを飛ばして修飾キーの復帰だけ行います。
+ExecutionResult ExecuteEventStream(const EventStream& stream, const ExecutionEnv& env,
+                                   const CancelToken* cancel = nullptr);
+
+// マクロのアクション列をその場でコンパイルして実行する
+ExecutionResult ExecuteMacro(const std::vector<MacroAction>& actions, IInputSink& sink, const IKeyStateProvider& keys,
+                             const CancelToken* cancel = nullptr);
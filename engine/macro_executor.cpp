@@ -0,0 +1,168 @@
+﻿#include "macro_executor.h"
+
+MacroExecutor::MacroExecutor(IInputSink& sink, const IKeyStateProvider& keys, IMacroClock& clock, size_t queueCapacity)
+    : log_(nullptr), queue_(queueCapacity), stopping_(false),
+      semCount_(0), semWakeups_(0), queued_(0), running_(0), completed_(0), dropped_(0),
+      ignored_(0), restarted_(0), submissions_(0), events_(0) {
+    env_.sink = &sink;
+    env_.keys = &keys;
+    env_.clock = &clock;
+    env_.timingError = &timingError_;
+}
+
+MacroExecutor::~MacroExecutor() {
+    Stop();
+}
+
+void MacroExecutor::Start(size_t workerCount) {
+    stopping_.store(false);
+    for (size_t i = 0; i < workerCount; i++) {
+        workers_.emplace_back(&MacroExecutor::WorkerLoop, this);
+    }
+}
+
+void MacroExecutor::Stop() {
+    if (workers_.empty()) return;
+    stopping_.store(true);
+    for (size_t i = 0; i < workers_.size(); i++) Signal();
+    for (auto& t : workers_) t.join();
+    workers_.clear();
+}
+
+bool MacroExecutor::Submit(CompiledMacroPtr macro, bool isRepeat, int64_t triggerNs) {
+    if (!macro) return false;
+
+    if (isRepeat && !macro->allowAutoRepeat) {
+        ignored_.fetch_add(1, std::memory_order_relaxed);
+        Log(LOG_MACRO_IGNORED, *macro);
+        return false;
+    }
+
+    if (macro->concurrency != CONCURRENCY_PARALLEL) {
+        // 実行状態を 0 → 1 にできたときだけキューに積む。実行中なら方針に従って予約・中断・無視する
+        MacroRunState& rs = macro->runState;
+        uint32_t pending = rs.pending.load(std::memory_order_acquire);
+        for (;;) {
+            if (pending == 0) {
+                if (rs.pending.compare_exchange_weak(pending, 1, std::memory_order_acq_rel)) break;
+                continue;
+            }
+            if (macro->concurrency == CONCURRENCY_DROP || (macro->concurrency == CONCURRENCY_QUEUE_ONE && pending == 2)) {
+                ignored_.fetch_add(1, std::memory_order_relaxed);
+                Log(LOG_MACRO_IGNORED, *macro);
+                return false;
+            }
+            if (macro->concurrency == CONCURRENCY_RESTART) {
+                // 中止の世代を予約より先に進める。Run は予約を受け取ってから世代を読むので、
+                // 予約できていれば再実行の回はこの世代で始まり、自分の中止で止まることはない。
+                // 予約できなかったとき（実行が終わった・他の発動が先に予約した）は世代を進め直してやり直す
+                rs.cancelGeneration.fetch_add(1, std::memory_order_seq_cst);
+                if (!rs.pending.compare_exchange_weak(pending, 2, std::memory_order_seq_cst)) continue;
+                restarted_.fetch_add(1, std::memory_order_relaxed);
+                Log(LOG_MACRO_RESTARTED, *macro);
+                return true;
+            }
+            // 実行中の回が終わったら、同じ実行スレッドがもう1回実行する
+            if (!rs.pending.compare_exchange_weak(pending, 2, std::memory_order_acq_rel)) continue;
+            return true;
+        }
+    }
+    // 取り出し側が先に減らしても負にならないよう、積む前に数えておく
+    queued_.fetch_add(1, std::memory_order_relaxed);
+    const CompiledMacro* raw = macro.get();
+    Job job = { std::move(macro), triggerNs };
+    if (!queue_.TryPush(std::move(job))) {
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        Log(LOG_MACRO_DROPPED, *raw);
+        if (raw->concurrency != CONCURRENCY_PARALLEL) raw->runState.pending.store(0, std::memory_order_release);
+        return false;
+    }
+    Signal();
+    return true;
+}
+
+MacroExecutor::Stats MacroExecutor::GetStats() const {
+    Stats s;
+    s.queued = queued_.load(std::memory_order_relaxed);
+    s.running = running_.load(std::memory_order_relaxed);
+    s.completed = completed_.load(std::memory_order_relaxed);
+    s.dropped = dropped_.load(std::memory_order_relaxed);
+    s.ignored = ignored_.load(std::memory_order_relaxed);
+    s.restarted = restarted_.load(std::memory_order_relaxed);
+    s.submissions = submissions_.load(std::memory_order_relaxed);
+    s.events = events_.load(std::memory_order_relaxed);
+    return s;
+}
+
+void MacroExecutor::Signal() {
+    // 待っているスレッドがいなければカウントを増やすだけで済む
+    if (semCount_.fetch_add(1, std::memory_order_release) < 0) {
+        std::lock_guard<std::mutex> lock(semMutex_);
+        semWakeups_++;
+        semCond_.notify_one();
+    }
+}
+
+void MacroExecutor::Wait() {
+    if (semCount_.fetch_sub(1, std::memory_order_acquire) > 0) return;
+    std::unique_lock<std::mutex> lock(semMutex_);
+    semCond_.wait(lock, [this] { return semWakeups_ > 0; });
+    semWakeups_--;
+}
+
+void MacroExecutor::WorkerLoop() {
+    for (;;) {
+        Wait();
+        Job job;
+        if (!queue_.TryPop(job)) {
+            // Signal 1回につき Push 1回なので、取り出せないのは Stop からの合図のときだけ
+            if (stopping_.load()) return;
+            continue;
+        }
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        running_.fetch_add(1, std::memory_order_relaxed);
+        Run(*job.macro, job.triggerNs);
+        running_.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+void MacroExecutor::Run(const CompiledMacro& macro, int64_t triggerNs) {
+    if (macro.concurrency == CONCURRENCY_PARALLEL) {
+        Record(macro, Execute(macro, triggerNs, nullptr));
+        return;
+    }
+
+    MacroRunState& rs = macro.runState;
+    do {
+        // 世代は予約 (pending) を受け取った後に読む。Submit は世代を進めてから予約するので、
+        // 受け取った予約より前の中止で、この回が止まることはない
+        CancelToken cancel = { &rs.cancelGeneration, rs.cancelGeneration.load(std::memory_order_seq_cst) };
+        Record(macro, Execute(macro, triggerNs, &cancel));
+        // 予約による2回目以降は発動時刻が分からないので、最初の送信までの時間は計らない
+        triggerNs = 0;
+        // 実行中に予約が入っていれば (2 → 1) そのまま続けてもう1回
+    } while (rs.pending.fetch_sub(1, std::memory_order_seq_cst) == 2);
+}
+
+ExecutionResult MacroExecutor::Execute(const CompiledMacro& macro, int64_t triggerNs, const CancelToken* cancel) {
+    Log(LOG_MACRO_STARTED, macro);
+    int64_t start = env_.clock->NowNs();
+    ExecutionResult result = ExecuteEventStream(macro.stream, env_, cancel);
+    runTime_.Record((uint64_t)(env_.clock->NowNs() - start) / 1000);
+    if (triggerNs != 0 && result.firstSendNs >= triggerNs) {
+        triggerLatency_.Record((uint64_t)(result.firstSendNs - triggerNs) / 1000);
+    }
+    return result;
+}
+
+void MacroExecutor::Record(const CompiledMacro& macro, const ExecutionResult& result) {
+    MacroRunState& rs = macro.runState;
+    rs.runs.fetch_add(1, std::memory_order_relaxed);
+    rs.submissions.fetch_add(result.submissions, std::memory_order_relaxed);
+    rs.events.fetch_add(result.events, std::memory_order_relaxed);
+    submissions_.fetch_add(result.submissions, std::memory_order_relaxed);
+    events_.fetch_add(result.events, std::memory_order_relaxed);
+    completed_.fetch_add(1, std::memory_order_relaxed);
+    Log(result.cancelled ? LOG_MACRO_CANCELLED : LOG_MACRO_FINISHED, macro, (int64_t)result.events);
+}
@@ -0,0 +1,102 @@
+﻿#pragma once
+
+// マクロ実行用の常駐スレッドプール
+// フックからは Submit でキューに積むだけにして、スレッドの生成やアクション列のコピーを
+// フックのスレッドで行わないようにします。キューが満杯のときは積まずに捨てます。
+// 実行中のマクロが再び発動したときは、マクロごとの MacroConcurrency に従います。
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.h"
+#include "compiled_macro.h"
+#include "event_log.h"
+
+class MacroExecutor {
+public:
+    struct Stats {
+        uint64_t queued;    // キューで実行待ちの数
+        uint64_t running;   // 実行中の数
+        uint64_t completed; // 実行し終えた数（累計）
+        uint64_t dropped;   // キューが満杯で捨てた数（累計）
+        uint64_t ignored;   // 実行中・キーリピートのため無視した数（累計）
+        uint64_t restarted; // 中断して再実行した数（累計）
+        uint64_t submissions; // IInputSink::Send を呼んだ回数（累計）
+        uint64_t events;      // 送信したイベント数（累計）
+    };
+
+    MacroExecutor(IInputSink& sink, const IKeyStateProvider& keys, IMacroClock& clock, size_t queueCapacity = 64);
+    ~MacroExecutor();
+
+    // 発動・実行の記録先を設定する（Start の前に呼ぶ。nullptr なら記録しない）
+    void SetEventLog(EventLog* log) { log_ = log; }
+
+    // 実行スレッドを起動する / 止める（Stop は実行中のマクロが終わるまで待つ）
+    void Start(size_t workerCount);
+    void Stop();
+
+    // マクロを実行待ちに積む（積まなかったら false）。フックのスレッドから呼ばれる前提で、ロックを取りません。
+    // isRepeat はホットキーを押しっぱなしにしたときのキーリピートによる発動かどうか。
+    // triggerNs はホットキーを受け取った時刻 (IMacroClock::NowNs)。0 以外なら最初の送信までの時間を計ります。
+    bool Submit(CompiledMacroPtr macro, bool isRepeat = false, int64_t triggerNs = 0);
+
+    Stats GetStats() const;
+
+    // 待機の予定時刻からの遅れ (µs) の分布
+    const LatencyHistogram& TimingErrors() const { return timingError_; }
+    // ホットキーを受け取ってから最初のイベントを送るまで (µs) の分布
+    const LatencyHistogram& TriggerLatency() const { return triggerLatency_; }
+    // マクロ1回の実行にかかった時間 (µs) の分布
+    const LatencyHistogram& RunTimes() const { return runTime_; }
+    void ResetHistograms() {
+        timingError_.Reset();
+        triggerLatency_.Reset();
+        runTime_.Reset();
+    }
+
+private:
+    // キューに積む1件分
+    struct Job {
+        CompiledMacroPtr macro;
+        int64_t triggerNs;
+    };
+
+    void WorkerLoop();
+    void Run(const CompiledMacro& macro, int64_t triggerNs);
+    ExecutionResult Execute(const CompiledMacro& macro, int64_t triggerNs, const CancelToken* cancel);
+    void Record(const CompiledMacro& macro, const ExecutionResult& result);
+    void Log(LogEventType event, const CompiledMacro& macro, int64_t arg = 0) {
+        if (log_) log_->Push(event, macro.id, arg);
+    }
+
+    // 待機中のスレッドがいるときだけ mutex に触る軽量セマフォ
+    void Signal();
+    void Wait();
+
+    ExecutionEnv env_;
+    EventLog* log_;
+    LatencyHistogram timingError_;
+    LatencyHistogram triggerLatency_;
+    LatencyHistogram runTime_;
+    BoundedQueue<Job> queue_;
+    std::vector<std::thread> workers_;
+    std::atomic<bool> stopping_;
+
+    std::atomic<int> semCount_;
+    std::mutex semMutex_;
+    std::condition_variable semCond_;
+    int semWakeups_;
+
+    std::atomic<uint64_t> queued_;
+    std::atomic<uint64_t> running_;
+    std::atomic<uint64_t> completed_;
+    std::atomic<uint64_t> dropped_;
+    std::atomic<uint64_t> ignored_;
+    std::atomic<uint64_t> restarted_;
+    std::atomic<uint64_t> submissions_;
+    std::atomic<uint64_t> events_;
+};
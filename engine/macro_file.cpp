@@ -0,0 +1,623 @@
+﻿#include "macro_file.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+#include "vk_names.h"
+
+VkCode StringToVkCode(const std::string& str) {
+    if (str.empty()) return 0;
+
+    // 16進数 ('0x...') として解析を試みる
+    if (str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+        try {
+            return (VkCode)std::stoul(str, nullptr, 16);
+        } catch (...) {
+            // 解析失敗
+        }
+    }
+
+    // キーの名前（"VK_CONTROL", "Ctrl", "A" など。vk_names.cpp の表を引く）
+    return VkNameToCode(str.data(), str.size());
+}
+
+// 実行方針の名前（POLICY 行のデータ部分）
+static const char* const kConcurrencyNames[] = { "drop", "queue", "restart", "parallel" };
+
+// v2 形式の1行目
+static const char kFormatV2Header[] = "#MACROS 2";
+
+// 読み込みバッファ内の文字列の範囲（コピーせずに行・項目を切り出すために使う）
+struct TextSpan {
+    const char* begin;
+    const char* end;
+
+    size_t size() const { return (size_t)(end - begin); }
+    bool empty() const { return begin == end; }
+    bool operator==(const char* s) const {
+        size_t n = strlen(s);
+        return size() == n && memcmp(begin, s, n) == 0;
+    }
+};
+
+// 前後の空白 (スペース・タブ) を除く
+static TextSpan Trim(TextSpan s) {
+    while (s.begin < s.end && (*s.begin == ' ' || *s.begin == '\t')) s.begin++;
+    while (s.end > s.begin && (s.end[-1] == ' ' || s.end[-1] == '\t')) s.end--;
+    return s;
+}
+
+// s の中で最後の c の位置（無ければ nullptr）
+static const char* FindLast(TextSpan s, char c) {
+    for (const char* p = s.end; p > s.begin; p--) {
+        if (p[-1] == c) return p - 1;
+    }
+    return nullptr;
+}
+
+// s の中で最初の c の位置（無ければ s.end）
+static const char* FindFirst(TextSpan s, char c) {
+    const char* found = (const char*)memchr(s.begin, c, s.size());
+    return found ? found : s.end;
+}
+
+// 先頭の空白・符号に続く10進数を読む（std::stoi と同じく、数字の後ろの文字は無視する）
+static bool ParseInt(TextSpan s, int& value) {
+    const char* p = s.begin;
+    while (p < s.end && isspace((unsigned char)*p)) p++;
+    bool negative = false;
+    if (p < s.end && (*p == '+' || *p == '-')) negative = (*p++ == '-');
+    if (p == s.end || *p < '0' || *p > '9') return false;
+    long long v = 0;
+    while (p < s.end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p++ - '0');
+        if (v > 0x7FFFFFFF) return false;
+    }
+    value = (int)(negative ? -v : v);
+    return true;
+}
+
+// RAW 行の1項目 ("+35" / "D41" / "U0D*") を読む。"+数字" は pendingDelay に足し、キーなら ev を埋めて true を返す
+static bool ParseRawToken(TextSpan s, uint32_t& pendingDelay, RawKeyEvent& ev) {
+    if (s.empty()) return false;
+    if (*s.begin == '+') {
+        int ms;
+        if (ParseInt(TextSpan{ s.begin + 1, s.end }, ms) && ms > 0) pendingDelay += (uint32_t)ms;
+        return false;
+    }
+    if (*s.begin != 'D' && *s.begin != 'U') return false;
+    ev.down = *s.begin == 'D' ? 1 : 0;
+    ev.extended = 0;
+    const char* end = s.end;
+    if (end[-1] == '*') {
+        ev.extended = 1;
+        end--;
+    }
+    uint32_t v = 0;
+    const char* p = s.begin + 1;
+    for (; p < end; p++) {
+        char c = *p;
+        int d = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+                (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+        if (d < 0 || v > 0xFF) return false;
+        v = v * 16 + (uint32_t)d;
+    }
+    if (p == s.begin + 1 || v == 0 || v > 0xFF) return false;
+    ev.code = (VkCode)v;
+    ev.delayMs = pendingDelay;
+    pendingDelay = 0;
+    return true;
+}
+
+// キーの表記を読む。"0x41" 形式は16進数、それ以外はキーの名前として扱う
+static VkCode ParseKey(TextSpan s) {
+    if (s.size() > 2 && s.begin[0] == '0' && (s.begin[1] == 'x' || s.begin[1] == 'X')) {
+        uint32_t v = 0;
+        const char* p = s.begin + 2;
+        for (; p < s.end; p++) {
+            char c = *p;
+            int d = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 :
+                    (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+            if (d < 0 || v > 0xFFF) break;
+            v = v * 16 + (uint32_t)d;
+        }
+        if (p > s.begin + 2) return (VkCode)v;
+    }
+    return VkNameToCode(s.begin, s.size());
+}
+
+// POLICY 行のデータ (例: "restart", "queue:repeat") を解析する
+static bool ParsePolicy(TextSpan data, MacroConcurrency& concurrency, bool& allowAutoRepeat) {
+    const char* colon = FindFirst(data, ':');
+    TextSpan name = { data.begin, colon };
+    allowAutoRepeat = (colon < data.end) && (TextSpan{ colon + 1, data.end } == "repeat");
+    for (int i = 0; i < 4; i++) {
+        if (name == kConcurrencyNames[i]) {
+            concurrency = (MacroConcurrency)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// TIMING 行のデータ "押しっぱなし時間:キー間隔" (ms) を解析する
+static bool ParseTiming(TextSpan data, int& holdMs, int& interKeyMs) {
+    const char* colon = FindFirst(data, ':');
+    return colon < data.end && ParseInt(TextSpan{ data.begin, colon }, holdMs) &&
+           ParseInt(TextSpan{ colon + 1, data.end }, interKeyMs);
+}
+
+// 発動条件（ホットキー・ホットストリング・キー列）のどれかがあるか
+static bool HasTrigger(const Macro& m) {
+    return !m.hotkeys.empty() || !m.hotstring.empty() || !m.sequence.empty();
+}
+
+// ホットキーの組み合わせのハッシュ（FNV-1a）
+struct HotkeysHash {
+    size_t operator()(const std::vector<VkCode>& hotkeys) const {
+        uint64_t h = 14695981039346656037ULL;
+        for (VkCode vk : hotkeys) {
+            h ^= vk;
+            h *= 1099511628211ULL;
+        }
+        return (size_t)h;
+    }
+};
+
+// p から行末までを切り出し、p を次の行の先頭に進める（行末の \r は除く）
+static TextSpan NextLine(const char*& p, const char* end) {
+    // 空のバッファ (data が nullptr のこともある) は memchr に渡さない
+    const char* eol = p < end ? (const char*)memchr(p, '\n', (size_t)(end - p)) : nullptr;
+    if (!eol) eol = end;
+    TextSpan line = { p, eol };
+    p = (eol < end) ? eol + 1 : end;
+    if (!line.empty() && line.end[-1] == '\r') line.end--;
+    return line;
+}
+
+// v1 形式: 1行に1アクション "ホットキー1, ホットキー2, ..., 種類, データ"
+// 同じホットキーの行は、ホットキーの組み合わせをキーにしたハッシュ表で同じマクロにまとめます。
+// データは最後のカンマより後ろなので、カンマを含む TEXT は途中から読まれます（v2 で解消）。
+static void ParseMacrosV1(const char* p, const char* end, std::vector<Macro>& macros) {
+    // ホットキーの組み合わせ → macros 内の添字
+    std::unordered_map<std::vector<VkCode>, size_t, HotkeysHash> macroByHotkeys;
+    std::vector<VkCode> hks;
+    // 直前の行のホットキー部分（同じマクロの行は連続するので、一致すれば解析を省く）
+    TextSpan prevHotkeysPart = { nullptr, nullptr };
+    size_t prevTarget = 0;
+
+    while (p < end) {
+        TextSpan line = NextLine(p, end);
+        if (line.empty() || *line.begin == '#') continue;
+
+        // 最後の2つ (Type, Data) とそれ以前 (Hotkeys) に分ける
+        const char* lastComma = FindLast(line, ',');
+        if (!lastComma) continue;
+        TextSpan dataPart = Trim(TextSpan{ lastComma + 1, line.end }); // Data
+
+        // Dataの前の部分 (Hotkeys..., Type)
+        TextSpan preData = { line.begin, lastComma };
+        const char* typeComma = FindLast(preData, ',');
+        if (!typeComma) continue;
+
+        TextSpan typeStr = Trim(TextSpan{ typeComma + 1, lastComma }); // Type
+        TextSpan hotkeysPart = { line.begin, typeComma };              // Hotkeys...
+
+        // アクション作成
+        MacroAction action;
+        action.waitMs = 0;
+        // POLICY / TIMING 行はアクションではなく、マクロの設定を表す（古いバージョンでは読み飛ばされる）
+        bool isPolicy = false, isTiming = false;
+        MacroConcurrency concurrency = CONCURRENCY_DROP;
+        bool allowAutoRepeat = false;
+        int holdMs = 10, interKeyMs = 0;
+        if (typeStr == "POLICY") {
+            if (!ParsePolicy(dataPart, concurrency, allowAutoRepeat)) continue;
+            isPolicy = true;
+        } else if (typeStr == "TIMING") {
+            if (!ParseTiming(dataPart, holdMs, interKeyMs)) continue;
+            isTiming = true;
+        } else if (typeStr == "COMBO") {
+            // v1 のコンボは10進数を ':' で区切る
+            action.type = ACTION_COMBO;
+            const char* q = dataPart.begin;
+            while (q < dataPart.end) {
+                const char* colon = FindFirst(TextSpan{ q, dataPart.end }, ':');
+                int code;
+                if (ParseInt(TextSpan{ q, colon }, code)) action.comboKeys.push_back((VkCode)code);
+                q = colon + 1;
+            }
+        } else if (typeStr == "TEXT") {
+            action.type = ACTION_TEXT;
+            action.text.assign(dataPart.begin, dataPart.end);
+        } else if (typeStr == "WAIT") {
+            action.type = ACTION_WAIT;
+            if (!ParseInt(dataPart, action.waitMs)) action.waitMs = 0;
+        } else {
+            // 旧フォーマット互換用 (KEYDOWN/KEYUPなど) は今回は簡易化のため省略
+            // 必要ならここにロジック追加
+            continue;
+        }
+
+        // ホットキー解析（直前の行と同じ書き方ならそのマクロを使う）
+        size_t target;
+        if (prevHotkeysPart.begin && hotkeysPart.size() == prevHotkeysPart.size() &&
+            memcmp(hotkeysPart.begin, prevHotkeysPart.begin, hotkeysPart.size()) == 0) {
+            target = prevTarget;
+        } else {
+            hks.clear();
+            const char* q = hotkeysPart.begin;
+            while (q < hotkeysPart.end) {
+                const char* comma = FindFirst(TextSpan{ q, hotkeysPart.end }, ',');
+                TextSpan token = Trim(TextSpan{ q, comma });
+                if (!token.empty()) hks.push_back(ParseKey(token));
+                q = comma + 1;
+            }
+            if (hks.empty()) continue;
+
+            auto found = macroByHotkeys.find(hks);
+            if (found != macroByHotkeys.end()) {
+                target = found->second;
+            } else {
+                target = macros.size();
+                Macro new_m;
+                new_m.hotkeys = hks;
+                macros.push_back(new_m);
+                macroByHotkeys.emplace(hks, target);
+            }
+            prevHotkeysPart = hotkeysPart;
+            prevTarget = target;
+        }
+
+        Macro& m = macros[target];
+        if (isPolicy) {
+            m.concurrency = concurrency;
+            m.allowAutoRepeat = allowAutoRepeat;
+        } else if (isTiming) {
+            m.holdMs = holdMs;
+            m.interKeyMs = interKeyMs;
+        } else {
+            m.actions.push_back(std::move(action));
+        }
+    }
+}
+
+// "バイト数:本文" を読み、本文の後ろの改行まで進める（本文はバイト数で切り出し、改行を探さない）
+// 形式が壊れていれば行末まで読み飛ばして false を返す
+static bool ReadLengthPrefixed(const char*& p, const char* end, TextSpan& text) {
+    const char* colon = p;
+    long long length = 0;
+    while (colon < end && *colon >= '0' && *colon <= '9' && length <= end - p) {
+        length = length * 10 + (*colon++ - '0');
+    }
+    if (colon == p || colon == end || *colon != ':' || length > end - (colon + 1)) {
+        NextLine(p, end);
+        return false;
+    }
+    text.begin = colon + 1;
+    text.end = text.begin + length;
+    p = text.end;
+    NextLine(p, end);
+    return true;
+}
+
+// v2 形式: "MACRO ホットキー..." から "END" までが1つのマクロ
+// 各行は "種類 データ" で、先頭から1回読むだけで解析できます。TEXT は "TEXT バイト数:本文" で、
+// 本文はバイト数の分だけそのまま読むため、カンマや改行を含んでいても壊れません。
+// 知らない種類の行は読み飛ばします（新しいバージョンで増えた設定を古いバージョンで読んでも壊れない）。
+// "LAYER 名前" 行から次の LAYER 行までのマクロはそのレイヤーに属する（名前の無い "LAYER" 行でベースレイヤーに戻る）
+static void ParseMacrosV2(const char* p, const char* end, std::vector<Macro>& macros) {
+    Macro* current = nullptr;
+    std::string currentLayer;
+    while (p < end) {
+        // 行頭の種類を読む
+        const char* lineStart = p;
+        while (p < end && *p != ' ' && *p != '\n' && *p != '\r') p++;
+        TextSpan type = { lineStart, p };
+        if (p < end && *p == ' ') p++;
+
+        if (type == "TEXT" || type == "HOTSTRING") {
+            TextSpan text;
+            if (!ReadLengthPrefixed(p, end, text)) continue; // 壊れた行は捨てる
+            if (!current) continue;
+            if (type == "HOTSTRING") {
+                current->hotstring.assign(text.begin, text.end);
+            } else {
+                MacroAction action;
+                action.type = ACTION_TEXT;
+                action.text.assign(text.begin, text.end);
+                action.waitMs = 0;
+                current->actions.push_back(std::move(action));
+            }
+            continue;
+        }
+
+        TextSpan data = Trim(NextLine(p, end));
+        if (type.empty() || *type.begin == '#') continue;
+
+        if (type == "LAYER") {
+            currentLayer.assign(data.begin, data.end);
+            current = nullptr;
+            continue;
+        }
+        if (type == "MACRO") {
+            macros.push_back(Macro());
+            current = &macros.back();
+            current->layer = currentLayer;
+            const char* q = data.begin;
+            while (q < data.end) {
+                const char* space = FindFirst(TextSpan{ q, data.end }, ' ');
+                if (space > q) current->hotkeys.push_back(ParseKey(TextSpan{ q, space }));
+                q = space + 1;
+            }
+            // ホットキーが無くても、続く HOTSTRING / SEQUENCE 行で発動するマクロかもしれないので残す
+            continue;
+        }
+        if (!current) continue;
+
+        if (type == "END") {
+            current = nullptr;
+        } else if (type == "POLICY") {
+            MacroConcurrency concurrency;
+            bool allowAutoRepeat;
+            if (ParsePolicy(data, concurrency, allowAutoRepeat)) {
+                current->concurrency = concurrency;
+                current->allowAutoRepeat = allowAutoRepeat;
+            }
+        } else if (type == "TIMING") {
+            int holdMs, interKeyMs;
+            if (ParseTiming(data, holdMs, interKeyMs)) {
+                current->holdMs = holdMs;
+                current->interKeyMs = interKeyMs;
+            }
+        } else if (type == "COMBO") {
+            MacroAction action;
+            action.type = ACTION_COMBO;
+            action.waitMs = 0;
+            const char* q = data.begin;
+            while (q < data.end) {
+                const char* space = FindFirst(TextSpan{ q, data.end }, ' ');
+                if (space > q) action.comboKeys.push_back(ParseKey(TextSpan{ q, space }));
+                q = space + 1;
+            }
+            current->actions.push_back(std::move(action));
+        } else if (type == "WAIT") {
+            MacroAction action;
+            action.type = ACTION_WAIT;
+            if (!ParseInt(data, action.waitMs)) action.waitMs = 0;
+            current->actions.push_back(std::move(action));
+        } else if (type == "SEQUENCE") {
+            // "SEQUENCE 待ちms キー..."（待ち時間が読めなければ行ごと捨てる）
+            const char* space = FindFirst(data, ' ');
+            int timeoutMs;
+            if (!ParseInt(TextSpan{ data.begin, space }, timeoutMs) || timeoutMs <= 0) continue;
+            current->sequence.clear();
+            current->sequenceTimeoutMs = timeoutMs;
+            const char* q = space + 1;
+            while (q < data.end) {
+                space = FindFirst(TextSpan{ q, data.end }, ' ');
+                if (space > q) current->sequence.push_back(ParseKey(TextSpan{ q, space }));
+                q = space + 1;
+            }
+        } else if (type == "HOLD") {
+            // "HOLD キー ms [strict]"（キーか時間が読めなければ行ごと捨てる）
+            const char* space = FindFirst(data, ' ');
+            VkCode holdKey = ParseKey(TextSpan{ data.begin, space });
+            const char* rest = space < data.end ? space + 1 : data.end;
+            const char* space2 = FindFirst(TextSpan{ rest, data.end }, ' ');
+            int tapTimeoutMs;
+            if (holdKey == 0 || !ParseInt(TextSpan{ rest, space2 }, tapTimeoutMs) || tapTimeoutMs <= 0) continue;
+            current->holdKey = holdKey;
+            current->tapTimeoutMs = tapTimeoutMs;
+            current->permissiveHold = !(Trim(TextSpan{ space2, data.end }) == "strict");
+        } else if (type == "RAW") {
+            MacroAction action;
+            action.type = ACTION_RAW;
+            action.waitMs = 0;
+            uint32_t pendingDelay = 0;
+            RawKeyEvent ev;
+            const char* q = data.begin;
+            while (q < data.end) {
+                const char* space = FindFirst(TextSpan{ q, data.end }, ' ');
+                if (ParseRawToken(TextSpan{ q, space }, pendingDelay, ev)) action.rawEvents.push_back(ev);
+                q = space + 1;
+            }
+            if (!action.rawEvents.empty()) current->actions.push_back(std::move(action));
+        } else if (type == "LAYER_TOGGLE" || type == "LAYER_HOLD") {
+            // "LAYER_TOGGLE 名前" / "LAYER_HOLD 名前"（名前の無い行は捨てる）
+            if (data.empty()) continue;
+            MacroAction action;
+            action.type = type == "LAYER_TOGGLE" ? ACTION_LAYER_TOGGLE : ACTION_LAYER_HOLD;
+            action.text.assign(data.begin, data.end);
+            action.waitMs = 0;
+            current->actions.push_back(std::move(action));
+        }
+    }
+}
+
+void ParseMacros(const char* data, size_t size, std::vector<Macro>& macros) {
+    macros.clear();
+    const char* p = data;
+    const char* end = data + size;
+    // UTF-8 の BOM は読み飛ばす
+    if (size >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) p += 3;
+
+    // 1行目で形式を判定する（ヘッダーが無ければ v1）
+    const char* body = p;
+    TextSpan first = NextLine(body, end);
+    if (first == kFormatV2Header) {
+        ParseMacrosV2(body, end, macros);
+    } else {
+        ParseMacrosV1(p, end, macros);
+    }
+
+    // 設定の行しかないマクロは実行内容がなく、発動条件 (ホットキー・ホットストリング・キー列) の無いマクロは発動しないので捨てる
+    macros.erase(std::remove_if(macros.begin(), macros.end(), [](const Macro& m) { return !IsSavableMacro(m); }),
+                 macros.end());
+}
+
+bool IsSavableMacro(const Macro& macro) {
+    return !macro.actions.empty() && HasTrigger(macro);
+}
+
+bool LoadMacrosFromFile(const std::string& filename, std::vector<Macro>& macros) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        // 初回起動時などはファイルがないのが普通なので、エラーにはしない
+        std::cout << "[INFO] Macro file not found. Starting with empty list." << std::endl;
+        return false;
+    }
+
+    // ファイル全体を1回で読み込み、バッファ上の範囲のまま解析する
+    std::string buffer;
+    file.seekg(0, std::ios::end);
+    std::streamoff fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+    if (fileSize > 0) {
+        buffer.resize((size_t)fileSize);
+        file.read(&buffer[0], fileSize);
+        buffer.resize((size_t)file.gcount());
+    }
+
+    ParseMacros(buffer.data(), buffer.size(), macros);
+    std::cout << "[INFO] Loaded macros." << std::endl;
+    return true;
+}
+
+// キーを "0x41" 形式で書き足す
+static void AppendKey(std::string& out, VkCode vk) {
+    char buf[8];
+    snprintf(buf, sizeof(buf), "0x%02X", vk);
+    out += buf;
+}
+
+// マクロ1つを "MACRO" から "END" までの行にして書き足す
+static void AppendMacro(std::string& out, const Macro& macro) {
+    out += "MACRO";
+    for (VkCode vk : macro.hotkeys) {
+        out += ' ';
+        AppendKey(out, vk);
+    }
+    out += '\n';
+    if (!macro.hotstring.empty()) {
+        out += "HOTSTRING " + std::to_string(macro.hotstring.size()) + ":";
+        out += macro.hotstring;
+        out += '\n';
+    }
+    if (!macro.sequence.empty()) {
+        out += "SEQUENCE " + std::to_string(macro.sequenceTimeoutMs);
+        for (VkCode vk : macro.sequence) {
+            out += ' ';
+            AppendKey(out, vk);
+        }
+        out += '\n';
+    }
+    if (macro.holdKey != 0) {
+        out += "HOLD ";
+        AppendKey(out, macro.holdKey);
+        out += ' ' + std::to_string(macro.tapTimeoutMs);
+        if (!macro.permissiveHold) out += " strict";
+        out += '\n';
+    }
+
+    // 実行方針が既定 (実行中は無視・リピートなし) 以外なら POLICY 行を書く
+    if (macro.concurrency != CONCURRENCY_DROP || macro.allowAutoRepeat) {
+        out += "POLICY ";
+        out += kConcurrencyNames[macro.concurrency];
+        if (macro.allowAutoRepeat) out += ":repeat";
+        out += '\n';
+    }
+    // 押しっぱなし時間・キー間隔が既定 (10ms / 0ms) 以外なら TIMING 行を書く
+    if (macro.holdMs != 10 || macro.interKeyMs != 0) {
+        out += "TIMING " + std::to_string(macro.holdMs) + ":" + std::to_string(macro.interKeyMs) + "\n";
+    }
+
+    for (const auto& action : macro.actions) {
+        if (action.type == ACTION_COMBO) {
+            out += "COMBO";
+            for (VkCode vk : action.comboKeys) {
+                out += ' ';
+                AppendKey(out, vk);
+            }
+        } else if (action.type == ACTION_TEXT) {
+            out += "TEXT " + std::to_string(action.text.size()) + ":";
+            out += action.text;
+        } else if (action.type == ACTION_WAIT) {
+            out += "WAIT " + std::to_string(action.waitMs);
+        } else if (action.type == ACTION_RAW) {
+            out += "RAW";
+            char buf[24];
+            for (const RawKeyEvent& ev : action.rawEvents) {
+                if (ev.delayMs > 0) {
+                    snprintf(buf, sizeof(buf), " +%u", (unsigned)ev.delayMs);
+                    out += buf;
+                }
+                snprintf(buf, sizeof(buf), " %c%02X%s", ev.down ? 'D' : 'U', ev.code, ev.extended ? "*" : "");
+                out += buf;
+            }
+        } else if (action.type == ACTION_LAYER_TOGGLE || action.type == ACTION_LAYER_HOLD) {
+            out += action.type == ACTION_LAYER_TOGGLE ? "LAYER_TOGGLE " : "LAYER_HOLD ";
+            out += action.text;
+        }
+        out += '\n';
+    }
+    out += "END\n";
+}
+
+std::vector<size_t> SavedMacroOrder(const std::vector<Macro>& macros) {
+    // 基本レイヤー（名前が空）を先に、レイヤーは一覧で最初に出てきた順に並べる
+    std::vector<std::string> layers(1, std::string());
+    for (const auto& macro : macros) {
+        if (std::find(layers.begin(), layers.end(), macro.layer) == layers.end()) layers.push_back(macro.layer);
+    }
+    std::vector<size_t> order;
+    order.reserve(macros.size());
+    for (const std::string& layer : layers) {
+        for (size_t i = 0; i < macros.size(); i++) {
+            // 実行内容や発動条件の無いマクロは読み込み時に捨てられるので書かない
+            if (macros[i].layer == layer && IsSavableMacro(macros[i])) order.push_back(i);
+        }
+    }
+    return order;
+}
+
+std::string SerializeMacros(const std::vector<Macro>& macros) {
+    std::string out;
+    out += kFormatV2Header;
+    out += "\n# MACRO ホットキー... / POLICY / TIMING / COMBO キー... / TEXT バイト数:本文 / WAIT ms / RAW D/U キー +ms... / HOTSTRING バイト数:文字列 / SEQUENCE 待ちms キー... / HOLD キー ms [strict] / LAYER_TOGGLE 名前 / LAYER_HOLD 名前 / END / LAYER 名前\n";
+
+    // 基本レイヤーのマクロを先に書き、レイヤーのまとまりの始めに "LAYER 名前" 行を書く
+    const std::string* layer = nullptr;
+    for (size_t i : SavedMacroOrder(macros)) {
+        const Macro& macro = macros[i];
+        if (!macro.layer.empty() && (!layer || *layer != macro.layer)) {
+            out += "LAYER " + macro.layer + "\n";
+            layer = &macro.layer;
+        }
+        AppendMacro(out, macro);
+    }
+    return out;
+}
+
+bool SaveMacrosToFile(const std::string& filename, const std::vector<Macro>& macros) {
+    std::string text = SerializeMacros(macros);
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "[ERROR] Could not open file for writing: " << filename << std::endl;
+        return false;
+    }
+    file.write(text.data(), (std::streamsize)text.size());
+    if (!file) {
+        std::cerr << "[ERROR] Could not write file: " << filename << std::endl;
+        return false;
+    }
+    std::cout << "[INFO] Macros saved to " << filename << std::endl;
+    return true;
+}
@@ -0,0 +1,54 @@
+﻿#pragma once
+
+// マクロ設定ファイル (macros.txt) の読み書き
+// 保存は v2 形式で行い、読み込みは 1行目で v1 / v2 を判定します。
+//
+// v2 形式（1行目が "#MACROS 2"）:
+//   MACRO 0x11 0x41        ホットキー（16進数、空白区切り）。END までが1つのマクロ
+//   HOTSTRING 5:;addr      入力すると発動する文字列 "バイト数:文字列"（MACRO のホットキーは省略可）
+//   SEQUENCE 1000 0x1D 0x4A 0x4B  順に押すと発動するキー列。先頭は次のキーを待つ ms（MACRO のホットキーは省略可）
+//   HOLD 0xA2 200          MACRO のキー（1つ）をデュアルロールキーにする。押し続けると 0xA2、200ms 内に離すとタップ
+//                          後ろに strict を付けると、他のキーを離してもタップの時間が過ぎるまでホールドにしない
+//   POLICY queue:repeat    実行方針（省略時は drop）
+//   TIMING 30:5            押しっぱなし時間とキー間隔 ms（省略時は 10:0）
+//   COMBO 0x11 0x43        同時押しするキー（16進数）
+//   TEXT 12:Hello, world   "バイト数:本文"。本文はカンマや改行を含んでもよい
+//   WAIT 100               待機 ms
+//   RAW D11 D41 +35 U41 U11  記録したキー操作。D/U + 16進数が押す/離す（後ろに * で拡張キー）、
+//                            +数字 は次のイベントまでの ms
+//   LAYER_TOGGLE 編集      レイヤー "編集" を有効/無効にする（LAYER_HOLD ならキーを押している間だけ有効）
+//   END
+//   LAYER 編集             MACRO の外に書く。以降のマクロはレイヤー "編集" に属する（"LAYER" だけなら基本レイヤーに戻る）
+//
+// v1 形式（旧形式）: 1行に1アクション "ホットキー1, ホットキー2, ..., 種類, データ"
+// 種類が POLICY / TIMING の行は v2 と同じ設定を表します。
+
+#include <string>
+#include <vector>
+
+#include "macro_engine.h"
+
+// 文字列から仮想キーコードに変換する
+// 例: "VK_CONTROL" -> 0x11, "F11" -> 0x7A, "0x41" -> 0x41
+VkCode StringToVkCode(const std::string& str);
+
+// ファイルからマクロを読み込んで macros を置き換える（ファイルが無ければ false を返し、macros は変更しない）
+bool LoadMacrosFromFile(const std::string& filename, std::vector<Macro>& macros);
+
+// メモリ上の設定ファイルの内容 (v1 / v2) を解析して macros を置き換える
+void ParseMacros(const char* data, size_t size, std::vector<Macro>& macros);
+
+// 保存・読み込みで残るマクロか（実行内容と、発動条件（ホットキー・ホットストリング・キー列）のどちらも持つ）
+// SerializeMacros はこれが false のマクロを書かず、ParseMacros は読んだ後に捨てます。
+bool IsSavableMacro(const Macro& macro);
+
+// 設定ファイルに書く順の macros の添字（IsSavableMacro が true のものだけ）
+// 基本レイヤーのマクロ、続いてレイヤーごとのまとまり（レイヤーは一覧で最初に出てきた順）で、
+// まとまりの中は元の並びのまま。ParseMacros で読み直した一覧はこの順になります。
+std::vector<size_t> SavedMacroOrder(const std::vector<Macro>& macros);
+
+// マクロを v2 形式の文字列にする（SavedMacroOrder の順に、レイヤーごとに "LAYER 名前" 行を1つ書く）
+std::string SerializeMacros(const std::vector<Macro>& macros);
+
+// マクロをファイルに保存する（v2 形式）
+bool SaveMacrosToFile(const std::string& filename, const std::vector<Macro>& macros);
@@ -0,0 +1,91 @@
+﻿#include "macro_layers.h"
+
+#include <cstring>
+
+uint32_t LayerId(const std::string& name) {
+    if (name.empty()) return 0;
+    uint32_t h = 2166136261u;
+    for (unsigned char c : name) {
+        h ^= c;
+        h *= 16777619u;
+    }
+    return h != 0 ? h : 1; // 0 は基本レイヤー用に空けておく
+}
+
+std::string NormalizeLayerName(const std::string& name) {
+    size_t end = name.find_first_of("\r\n");
+    if (end == std::string::npos) end = name.size();
+    size_t begin = 0;
+    while (begin < end && (name[begin] == ' ' || name[begin] == '\t')) begin++;
+    while (end > begin && (name[end - 1] == ' ' || name[end - 1] == '\t')) end--;
+    return name.substr(begin, end - begin);
+}
+
+LayerStackPublisher::LayerStackPublisher() : sequence_(0), count_(0) {
+    memset(&stack_, 0, sizeof(stack_));
+    for (auto& id : ids_) id.store(0, std::memory_order_relaxed);
+}
+
+LayerStack LayerStackPublisher::Current() const {
+    LayerStack out;
+    for (;;) {
+        uint32_t before = sequence_.load(std::memory_order_acquire);
+        if (before & 1) continue; // 書き込み中
+        out.count = count_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < kMaxActiveLayers; i++) out.ids[i] = ids_[i].load(std::memory_order_relaxed);
+        // 読んだ値より後に通し番号を読み直し、書き込みと重なっていなければ使う
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence_.load(std::memory_order_relaxed) == before) break;
+    }
+    if (out.count > kMaxActiveLayers) out.count = kMaxActiveLayers;
+    return out;
+}
+
+void LayerStackPublisher::Publish(const LayerStack& next) {
+    stack_ = next;
+    // 書き込むのはフックのスレッドだけなので、通し番号は読み出して書き戻すだけで十分
+    uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    count_.store(next.count, std::memory_order_relaxed);
+    for (size_t i = 0; i < kMaxActiveLayers; i++) {
+        ids_[i].store(i < next.count ? next.ids[i] : 0, std::memory_order_relaxed);
+    }
+    sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+void LayerStackPublisher::Toggle(uint32_t id) {
+    if (stack_.Contains(id)) {
+        Remove(id);
+    } else {
+        Push(id);
+    }
+}
+
+void LayerStackPublisher::Push(uint32_t id) {
+    if (id == 0) return;
+    const LayerStack& cur = stack_;
+    LayerStack next;
+    next.count = 0;
+    for (uint32_t i = 0; i < cur.count; i++) {
+        if (cur.ids[i] != id) next.ids[next.count++] = cur.ids[i];
+    }
+    // 積みきれないときは一番下のレイヤーを外す
+    if (next.count == kMaxActiveLayers) {
+        memmove(next.ids, next.ids + 1, sizeof(uint32_t) * (kMaxActiveLayers - 1));
+        next.count--;
+    }
+    next.ids[next.count++] = id;
+    Publish(next);
+}
+
+void LayerStackPublisher::Remove(uint32_t id) {
+    const LayerStack& cur = stack_;
+    if (!cur.Contains(id)) return;
+    LayerStack next;
+    next.count = 0;
+    for (uint32_t i = 0; i < cur.count; i++) {
+        if (cur.ids[i] != id) next.ids[next.count++] = cur.ids[i];
+    }
+    Publish(next);
+}
@@ -0,0 +1,62 @@
+﻿#pragma once
+
+// マクロのレイヤー（「編集用」「ゲーム用」のようなマクロのまとまり）の切り替え
+// 有効なレイヤーは積み重ね (LayerStack) で表し、一番上のレイヤーの表 (DispatchTable) をフックが引きます。
+// 切り替えはフックのスレッドで行い、次の状態を通し番号付きの領域（シーケンスロック）に書くだけです
+// （表の作り直しもメモリの確保もしない）。
+// UI スレッドは Current() で表示用に写しを読むだけで、切り替えはしません。書き込みと重なったら読み直します。
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// 同時に有効にできるレイヤーの数（基本レイヤーを除く）
+const size_t kMaxActiveLayers = 8;
+
+// レイヤー名 → レイヤーの番号（FNV-1a）。基本レイヤー（名前が空）は 0
+uint32_t LayerId(const std::string& name);
+
+// 入力されたレイヤー名を、設定ファイルから読み直したときと同じ名前にする
+// （前後の空白・タブを除き、改行があればそこまでにする。LayerId は名前そのものから作るため）
+std::string NormalizeLayerName(const std::string& name);
+
+// 有効なレイヤーの積み重ね。ids[count - 1] が一番上。公開後は変更されない
+struct LayerStack {
+    uint32_t count;
+    uint32_t ids[kMaxActiveLayers];
+
+    bool Contains(uint32_t id) const {
+        for (uint32_t i = 0; i < count; i++) {
+            if (ids[i] == id) return true;
+        }
+        return false;
+    }
+};
+
+class LayerStackPublisher {
+public:
+    LayerStackPublisher(); // 基本レイヤーだけの状態で始まる
+
+    LayerStackPublisher(const LayerStackPublisher&) = delete;
+    LayerStackPublisher& operator=(const LayerStackPublisher&) = delete;
+
+    // 今の積み重ねの写し（どのスレッドから呼んでもよい）
+    LayerStack Current() const;
+
+    // 以下はフックのスレッドだけが呼ぶ
+    // 有効なら外し、無効なら一番上に積む
+    void Toggle(uint32_t id);
+    // 一番上に積む（既に有効なら一番上へ移す）
+    void Push(uint32_t id);
+    // 外す（有効でなければ何もしない）
+    void Remove(uint32_t id);
+
+private:
+    void Publish(const LayerStack& next);
+
+    LayerStack stack_; // フックのスレッドが持つ今の積み重ね（書き込む側だけが読む）
+    // 公開用の写し。sequence_ が奇数の間は書き込み中
+    std::atomic<uint32_t> sequence_;
+    std::atomic<uint32_t> count_;
+    std::atomic<uint32_t> ids_[kMaxActiveLayers];
+};
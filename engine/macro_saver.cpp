@@ -0,0 +1,102 @@
+﻿#include "macro_saver.h"
+
+MacroSaver::MacroSaver(IMacroStore& store, std::chrono::milliseconds quietPeriod)
+    : store_(store), quietPeriod_(quietPeriod), running_(false), stopping_(false), dirty_(false), generation_(0) {
+    stats_.saved = 0;
+    stats_.failed = 0;
+}
+
+MacroSaver::~MacroSaver() {
+    Stop();
+}
+
+void MacroSaver::Start() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_) return;
+    running_ = true;
+    stopping_ = false;
+    thread_ = std::thread(&MacroSaver::SaverLoop, this);
+}
+
+void MacroSaver::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) return;
+        stopping_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+}
+
+void MacroSaver::MarkDirty(const std::vector<Macro>& macros, const std::vector<CompiledMacroPtr>& compiled,
+                           bool immediate) {
+    // 写しはロックの外で作り、ロック中は入れ替えるだけにする
+    std::vector<Macro> macrosCopy(macros);
+    std::vector<CompiledMacroPtr> compiledCopy(compiled);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pendingMacros_.swap(macrosCopy);
+        pendingCompiled_.swap(compiledCopy);
+        dirty_ = true;
+        generation_++;
+        deadline_ = std::chrono::steady_clock::now() + (immediate ? std::chrono::milliseconds(0) : quietPeriod_);
+    }
+    cond_.notify_all();
+    // 古い写しの解放もロックの外で行う（macrosCopy / compiledCopy のデストラクタ）
+}
+
+void MacroSaver::SaveSoon() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!dirty_) return;
+        deadline_ = std::chrono::steady_clock::now();
+    }
+    cond_.notify_all();
+}
+
+bool MacroSaver::IsDirty() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dirty_;
+}
+
+MacroSaver::Stats MacroSaver::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void MacroSaver::SaverLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        if (stopping_ && !dirty_) return;
+        if (!dirty_) {
+            cond_.wait(lock);
+            continue;
+        }
+        // 終了時は待たずに書く。それ以外は最後の編集から quietPeriod 経つまで待つ
+        if (!stopping_ && std::chrono::steady_clock::now() < deadline_) {
+            cond_.wait_until(lock, deadline_);
+            continue;
+        }
+
+        // 書き込み中も編集できるよう、写しを取ってからロックを外す
+        uint64_t generation = generation_;
+        std::vector<Macro> macros(pendingMacros_);
+        std::vector<CompiledMacroPtr> compiled(pendingCompiled_);
+        lock.unlock();
+        bool ok = store_.Save(macros, compiled);
+        lock.lock();
+
+        if (ok) {
+            stats_.saved++;
+            // 書いている間に次の編集が来ていたら、そちらはまだ未保存
+            if (generation_ == generation) dirty_ = false;
+        } else {
+            stats_.failed++;
+            if (stopping_) return; // 終了時は1回だけ試す
+            // 少し待ってからやり直す
+            if (generation_ == generation) deadline_ = std::chrono::steady_clock::now() + quietPeriod_;
+        }
+    }
+}
@@ -0,0 +1,69 @@
+﻿#pragma once
+
+// マクロ一覧の自動保存
+// UI スレッドは編集のたびに MarkDirty で一覧の写しを渡すだけで、ディスクへの書き込みは
+// 保存用のスレッドが行います。編集が続く間は保存を待ち、最後の編集から quietPeriod 経ってから
+// 最新の写しを1回だけ書きます（途中の写しは書かずに捨てます）。
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "compiled_macro.h"
+#include "macro_engine.h"
+
+// 保存先。Windows では一時ファイル経由で置き換える Win32MacroStore (macro_win32.h) を使います。
+class IMacroStore {
+public:
+    virtual ~IMacroStore() {}
+    // compiled は macros を変換したもの（キャッシュの書き出し用）。失敗したら false
+    virtual bool Save(const std::vector<Macro>& macros, const std::vector<CompiledMacroPtr>& compiled) = 0;
+};
+
+class MacroSaver {
+public:
+    struct Stats {
+        uint64_t saved;   // 保存に成功した回数（累計）
+        uint64_t failed;  // 保存に失敗した回数（累計）
+    };
+
+    MacroSaver(IMacroStore& store, std::chrono::milliseconds quietPeriod);
+    ~MacroSaver();
+
+    // 保存用のスレッドを起動する / 止める（Stop は未保存の変更を書き終えるまで待つ）
+    void Start();
+    void Stop();
+
+    // 一覧が変わったことを知らせる。immediate なら待たずに保存する（保存ボタン用）
+    void MarkDirty(const std::vector<Macro>& macros, const std::vector<CompiledMacroPtr>& compiled,
+                   bool immediate = false);
+
+    // 未保存の変更があれば、待たずに保存させる
+    void SaveSoon();
+
+    // まだ書き終えていない変更があるか
+    bool IsDirty();
+
+    Stats GetStats();
+
+private:
+    void SaverLoop();
+
+    IMacroStore& store_;
+    std::chrono::milliseconds quietPeriod_;
+    std::thread thread_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool running_;
+    bool stopping_;
+    bool dirty_;                 // pending の内容がまだ保存されていない
+    uint64_t generation_;        // MarkDirty のたびに増やす
+    std::chrono::steady_clock::time_point deadline_; // この時刻を過ぎたら保存する
+    std::vector<Macro> pendingMacros_;
+    std::vector<CompiledMacroPtr> pendingCompiled_;
+    Stats stats_;
+};
@@ -0,0 +1,145 @@
+﻿#include "macro_table.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+// DispatchTable::generation の通し番号（表はフックとは別のスレッドで作るが、複数のスレッドで作ってもよい）
+static std::atomic<uint64_t> g_dispatchGeneration(0);
+
+static uint64_t NextDispatchGeneration() {
+    return g_dispatchGeneration.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+std::unique_ptr<MacroTable> BuildMacroTable(const std::vector<Macro>& macros) {
+    std::unique_ptr<MacroTable> table(new MacroTable());
+    table->macros.reserve(macros.size());
+    for (size_t i = 0; i < macros.size(); i++) table->macros.push_back(CompileMacro(macros[i], (uint32_t)i));
+    BuildDispatchTables(*table, macros);
+    return table;
+}
+
+MacroTable::MacroTable() {
+    layers.emplace_back(new DispatchTable());
+    layers[0]->layerId = 0;
+    layers[0]->generation = NextDispatchGeneration();
+}
+
+const DispatchTable& MacroTable::Resolve(const LayerStack& stack) const {
+    // レイヤーの数は多くないので順に探す
+    for (uint32_t i = stack.count; i-- > 0;) {
+        for (size_t l = 1; l < layers.size(); l++) {
+            if (layers[l]->layerId == stack.ids[i]) return *layers[l];
+        }
+    }
+    return *layers[0];
+}
+
+void BuildDispatchTables(MacroTable& table, const std::vector<Macro>& macros) {
+    // 基本レイヤーの次に、マクロ一覧で最初に出てきた順にレイヤーを並べる
+    std::vector<uint32_t> ids(1, 0);
+    for (const Macro& m : macros) {
+        uint32_t id = LayerId(m.layer);
+        if (std::find(ids.begin(), ids.end(), id) == ids.end()) ids.push_back(id);
+    }
+
+    table.layers.clear();
+    std::vector<Macro> members;
+    bool shadowed[256];
+    for (uint32_t id : ids) {
+        std::unique_ptr<DispatchTable> layer(new DispatchTable());
+        layer->layerId = id;
+        layer->generation = NextDispatchGeneration();
+        members.clear();
+        // 置き換え・デュアルロールキーは索引より先に引かれるので、レイヤーのマクロが1キーで発動するキーの
+        // 基本レイヤーの置き換え・デュアルロールキーは、このレイヤーでは外す
+        memset(shadowed, 0, sizeof(shadowed));
+        for (size_t i = 0; i < macros.size() && id != 0; i++) {
+            if (LayerId(macros[i].layer) != id || macros[i].hotkeys.size() != 1) continue;
+            VkCode k = macros[i].hotkeys[0];
+            if (k < 256) shadowed[k] = true;
+            if (k == VKC_CONTROL) shadowed[VKC_LCONTROL] = shadowed[VKC_RCONTROL] = true;
+            else if (k == VKC_MENU) shadowed[VKC_LMENU] = shadowed[VKC_RMENU] = true;
+            else if (k == VKC_SHIFT) shadowed[VKC_LSHIFT] = shadowed[VKC_RSHIFT] = true;
+        }
+        // 基本レイヤーの表は基本レイヤーのマクロだけ、それ以外はレイヤーのマクロ → 基本レイヤーのマクロの順
+        for (int pass = (id == 0 ? 1 : 0); pass < 2; pass++) {
+            uint32_t want = pass == 0 ? id : 0;
+            for (size_t i = 0; i < macros.size(); i++) {
+                if (LayerId(macros[i].layer) != want) continue;
+                if (pass == 1 && id != 0 && macros[i].hotkeys.size() == 1 && macros[i].hotkeys[0] < 256 &&
+                    shadowed[macros[i].hotkeys[0]] && (macros[i].holdKey != 0 || RemapTarget(macros[i]) != 0)) {
+                    continue;
+                }
+                members.push_back(macros[i]);
+                layer->macros.push_back(table.macros[i]);
+            }
+        }
+        layer->index.Build(members);
+        layer->hotstrings.Build(members);
+        layer->sequences.Build(members);
+        layer->tapHold.Build(members);
+        layer->remap.Build(members);
+        table.layers.push_back(std::move(layer));
+    }
+}
+
+KeyRemapTable::KeyRemapTable() : count(0) {
+    for (int i = 0; i < 256; i++) {
+        to[i] = 0;
+        macro[i] = -1;
+    }
+}
+
+void KeyRemapTable::Build(const std::vector<Macro>& macros) {
+    *this = KeyRemapTable();
+    const std::vector<VkCode> targets = RemapTargets(macros);
+    for (size_t m = 0; m < macros.size(); m++) {
+        VkCode target = targets[m];
+        if (target == 0) continue;
+        VkCode keys[3] = { macros[m].hotkeys[0], 0, 0 };
+        if (keys[0] == VKC_CONTROL) { keys[1] = VKC_LCONTROL; keys[2] = VKC_RCONTROL; }
+        else if (keys[0] == VKC_MENU) { keys[1] = VKC_LMENU; keys[2] = VKC_RMENU; }
+        else if (keys[0] == VKC_SHIFT) { keys[1] = VKC_LSHIFT; keys[2] = VKC_RSHIFT; }
+        for (VkCode k : keys) {
+            if (k == 0 || k >= 256) continue;
+            to[k] = target;
+            macro[k] = (int32_t)m;
+            count++;
+        }
+    }
+}
+
+MacroTablePublisher::MacroTablePublisher() : current_(new MacroTable()), readers_(0) {}
+
+MacroTablePublisher::~MacroTablePublisher() {
+    // 破棄の時点ではフックは外れている前提
+    for (const MacroTable* t : retired_) delete t;
+    delete current_.load(std::memory_order_relaxed);
+}
+
+void MacroTablePublisher::Publish(std::unique_ptr<MacroTable> table) {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    const MacroTable* old = current_.exchange(table.release(), std::memory_order_seq_cst);
+    retired_.push_back(old);
+    ReclaimLocked();
+}
+
+void MacroTablePublisher::Reclaim() {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    ReclaimLocked();
+}
+
+void MacroTablePublisher::ReclaimLocked() {
+    if (retired_.empty()) return;
+    // 読み手が 0 なら、解放待ちの表（すべて差し替え済み）を読んでいるスナップショットは無い。
+    // この後に登録した読み手は新しい表しか読めない。
+    if (readers_.load(std::memory_order_seq_cst) != 0) return;
+    for (const MacroTable* t : retired_) delete t;
+    retired_.clear();
+}
+
+size_t MacroTablePublisher::RetiredCount() {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    return retired_.size();
+}
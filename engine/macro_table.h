@@ -0,0 +1,114 @@
+﻿#pragma once
+
+// フックから参照するマクロ表（実行用マクロ + レイヤーごとの発動キー索引・置き換え・ホットストリング・キー列・デュアルロールキーの表）の受け渡し
+// UI スレッドはマクロを編集するたびに新しい MacroTable を丸ごと作り、ポインタの差し替えで公開します。
+// フックは MacroTableSnapshot でその時点の表を取り出して使い、ロックは取りません。
+// 公開済みの表は作成後に変更されず、差し替えで外れた表は読み手がいなくなってから解放されます。
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "compiled_macro.h"
+#include "hotkey_index.h"
+#include "hotstring_matcher.h"
+#include "key_sequence.h"
+#include "tap_hold.h"
+
+// 1:1 のキー置き換えの表（押されたキー → 代わりに送るキー。0 なら置き換えない）
+// 共通修飾キー (Ctrl/Shift/Alt) の置き換えは左右それぞれのキーの欄にも登録します。
+struct KeyRemapTable {
+    VkCode to[256];
+    int32_t macro[256]; // 置き換えの元になったマクロの番号（ログ用）
+    size_t count;
+
+    KeyRemapTable();
+    void Build(const std::vector<Macro>& macros);
+    bool Empty() const { return count == 0; }
+};
+
+// 1つのレイヤーが一番上にあるときにフックが引く表
+// レイヤー自身のマクロを先、基本レイヤーのマクロを後ろに並べて作るので、同じキーならレイヤーのマクロが優先されます。
+// 各表の返すマクロの番号は、この表の macros の添字です。
+struct DispatchTable {
+    uint32_t layerId; // LayerId(名前)。基本レイヤーは 0
+    // 表を作るたびに振る通し番号（0 は使わない）。フックの照合状態は、前回と同じ表かをこれで確かめる
+    // （差し替えで解放された表のアドレスは、次の表に使い回されることがあるので比べない）
+    uint64_t generation;
+    std::vector<CompiledMacroPtr> macros; // MacroTable::macros と同じものを共有する
+    HotkeyIndex index;
+    HotstringMatcher hotstrings;
+    KeySequenceTrie sequences;
+    TapHoldTable tapHold;
+    KeyRemapTable remap;
+};
+
+struct MacroTable {
+    std::vector<CompiledMacroPtr> macros; // 添字は元の Macro 一覧と同じ
+    std::vector<std::unique_ptr<DispatchTable>> layers; // [0] は基本レイヤー（常にある）
+
+    MacroTable(); // 空の基本レイヤーだけを持つ
+
+    // stack の上から順に、この表にあるレイヤーの表を探す（無ければ基本レイヤー）
+    // 見つかったレイヤーの表はそのレイヤーと基本レイヤーのマクロだけを持ち、下に積まれたレイヤーは使わない
+    const DispatchTable& Resolve(const LayerStack& stack) const;
+};
+
+// macros から新しい表を作る（フックとは別のスレッドで呼ぶ）
+std::unique_ptr<MacroTable> BuildMacroTable(const std::vector<Macro>& macros);
+
+// table->macros（macros を変換したもの）からレイヤーごとの表を作り直す
+void BuildDispatchTables(MacroTable& table, const std::vector<Macro>& macros);
+
+class MacroTablePublisher {
+public:
+    MacroTablePublisher(); // 空の表を公開した状態で始まる
+    ~MacroTablePublisher();
+
+    MacroTablePublisher(const MacroTablePublisher&) = delete;
+    MacroTablePublisher& operator=(const MacroTablePublisher&) = delete;
+
+    // table を公開し、それまでの表を解放待ちにする
+    void Publish(std::unique_ptr<MacroTable> table);
+
+    // 読み手がいなければ解放待ちの表を解放する（UI スレッドから定期的に呼ぶ）
+    void Reclaim();
+
+    // 解放待ちの表の数
+    size_t RetiredCount();
+
+private:
+    friend class MacroTableSnapshot;
+
+    void ReclaimLocked();
+
+    std::atomic<const MacroTable*> current_;
+    std::atomic<uint32_t> readers_; // 表を参照中の MacroTableSnapshot の数
+
+    std::mutex writeMutex_; // Publish / Reclaim 同士の排他（読み手は取らない）
+    std::vector<const MacroTable*> retired_;
+};
+
+// 公開中の表を参照する間だけ生かしておく（フック内でスタックに置いて使う）
+// 参照中に Publish されても、この表はスナップショットが消えるまで解放されません。
+class MacroTableSnapshot {
+public:
+    explicit MacroTableSnapshot(MacroTablePublisher& publisher) : publisher_(publisher) {
+        // 読み手の登録を表の読み出しより先に行う（Reclaim はこの順序を前提にしている）
+        publisher_.readers_.fetch_add(1, std::memory_order_seq_cst);
+        table_ = publisher_.current_.load(std::memory_order_seq_cst);
+    }
+    ~MacroTableSnapshot() { publisher_.readers_.fetch_sub(1, std::memory_order_release); }
+
+    MacroTableSnapshot(const MacroTableSnapshot&) = delete;
+    MacroTableSnapshot& operator=(const MacroTableSnapshot&) = delete;
+
+    const MacroTable& operator*() const { return *table_; }
+    const MacroTable* operator->() const { return table_; }
+
+private:
+    MacroTablePublisher& publisher_;
+    const MacroTable* table_;
+};
@@ -0,0 +1,81 @@
+﻿#include "raw_recorder.h"
+
+#include <cstring>
+
+RawKeyRecorder::RawKeyRecorder(uint32_t quantumMs, size_t queueCapacity)
+    : quantumNs_((int64_t)(quantumMs > 0 ? quantumMs : 1) * 1000000),
+      queue_(queueCapacity),
+      recording_(false),
+      dropped_(0),
+      started_(false),
+      originNs_(0),
+      lastMs_(0) {
+    memset(held_, 0, sizeof(held_));
+}
+
+void RawKeyRecorder::Start() {
+    recording_.store(false, std::memory_order_relaxed);
+    Captured c;
+    while (queue_.TryPop(c)) {}
+    events_.clear();
+    memset(held_, 0, sizeof(held_));
+    started_ = false;
+    originNs_ = 0;
+    lastMs_ = 0;
+    dropped_.store(0, std::memory_order_relaxed);
+    recording_.store(true, std::memory_order_relaxed);
+}
+
+void RawKeyRecorder::Stop() {
+    if (!recording_.load(std::memory_order_relaxed)) return;
+    recording_.store(false, std::memory_order_relaxed);
+    Drain();
+    // 押されたまま記録を止めたキーは、最後のイベントと同時に離す
+    for (int vk = 0; vk < 256; vk++) {
+        if (!held_[vk]) continue;
+        RawKeyEvent ev = { (VkCode)vk, 0, (uint8_t)(held_[vk] == 2 ? 1 : 0), 0 };
+        held_[vk] = 0;
+        events_.push_back(ev);
+    }
+}
+
+void RawKeyRecorder::Drain() {
+    Captured c;
+    while (queue_.TryPop(c)) Add(c);
+}
+
+void RawKeyRecorder::Add(const Captured& c) {
+    uint8_t k = (uint8_t)c.code;
+    // 記録を始める前から押されていたキーを離しただけのイベントは記録しない
+    if (!c.down && !held_[k]) return;
+    held_[k] = c.down ? (c.extended ? 2 : 1) : 0;
+
+    if (!started_) {
+        started_ = true;
+        originNs_ = c.timeNs;
+    }
+    // 経過時間を quantumNs_ 単位に丸め、直前のイベントの丸めた時刻との差を待ち時間にする
+    int64_t elapsed = c.timeNs - originNs_;
+    if (elapsed < 0) elapsed = 0;
+    uint64_t ms = (uint64_t)((elapsed + quantumNs_ / 2) / quantumNs_ * quantumNs_ / 1000000);
+    if (ms < lastMs_) ms = lastMs_;
+
+    RawKeyEvent ev;
+    ev.code = c.code;
+    ev.down = c.down ? 1 : 0;
+    ev.extended = c.extended ? 1 : 0;
+    ev.delayMs = (uint32_t)(ms - lastMs_);
+    events_.push_back(ev);
+    lastMs_ = ms;
+}
+
+MacroAction RawKeyRecorder::TakeAction() {
+    MacroAction action;
+    action.type = ACTION_RAW;
+    action.waitMs = 0;
+    action.rawEvents.swap(events_);
+    events_.clear();
+    lastMs_ = 0;
+    started_ = false;
+    return action;
+}
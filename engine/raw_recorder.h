@@ -0,0 +1,67 @@
+﻿#pragma once
+
+// キー操作の記録（ACTION_RAW を作る）
+// 記録中はフックが受け取った物理キーの押す・離すを時刻付きで SpscQueue に積み、UI スレッドが
+// 取り出して RawKeyEvent の列にします。時刻は最初のイベントからの経過時間を quantumMs 単位に
+// 丸めてから差を取るので、丸めの誤差は積み重なりません。丸めた時刻が同じイベントは待ち時間 0 に
+// なり、再生時は1回の送信にまとまります。
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "macro_engine.h"
+#include "spsc_queue.h"
+#include "vk_codes.h"
+
+class RawKeyRecorder {
+public:
+    explicit RawKeyRecorder(uint32_t quantumMs = 5, size_t queueCapacity = 4096);
+
+    // UI スレッドから: 記録を始める（前の記録は捨てる）/ 止める
+    // Stop は押されたままのキーを離すイベントを最後に補います。
+    void Start();
+    void Stop();
+    bool Recording() const { return recording_.load(std::memory_order_relaxed); }
+
+    // フックのスレッドから: キーが押された / 離された（記録中でなければ何もしない）
+    void OnKeyEvent(VkCode vk, bool down, bool extended, int64_t timeNs) {
+        if (!recording_.load(std::memory_order_relaxed)) return;
+        Captured c = { vk, down, extended, timeNs };
+        if (!queue_.TryPush(c)) dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // UI スレッドから: 積まれたイベントを記録に加える
+    void Drain();
+
+    const std::vector<RawKeyEvent>& Events() const { return events_; }
+    // 記録の長さ (ms)
+    uint64_t DurationMs() const { return lastMs_; }
+    // キューが満杯で捨てたイベントの数（記録を始めるたびに 0 に戻る）
+    uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // 記録を RAW アクションにして取り出す（記録は空になる）
+    MacroAction TakeAction();
+
+private:
+    struct Captured {
+        VkCode code;
+        bool down;
+        bool extended;
+        int64_t timeNs;
+    };
+
+    void Add(const Captured& c);
+
+    const int64_t quantumNs_;
+    SpscQueue<Captured> queue_;
+    std::atomic<bool> recording_;
+    std::atomic<uint64_t> dropped_;
+
+    // ここから下は UI スレッドだけが触る
+    std::vector<RawKeyEvent> events_;
+    uint8_t held_[256]; // 0: 離れている / 1: 押されている / 2: 拡張キーとして押されている
+    bool started_;    // 最初のイベントを受け取ったか
+    int64_t originNs_; // 最初のイベントの時刻
+    uint64_t lastMs_;  // 最後のイベントの丸めた時刻（originNs_ からの ms）
+};
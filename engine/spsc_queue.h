@@ -0,0 +1,49 @@
+﻿#pragma once
+
+// 固定長のロックフリーキュー（Push するスレッドと Pop するスレッドがそれぞれ1つだけの場合）
+// BoundedQueue より単純で、Push / Pop とも atomic の読み書きだけで済みます。
+// 容量は 2 のべき乗に切り上げられます。満杯なら TryPush は false を返します。
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        mask_ = cap - 1;
+        slots_.reset(new T[cap]);
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // 生産側のスレッドだけが呼ぶ
+    bool TryPush(const T& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) > mask_) return false; // 満杯
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 消費側のスレッドだけが呼ぶ
+    bool TryPop(T& out) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false; // 空
+        out = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::unique_ptr<T[]> slots_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> head_;
+    alignas(64) std::atomic<size_t> tail_;
+};
@@ -0,0 +1,187 @@
+﻿#include "tap_hold.h"
+
+#include <cstring>
+
+TapHoldTable::TapHoldTable() {
+    for (int i = 0; i < 256; i++) slot_[i] = -1;
+}
+
+void TapHoldTable::Build(const std::vector<Macro>& macros) {
+    for (int i = 0; i < 256; i++) slot_[i] = -1;
+    entries_.clear();
+
+    for (size_t m = 0; m < macros.size(); m++) {
+        const Macro& macro = macros[m];
+        if (macro.holdKey == 0 || macro.hotkeys.size() != 1 || macro.tapTimeoutMs <= 0) continue;
+        VkCode key = macro.hotkeys[0];
+        if (key >= 256 || slot_[key] >= 0) continue;
+
+        Entry e;
+        e.macro = (int)m;
+        e.holdKey = macro.holdKey;
+        e.tapTimeoutMs = (uint32_t)macro.tapTimeoutMs;
+        e.permissiveHold = macro.permissiveHold;
+        e.tapEventCount = 0;
+        // COMBO 1つだけのタップはフックから直接送る（止めていたキーとの順序が入れ替わらない）
+        if (macro.actions.size() == 1 && macro.actions[0].type == ACTION_COMBO) {
+            const std::vector<VkCode>& keys = macro.actions[0].comboKeys;
+            if (!keys.empty() && keys.size() * 2 <= kMaxTapEvents) {
+                for (size_t i = 0; i < keys.size(); i++) {
+                    InputEvent& ev = e.tapEvents[e.tapEventCount++];
+                    ev.type = EVENT_KEY_DOWN;
+                    ev.extended = IsExtendedKey(keys[i]);
+                    ev.code = keys[i];
+                }
+                for (size_t i = keys.size(); i-- > 0;) {
+                    InputEvent& ev = e.tapEvents[e.tapEventCount++];
+                    ev.type = EVENT_KEY_UP;
+                    ev.extended = IsExtendedKey(keys[i]);
+                    ev.code = keys[i];
+                }
+            }
+        }
+        slot_[key] = (int16_t)entries_.size();
+        entries_.push_back(e);
+    }
+}
+
+TapHoldTracker::TapHoldTracker() : generation_(0), undecided_(-1), undecidedNs_(0), pendingCount_(0), holdingCount_(0) {
+    memset(&undecidedEntry_, 0, sizeof(undecidedEntry_));
+    memset(heldAs_, 0, sizeof(heldAs_));
+}
+
+void TapHoldTracker::Append(TapHoldOutput& out, TapHoldStepType type, VkCode vk, bool down) {
+    // out.steps は kMaxTapHoldOutput 個あり、1回の OnKeyEvent で溢れることはない
+    TapHoldStep& step = out.steps[out.count++];
+    step.type = type;
+    step.macro = -1;
+    step.event.type = down ? EVENT_KEY_DOWN : EVENT_KEY_UP;
+    step.event.extended = IsExtendedKey(vk);
+    step.event.code = vk;
+}
+
+void TapHoldTracker::Begin(uint64_t tableGeneration, TapHoldOutput& out) {
+    out.count = 0;
+    if (generation_ != tableGeneration) {
+        // 表が差し替わったら、判定待ちのキーは写しておいた設定で判定を続ける（マクロ番号は古いので使わない）
+        undecidedEntry_.macro = -1;
+        generation_ = tableGeneration;
+    }
+}
+
+bool TapHoldTracker::OnKeyEvent(const TapHoldTable& table, uint64_t tableGeneration, VkCode vk, bool down,
+                                bool isRepeat, int64_t timeNs, TapHoldOutput& out) {
+    Begin(tableGeneration, out);
+    if (vk >= 256) return false;
+
+    bool block = Process(table, vk, down, isRepeat, timeNs, out);
+    // 送り直すイベントより先に今のイベントが届かないよう、今のイベントも止めて後ろに付ける
+    if (!block && out.count > 0) {
+        Append(out, TAP_HOLD_DISPATCH, vk, down);
+        block = true;
+    }
+    return block;
+}
+
+void TapHoldTracker::OnTimeout(const TapHoldTable& table, uint64_t tableGeneration, int64_t nowNs, TapHoldOutput& out) {
+    Begin(tableGeneration, out);
+    if (undecided_ >= 0 && nowNs >= DeadlineNs()) ResolveHold(table, out);
+}
+
+bool TapHoldTracker::Process(const TapHoldTable& table, VkCode vk, bool down, bool isRepeat, int64_t timeNs,
+                             TapHoldOutput& out) {
+    if (undecided_ >= 0 && timeNs >= DeadlineNs()) {
+        ResolveHold(table, out);
+    }
+
+    if (undecided_ >= 0) {
+        if (vk == (VkCode)undecided_) {
+            if (down) return true; // 判定待ちの間のキーリピート
+            ResolveTap(table, out);
+            return true;
+        }
+        if (down && isRepeat) return true; // 判定待ちの間は他のキーのキーリピートも捨てる
+        if (!down) {
+            bool pressedAfter = false;
+            for (uint32_t i = 0; i < pendingCount_; i++) {
+                if (pending_[i].vk == vk && pending_[i].down) pressedAfter = true;
+            }
+            // 判定待ちのキーより前から押していたキーを離しただけなら、そのまま通す
+            if (!pressedAfter) return false;
+            if (undecidedEntry_.permissiveHold && pendingCount_ < kMaxTapHoldPending) {
+                Pending& p = pending_[pendingCount_++];
+                p.vk = vk;
+                p.down = false;
+                p.timeNs = timeNs;
+                ResolveHold(table, out);
+                return true;
+            }
+        }
+        if (pendingCount_ < kMaxTapHoldPending) {
+            Pending& p = pending_[pendingCount_++];
+            p.vk = vk;
+            p.down = down;
+            p.timeNs = timeNs;
+            return true;
+        }
+        // 止めておける数を超えたら、ホールドとして判定してから今のイベントを扱う
+        ResolveHold(table, out);
+    }
+
+    if (heldAs_[vk] != 0) {
+        if (down) return true; // ホールド中のキーリピート
+        Append(out, TAP_HOLD_HOLD_KEY, heldAs_[vk], false);
+        heldAs_[vk] = 0;
+        holdingCount_--;
+        return true;
+    }
+
+    const TapHoldTable::Entry* entry = table.Find(vk);
+    if (entry && down && !isRepeat) {
+        undecided_ = vk;
+        undecidedNs_ = timeNs;
+        undecidedEntry_ = *entry;
+        return true;
+    }
+    return false;
+}
+
+void TapHoldTracker::ResolveHold(const TapHoldTable& table, TapHoldOutput& out) {
+    VkCode key = (VkCode)undecided_;
+    undecided_ = -1;
+    Append(out, TAP_HOLD_HOLD_KEY, undecidedEntry_.holdKey, true);
+    heldAs_[key] = undecidedEntry_.holdKey;
+    holdingCount_++;
+    Refeed(table, out);
+}
+
+void TapHoldTracker::ResolveTap(const TapHoldTable& table, TapHoldOutput& out) {
+    undecided_ = -1;
+    if (undecidedEntry_.tapEventCount > 0) {
+        for (uint32_t i = 0; i < undecidedEntry_.tapEventCount; i++) {
+            TapHoldStep& step = out.steps[out.count++];
+            step.type = TAP_HOLD_SEND;
+            step.macro = -1;
+            step.event = undecidedEntry_.tapEvents[i];
+        }
+    } else if (undecidedEntry_.macro >= 0) {
+        TapHoldStep& step = out.steps[out.count++];
+        step.type = TAP_HOLD_MACRO;
+        step.macro = undecidedEntry_.macro;
+        memset(&step.event, 0, sizeof(step.event));
+    }
+    Refeed(table, out);
+}
+
+void TapHoldTracker::Refeed(const TapHoldTable& table, TapHoldOutput& out) {
+    // 止めていたイベントを押された順に判定し直す（別のデュアルロールキーが含まれていれば、その判定も進む）
+    Pending local[kMaxTapHoldPending];
+    uint32_t n = pendingCount_;
+    memcpy(local, pending_, sizeof(Pending) * n);
+    pendingCount_ = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (!Process(table, local[i].vk, local[i].down, false, local[i].timeNs, out)) {
+            Append(out, TAP_HOLD_DISPATCH, local[i].vk, local[i].down);
+        }
+    }
+}
@@ -0,0 +1,124 @@
+﻿#pragma once
+
+// タップとホールドで役割の変わるキー（デュアルロールキー）
+// 例: 無変換 を短く押して離すと Esc、押し続けると左Ctrl として働く。
+// Macro::holdKey が 0 以外のマクロは、hotkeys[0] をこのキーとして扱い、タップでは actions を実行します。
+//
+// TapHoldTable はマクロ表と一緒に作り直す不変の表、TapHoldTracker はフックのスレッドが持つ
+// キーごとの状態です。判定はフックに届くイベントの時刻で行い、次のイベントが来ないままタップの時間が
+// 過ぎたときはフックのタイマーから OnTimeout を呼んでホールドに決めます。
+// 判定が付くまでに押されたキーは止めておき、判定後に順番どおりフックの判定（ホットキーなど）に通し直します。
+// フックのスレッドではメモリを確保しません。
+//
+// 判定の規則:
+//  - タップの時間 (tapTimeoutMs) 内に離した → タップ
+//  - タップの時間を過ぎてから次のイベントが届いた → ホールド
+//  - permissiveHold なら、タップの時間内でも、後から押した別のキーを離した → ホールド
+//    （「無変換を押したまま C を押して離す」を Ctrl+C にする。押しかけのキーを追い越して離したらタップ）
+
+#include <cstdint>
+#include <vector>
+
+#include "macro_engine.h"
+
+// 判定が付くまで止めておけるイベントの数（超えたらホールドとして判定する）
+const size_t kMaxTapHoldPending = 16;
+// タップで直接送るイベントの上限（COMBO 1つ・8キーまで）
+const size_t kMaxTapEvents = 16;
+// 1回の OnKeyEvent で出す手順の最大数
+// 判定を進めるイベントは止めていたもの + 今のもので最大 kMaxTapHoldPending + 1 個。それぞれが出すのは、
+// 素通し・ホールドの解除の1つか、タップで決まったときのタップのイベント (kMaxTapEvents) かマクロ1つで、
+// これとは別に、ホールドに決まるたびに代わりのキーを押す1つ（判定待ちのキーは最大 kMaxTapHoldPending + 2 個）
+const size_t kMaxTapHoldOutput = (kMaxTapHoldPending + 1) * kMaxTapEvents + kMaxTapHoldPending + 2;
+
+class TapHoldTable {
+public:
+    struct Entry {
+        int macro;            // タップで実行するマクロ
+        VkCode holdKey;       // ホールドで代わりに押すキー
+        uint32_t tapTimeoutMs;
+        bool permissiveHold;
+        uint32_t tapEventCount; // 0 ならタップはマクロを実行側に積む
+        InputEvent tapEvents[kMaxTapEvents];
+    };
+
+    TapHoldTable();
+
+    // holdKey を持つマクロから作り直す（キーが重なれば先のマクロ）
+    void Build(const std::vector<Macro>& macros);
+
+    bool Empty() const { return entries_.empty(); }
+    // vk がデュアルロールキーならその設定（無ければ nullptr）
+    const Entry* Find(VkCode vk) const {
+        return (vk < 256 && slot_[vk] >= 0) ? &entries_[slot_[vk]] : nullptr;
+    }
+
+private:
+    int16_t slot_[256];
+    std::vector<Entry> entries_;
+};
+
+enum TapHoldStepType {
+    TAP_HOLD_SEND,     // event を送る（タップで決まったときの COMBO）
+    TAP_HOLD_HOLD_KEY, // ホールドの代わりのキーを押す・離す。送って、押下状態にも反映する
+    TAP_HOLD_DISPATCH, // 止めていた物理キーのイベント。フックの判定に通し、止めなければ送る
+    TAP_HOLD_MACRO,    // macro を実行側に積む（タップで決まったとき）
+};
+
+struct TapHoldStep {
+    TapHoldStepType type;
+    int macro;
+    InputEvent event;
+};
+
+// 判定の結果、フックが順番にすること
+// 後の手順は前の手順の結果（タップで切り替えたレイヤーなど）の上で行う
+struct TapHoldOutput {
+    uint32_t count;
+    // 最悪の場合の数だけ用意してあるので、離す操作を含めてイベントを捨てることはない
+    TapHoldStep steps[kMaxTapHoldOutput];
+};
+
+class TapHoldTracker {
+public:
+    TapHoldTracker();
+
+    // 判定待ちのキーがあるか、ホールドとして押しているキーがあるか
+    bool Busy() const { return undecided_ >= 0 || holdingCount_ > 0; }
+    // 判定待ちのキーがあるか
+    bool Undecided() const { return undecided_ >= 0; }
+    // 判定待ちのキーがホールドに決まる時刻
+    int64_t DeadlineNs() const { return undecidedNs_ + (int64_t)undecidedEntry_.tapTimeoutMs * 1000000; }
+
+    // 物理キーのイベントを渡す。キーを止めるなら true（out は毎回初期化される）
+    // 止めた場合は、今のイベントも必要なら out の最後に TAP_HOLD_DISPATCH として入っている。
+    // tableGeneration は table を持つ表の通し番号 (DispatchTable::generation)。
+    bool OnKeyEvent(const TapHoldTable& table, uint64_t tableGeneration, VkCode vk, bool down, bool isRepeat,
+                    int64_t timeNs, TapHoldOutput& out);
+    // イベントが来ないまま DeadlineNs を過ぎたら呼ぶ（フックのタイマーから）。判定待ちのキーをホールドに決める
+    void OnTimeout(const TapHoldTable& table, uint64_t tableGeneration, int64_t nowNs, TapHoldOutput& out);
+
+private:
+    struct Pending {
+        VkCode vk;
+        bool down;
+        int64_t timeNs;
+    };
+
+    // 1イベント分の判定。止めるなら true
+    bool Process(const TapHoldTable& table, VkCode vk, bool down, bool isRepeat, int64_t timeNs, TapHoldOutput& out);
+    void ResolveHold(const TapHoldTable& table, TapHoldOutput& out);
+    void ResolveTap(const TapHoldTable& table, TapHoldOutput& out);
+    void Refeed(const TapHoldTable& table, TapHoldOutput& out);
+    void Begin(uint64_t tableGeneration, TapHoldOutput& out);
+    static void Append(TapHoldOutput& out, TapHoldStepType type, VkCode vk, bool down);
+
+    uint64_t generation_;    // 前回のイベントを判定した表の通し番号（0 なら無し）
+    int undecided_;          // 判定待ちのキー（-1 なら無し）
+    int64_t undecidedNs_;    // そのキーを押した時刻
+    TapHoldTable::Entry undecidedEntry_; // 押した時点の設定（表が差し替わっても使えるように写しておく）
+    Pending pending_[kMaxTapHoldPending];
+    uint32_t pendingCount_;
+    VkCode heldAs_[256];     // ホールドとして押しているキー → 代わりに押したキー（0 なら押していない）
+    uint32_t holdingCount_;
+};
@@ -0,0 +1,59 @@
+﻿#pragma once
+
+// 仮想キーコードの定義
+// エンジン部分は windows.h に依存させないため、必要なキーコードをここで定義します。
+// 値は winuser.h の VK_* と同じなので、Windows 側のコードとそのまま混ぜて使えます。
+
+#include <cstdint>
+
+typedef uint16_t VkCode; // Windows の WORD と同じ幅
+
+enum : VkCode {
+    VKC_BACK        = 0x08,
+    VKC_TAB         = 0x09,
+    VKC_RETURN      = 0x0D,
+    VKC_SHIFT       = 0x10,
+    VKC_CONTROL     = 0x11,
+    VKC_MENU        = 0x12, // Alt
+    VKC_CONVERT     = 0x1C,
+    VKC_NONCONVERT  = 0x1D,
+    VKC_ESCAPE      = 0x1B,
+    VKC_SPACE       = 0x20,
+    VKC_PRIOR       = 0x21, // PageUp
+    VKC_NEXT        = 0x22, // PageDown
+    VKC_END         = 0x23,
+    VKC_HOME        = 0x24,
+    VKC_LEFT        = 0x25,
+    VKC_UP          = 0x26,
+    VKC_RIGHT       = 0x27,
+    VKC_DOWN        = 0x28,
+    VKC_INSERT      = 0x2D,
+    VKC_DELETE      = 0x2E,
+    VKC_F1          = 0x70,
+    VKC_F2          = 0x71,
+    VKC_F3          = 0x72,
+    VKC_F4          = 0x73,
+    VKC_F5          = 0x74,
+    VKC_F6          = 0x75,
+    VKC_F7          = 0x76,
+    VKC_F8          = 0x77,
+    VKC_F9          = 0x78,
+    VKC_F10         = 0x79,
+    VKC_F11         = 0x7A,
+    VKC_F12         = 0x7B,
+    VKC_F24         = 0x87,
+    VKC_LSHIFT      = 0xA0,
+    VKC_RSHIFT      = 0xA1,
+    VKC_LCONTROL    = 0xA2,
+    VKC_RCONTROL    = 0xA3,
+    VKC_LMENU       = 0xA4,
+    VKC_RMENU       = 0xA5,
+};
+
+// SendInput で拡張キーフラグ (KEYEVENTF_EXTENDEDKEY) が必要なキーかどうか
+inline bool IsExtendedKey(VkCode vk) {
+    return vk == VKC_RCONTROL || vk == VKC_RMENU || vk == VKC_RSHIFT ||
+           vk == VKC_UP || vk == VKC_DOWN || vk == VKC_LEFT || vk == VKC_RIGHT ||
+           vk == VKC_DELETE || vk == VKC_HOME || vk == VKC_END || vk == VKC_INSERT ||
+           vk == VKC_PRIOR || vk == VKC_NEXT;
+}
@@ -0,0 +1,384 @@
+﻿#include "vk_names.h"
+
+#include <cstdint>
+
+// 1キー分の名前
+struct VkNameRow {
+    VkCode code;
+    const char* vkName;  // winuser.h の VK_* から "VK_" を除いたもの
+    const char* display; // UI の表示名（nullptr なら vkName を表示する）
+};
+
+static constexpr VkNameRow kVkNames[] = {
+    { 0x01, "LBUTTON", "LButton" },
+    { 0x02, "RBUTTON", "RButton" },
+    { 0x03, "CANCEL", "Cancel" },
+    { 0x04, "MBUTTON", "MButton" },
+    { 0x05, "XBUTTON1", "XButton1" },
+    { 0x06, "XBUTTON2", "XButton2" },
+    { 0x08, "BACK", "BackSpace" },
+    { 0x09, "TAB", "Tab" },
+    { 0x0C, "CLEAR", "Clear" },
+    { 0x0D, "RETURN", "Enter" },
+    { 0x10, "SHIFT", "Shift" },
+    { 0x11, "CONTROL", "Ctrl" },
+    { 0x12, "MENU", "Alt" },
+    { 0x13, "PAUSE", "Pause" },
+    { 0x14, "CAPITAL", "CapsLock" },
+    { 0x15, "KANA", "Kana" },
+    { 0x16, "IME_ON", "ImeOn" },
+    { 0x17, "JUNJA", "Junja" },
+    { 0x18, "FINAL", "Final" },
+    { 0x19, "KANJI", "Kanji" },
+    { 0x1A, "IME_OFF", "ImeOff" },
+    { 0x1B, "ESCAPE", "Esc" },
+    { 0x1C, "CONVERT", "Convert" },
+    { 0x1D, "NONCONVERT", "NonConvert" },
+    { 0x1E, "ACCEPT", "Accept" },
+    { 0x1F, "MODECHANGE", "ModeChange" },
+    { 0x20, "SPACE", "Space" },
+    { 0x21, "PRIOR", "PageUp" },
+    { 0x22, "NEXT", "PageDown" },
+    { 0x23, "END", "End" },
+    { 0x24, "HOME", "Home" },
+    { 0x25, "LEFT", "Left" },
+    { 0x26, "UP", "Up" },
+    { 0x27, "RIGHT", "Right" },
+    { 0x28, "DOWN", "Down" },
+    { 0x29, "SELECT", "Select" },
+    { 0x2A, "PRINT", "Print" },
+    { 0x2B, "EXECUTE", "Execute" },
+    { 0x2C, "SNAPSHOT", "PrintScreen" },
+    { 0x2D, "INSERT", "Insert" },
+    { 0x2E, "DELETE", "Delete" },
+    { 0x2F, "HELP", "Help" },
+    { 0x30, "0", nullptr },
+    { 0x31, "1", nullptr },
+    { 0x32, "2", nullptr },
+    { 0x33, "3", nullptr },
+    { 0x34, "4", nullptr },
+    { 0x35, "5", nullptr },
+    { 0x36, "6", nullptr },
+    { 0x37, "7", nullptr },
+    { 0x38, "8", nullptr },
+    { 0x39, "9", nullptr },
+    { 0x41, "A", nullptr },
+    { 0x42, "B", nullptr },
+    { 0x43, "C", nullptr },
+    { 0x44, "D", nullptr },
+    { 0x45, "E", nullptr },
+    { 0x46, "F", nullptr },
+    { 0x47, "G", nullptr },
+    { 0x48, "H", nullptr },
+    { 0x49, "I", nullptr },
+    { 0x4A, "J", nullptr },
+    { 0x4B, "K", nullptr },
+    { 0x4C, "L", nullptr },
+    { 0x4D, "M", nullptr },
+    { 0x4E, "N", nullptr },
+    { 0x4F, "O", nullptr },
+    { 0x50, "P", nullptr },
+    { 0x51, "Q", nullptr },
+    { 0x52, "R", nullptr },
+    { 0x53, "S", nullptr },
+    { 0x54, "T", nullptr },
+    { 0x55, "U", nullptr },
+    { 0x56, "V", nullptr },
+    { 0x57, "W", nullptr },
+    { 0x58, "X", nullptr },
+    { 0x59, "Y", nullptr },
+    { 0x5A, "Z", nullptr },
+    { 0x5B, "LWIN", "LWin" },
+    { 0x5C, "RWIN", "RWin" },
+    { 0x5D, "APPS", "Apps" },
+    { 0x5F, "SLEEP", "Sleep" },
+    { 0x60, "NUMPAD0", "Num0" },
+    { 0x61, "NUMPAD1", "Num1" },
+    { 0x62, "NUMPAD2", "Num2" },
+    { 0x63, "NUMPAD3", "Num3" },
+    { 0x64, "NUMPAD4", "Num4" },
+    { 0x65, "NUMPAD5", "Num5" },
+    { 0x66, "NUMPAD6", "Num6" },
+    { 0x67, "NUMPAD7", "Num7" },
+    { 0x68, "NUMPAD8", "Num8" },
+    { 0x69, "NUMPAD9", "Num9" },
+    { 0x6A, "MULTIPLY", "Num*" },
+    { 0x6B, "ADD", "Num+" },
+    { 0x6C, "SEPARATOR", "NumSeparator" },
+    { 0x6D, "SUBTRACT", "Num-" },
+    { 0x6E, "DECIMAL", "Num." },
+    { 0x6F, "DIVIDE", "Num/" },
+    { 0x70, "F1", nullptr },
+    { 0x71, "F2", nullptr },
+    { 0x72, "F3", nullptr },
+    { 0x73, "F4", nullptr },
+    { 0x74, "F5", nullptr },
+    { 0x75, "F6", nullptr },
+    { 0x76, "F7", nullptr },
+    { 0x77, "F8", nullptr },
+    { 0x78, "F9", nullptr },
+    { 0x79, "F10", nullptr },
+    { 0x7A, "F11", nullptr },
+    { 0x7B, "F12", nullptr },
+    { 0x7C, "F13", nullptr },
+    { 0x7D, "F14", nullptr },
+    { 0x7E, "F15", nullptr },
+    { 0x7F, "F16", nullptr },
+    { 0x80, "F17", nullptr },
+    { 0x81, "F18", nullptr },
+    { 0x82, "F19", nullptr },
+    { 0x83, "F20", nullptr },
+    { 0x84, "F21", nullptr },
+    { 0x85, "F22", nullptr },
+    { 0x86, "F23", nullptr },
+    { 0x87, "F24", nullptr },
+    { 0x90, "NUMLOCK", "NumLock" },
+    { 0x91, "SCROLL", "ScrollLock" },
+    { 0xA0, "LSHIFT", "LShift" },
+    { 0xA1, "RSHIFT", "RShift" },
+    { 0xA2, "LCONTROL", "LCtrl" },
+    { 0xA3, "RCONTROL", "RCtrl" },
+    { 0xA4, "LMENU", "LAlt" },
+    { 0xA5, "RMENU", "RAlt" },
+    { 0xA6, "BROWSER_BACK", "BrowserBack" },
+    { 0xA7, "BROWSER_FORWARD", "BrowserForward" },
+    { 0xA8, "BROWSER_REFRESH", "BrowserRefresh" },
+    { 0xA9, "BROWSER_STOP", "BrowserStop" },
+    { 0xAA, "BROWSER_SEARCH", "BrowserSearch" },
+    { 0xAB, "BROWSER_FAVORITES", "BrowserFavorites" },
+    { 0xAC, "BROWSER_HOME", "BrowserHome" },
+    { 0xAD, "VOLUME_MUTE", "VolumeMute" },
+    { 0xAE, "VOLUME_DOWN", "VolumeDown" },
+    { 0xAF, "VOLUME_UP", "VolumeUp" },
+    { 0xB0, "MEDIA_NEXT_TRACK", "MediaNext" },
+    { 0xB1, "MEDIA_PREV_TRACK", "MediaPrev" },
+    { 0xB2, "MEDIA_STOP", "MediaStop" },
+    { 0xB3, "MEDIA_PLAY_PAUSE", "MediaPlayPause" },
+    { 0xB4, "LAUNCH_MAIL", "LaunchMail" },
+    { 0xB5, "LAUNCH_MEDIA_SELECT", "LaunchMedia" },
+    { 0xB6, "LAUNCH_APP1", "LaunchApp1" },
+    { 0xB7, "LAUNCH_APP2", "LaunchApp2" },
+    { 0xBA, "OEM_1", nullptr },
+    { 0xBB, "OEM_PLUS", nullptr },
+    { 0xBC, "OEM_COMMA", nullptr },
+    { 0xBD, "OEM_MINUS", nullptr },
+    { 0xBE, "OEM_PERIOD", nullptr },
+    { 0xBF, "OEM_2", nullptr },
+    { 0xC0, "OEM_3", nullptr },
+    { 0xDB, "OEM_4", nullptr },
+    { 0xDC, "OEM_5", nullptr },
+    { 0xDD, "OEM_6", nullptr },
+    { 0xDE, "OEM_7", nullptr },
+    { 0xDF, "OEM_8", nullptr },
+    { 0xE1, "OEM_AX", nullptr },
+    { 0xE2, "OEM_102", nullptr },
+    { 0xE5, "PROCESSKEY", nullptr },
+    { 0xE7, "PACKET", nullptr },
+    { 0xF0, "OEM_ATTN", nullptr },
+    { 0xF1, "OEM_FINISH", nullptr },
+    { 0xF2, "OEM_COPY", nullptr },
+    { 0xF3, "OEM_AUTO", nullptr },
+    { 0xF4, "OEM_ENLW", nullptr },
+    { 0xF5, "OEM_BACKTAB", nullptr },
+    { 0xF6, "ATTN", nullptr },
+    { 0xF7, "CRSEL", nullptr },
+    { 0xF8, "EXSEL", nullptr },
+    { 0xF9, "EREOF", nullptr },
+    { 0xFA, "PLAY", nullptr },
+    { 0xFB, "ZOOM", nullptr },
+    { 0xFC, "NONAME", nullptr },
+    { 0xFD, "PA1", nullptr },
+    { 0xFE, "OEM_CLEAR", nullptr },
+};
+
+// 名前→コードの向きでだけ使う別名
+struct VkAlias {
+    const char* name;
+    VkCode code;
+};
+
+static constexpr VkAlias kVkAliases[] = {
+    { "BKSP", VKC_BACK },
+    { "DEL", VKC_DELETE },
+    { "INS", VKC_INSERT },
+    { "PGUP", VKC_PRIOR },
+    { "PGDN", VKC_NEXT },
+    { "PRTSC", 0x2C },
+    { "WIN", 0x5B },
+    { "HANGUL", 0x15 },
+    { "HANJA", 0x19 },
+};
+
+static constexpr size_t kVkNameCount = sizeof(kVkNames) / sizeof(kVkNames[0]);
+static constexpr size_t kVkAliasCount = sizeof(kVkAliases) / sizeof(kVkAliases[0]);
+
+static constexpr char ToUpperAscii(char c) { return (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c; }
+
+static constexpr size_t NameLength(const char* s) {
+    size_t n = 0;
+    while (s[n] != '\0') n++;
+    return n;
+}
+
+// 大文字小文字を区別しない比較
+static constexpr bool SameName(const char* a, size_t aLen, const char* b, size_t bLen) {
+    if (aLen != bLen) return false;
+    for (size_t i = 0; i < aLen; i++) {
+        if (ToUpperAscii(a[i]) != ToUpperAscii(b[i])) return false;
+    }
+    return true;
+}
+
+// 大文字にそろえた FNV-1a
+static constexpr uint32_t HashName(const char* s, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (uint8_t)ToUpperAscii(s[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// --- コード→名前（添字がキーコードの配列） ---
+
+struct VkNameByCode {
+    const char* names[256];
+    bool ok; // 同じコードの行が2つあったら false
+};
+
+static constexpr VkNameByCode BuildNameByCode() {
+    VkNameByCode t{};
+    t.ok = true;
+    for (size_t i = 0; i < kVkNameCount; i++) {
+        const VkNameRow& row = kVkNames[i];
+        if (row.code > 0xFF || t.names[row.code] != nullptr) t.ok = false;
+        else t.names[row.code] = row.display ? row.display : row.vkName;
+    }
+    return t;
+}
+
+static constexpr VkNameByCode kNameByCode = BuildNameByCode();
+static_assert(kNameByCode.ok, "kVkNames has a duplicated or out-of-range key code");
+
+// --- 名前→コード（hash-and-displace による完全ハッシュ） ---
+// 名前をハッシュ値でバケットに分け、バケットごとに「どの名前も空いている枠に入る」ずらし量を探して記録します。
+// 引くときはハッシュ値とバケットのずらし量から枠が1つに決まるので、比較は1回で済みます。
+
+static constexpr size_t kMaxNameKeys = kVkNameCount * 2 + kVkAliasCount;
+static constexpr uint32_t kNameBuckets = 256;
+static constexpr uint32_t kNameSlots = 1024;
+
+struct VkNameKey {
+    const char* name;
+    uint16_t length;
+    VkCode code;
+    uint32_t hash;
+};
+
+struct VkNameKeys {
+    VkNameKey keys[kMaxNameKeys];
+    size_t count;
+};
+
+static constexpr void AddNameKey(VkNameKeys& k, const char* name, VkCode code) {
+    VkNameKey& key = k.keys[k.count++];
+    key.name = name;
+    key.length = (uint16_t)NameLength(name);
+    key.code = code;
+    key.hash = HashName(name, key.length);
+}
+
+// 受け付ける名前をすべて並べる（表示名が Windows の名前と同じキーは1つにする）
+static constexpr VkNameKeys CollectNameKeys() {
+    VkNameKeys k{};
+    for (size_t i = 0; i < kVkNameCount; i++) {
+        const VkNameRow& row = kVkNames[i];
+        AddNameKey(k, row.vkName, row.code);
+        if (row.display && !SameName(row.display, NameLength(row.display), row.vkName, NameLength(row.vkName))) {
+            AddNameKey(k, row.display, row.code);
+        }
+    }
+    for (size_t i = 0; i < kVkAliasCount; i++) AddNameKey(k, kVkAliases[i].name, kVkAliases[i].code);
+    return k;
+}
+
+static constexpr uint32_t NameSlot(uint32_t hash, uint32_t displacement) {
+    uint32_t x = hash ^ (displacement * 0x9E3779B9u);
+    x ^= x >> 16;
+    x *= 0x85EBCA6Bu;
+    x ^= x >> 13;
+    return x % kNameSlots;
+}
+
+struct VkNameHash {
+    uint16_t displacement[kNameBuckets];
+    int16_t slots[kNameSlots]; // VkNameKeys の添字（-1 は空き）
+    bool ok;                   // 同じ名前が2つあると置けないので false になる
+};
+
+static constexpr VkNameHash BuildNameHash(const VkNameKeys& k) {
+    VkNameHash t{};
+    for (uint32_t s = 0; s < kNameSlots; s++) t.slots[s] = -1;
+
+    // バケットごとに名前を並べ直す（計数ソート）
+    uint16_t start[kNameBuckets + 1] = {};
+    uint16_t order[kMaxNameKeys] = {};
+    for (size_t i = 0; i < k.count; i++) start[k.keys[i].hash % kNameBuckets + 1]++;
+    for (uint32_t b = 0; b < kNameBuckets; b++) start[b + 1] += start[b];
+    uint16_t fill[kNameBuckets] = {};
+    for (uint32_t b = 0; b < kNameBuckets; b++) fill[b] = start[b];
+    uint16_t maxSize = 0;
+    for (size_t i = 0; i < k.count; i++) order[fill[k.keys[i].hash % kNameBuckets]++] = (uint16_t)i;
+    for (uint32_t b = 0; b < kNameBuckets; b++) {
+        if (start[b + 1] - start[b] > maxSize) maxSize = (uint16_t)(start[b + 1] - start[b]);
+    }
+
+    // 名前の多いバケットから置いていく
+    for (uint16_t size = maxSize; size > 0; size--) {
+        for (uint32_t b = 0; b < kNameBuckets; b++) {
+            if (start[b + 1] - start[b] != size) continue;
+            uint32_t d = 0;
+            for (; d < 0x10000; d++) {
+                bool fits = true;
+                for (uint16_t j = start[b]; j < start[b + 1] && fits; j++) {
+                    uint32_t s = NameSlot(k.keys[order[j]].hash, d);
+                    if (t.slots[s] >= 0) fits = false;
+                    for (uint16_t m = start[b]; m < j && fits; m++) {
+                        if (NameSlot(k.keys[order[m]].hash, d) == s) fits = false;
+                    }
+                }
+                if (fits) break;
+            }
+            if (d == 0x10000) return t; // ok == false
+            t.displacement[b] = (uint16_t)d;
+            for (uint16_t j = start[b]; j < start[b + 1]; j++) {
+                t.slots[NameSlot(k.keys[order[j]].hash, d)] = (int16_t)order[j];
+            }
+        }
+    }
+    t.ok = true;
+    return t;
+}
+
+static constexpr VkNameKeys kNameKeys = CollectNameKeys();
+static constexpr VkNameHash kNameHash = BuildNameHash(kNameKeys);
+static_assert(kNameHash.ok, "kVkNames / kVkAliases contain the same name twice");
+
+const char* VkCodeToName(VkCode vk) {
+    return vk <= 0xFF ? kNameByCode.names[vk] : nullptr;
+}
+
+VkCode VkNameToCode(const char* name, size_t length) {
+    // "VK_" は付いていてもいなくてもよい
+    if (length > 3 && ToUpperAscii(name[0]) == 'V' && ToUpperAscii(name[1]) == 'K' && name[2] == '_') {
+        name += 3;
+        length -= 3;
+    }
+    if (length == 0) return 0;
+
+    uint32_t hash = HashName(name, length);
+    int16_t index = kNameHash.slots[NameSlot(hash, kNameHash.displacement[hash % kNameBuckets])];
+    if (index < 0) return 0;
+    const VkNameKey& key = kNameKeys.keys[index];
+    return SameName(name, length, key.name, key.length) ? key.code : 0;
+}
@@ -0,0 +1,19 @@
+﻿#pragma once
+
+// 仮想キーコードと名前の相互変換
+// 名前の表はコンパイル時に作ります（コード→名前は 256 要素の配列、名前→コードは完全ハッシュ）。
+// 設定ファイルの読み込みと UI の表示で同じ表を使います。
+//
+// 名前は各キーにつき次の2つと、いくつかの別名を受け付けます（大文字小文字は区別しない。先頭の "VK_" は省略可）。
+//   Windows の名前 : winuser.h の VK_* から "VK_" を除いたもの（"CONTROL", "PRIOR", "OEM_1" など）
+//   表示名         : UI に出す名前（"Ctrl", "PageUp" など。無いキーは Windows の名前を使う）
+
+#include <cstddef>
+
+#include "vk_codes.h"
+
+// キーの表示名（名前の無いコードは nullptr）
+const char* VkCodeToName(VkCode vk);
+
+// 名前からキーコードを求める（知らない名前は 0）
+VkCode VkNameToCode(const char* name, size_t length);
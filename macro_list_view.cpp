@@ -0,0 +1,179 @@
+﻿#include "macro_list_view.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "imgui.h"
+#include "engine/vk_names.h"
+
+std::string VkCodeToString(VkCode vk) {
+    // 左右のキーを共通の名前に変換して表示
+    if (vk == VKC_CONTROL || vk == VKC_LCONTROL || vk == VKC_RCONTROL) return "Ctrl";
+    if (vk == VKC_MENU    || vk == VKC_LMENU    || vk == VKC_RMENU) return "Alt";
+    if (vk == VKC_SHIFT   || vk == VKC_LSHIFT   || vk == VKC_RSHIFT) return "Shift";
+
+    // それ以外は表示名の表を引く (engine/vk_names.cpp)
+    if (const char* name = VkCodeToName(vk)) return name;
+    // 名前の無いキーは数値をそのまま表示
+    return "Key:" + std::to_string(vk);
+}
+
+static std::string JoinKeys(const std::vector<VkCode>& keys) {
+    std::string s;
+    for (auto k : keys) {
+        if (!s.empty()) s += "+";
+        s += VkCodeToString(k);
+    }
+    return s;
+}
+
+std::string JoinSequence(const std::vector<VkCode>& keys) {
+    std::string s;
+    for (auto k : keys) {
+        if (!s.empty()) s += u8" → ";
+        s += VkCodeToString(k);
+    }
+    return s;
+}
+
+std::string DescribeRawAction(const MacroAction& action) {
+    uint64_t totalMs = 0;
+    for (const auto& ev : action.rawEvents) totalMs += ev.delayMs;
+    char buf[64];
+    snprintf(buf, sizeof(buf), u8"%d 操作 / %.1f 秒", (int)action.rawEvents.size(), totalMs / 1000.0);
+    return buf;
+}
+
+std::string DescribeLayerAction(const MacroAction& action) {
+    return action.text + (action.type == ACTION_LAYER_HOLD ? u8" (押している間)" : u8" (切り替え)");
+}
+
+// 展開状態に合わせて行の並びを作り直す（レイヤーがあるときはレイヤーごとに見出しを付けてまとめる）
+static void RebuildMacroListRows(MacroListView& view, const std::vector<Macro>& macros) {
+    view.rows.clear();
+    for (int l = 0; l < (int)view.layers.size(); l++) {
+        if (view.layers.size() > 1) view.rows.push_back({ -1, l });
+        for (int i = 0; i < (int)view.entries.size(); i++) {
+            if (macros[i].layer != view.layers[l]) continue;
+            view.rows.push_back({ i, -1 });
+            if (!view.entries[i].open) continue;
+            for (int a = 0; a < (int)view.entries[i].actions.size(); a++) view.rows.push_back({ i, a });
+        }
+    }
+}
+
+void RefreshMacroListView(MacroListView& view, const std::vector<Macro>& macros) {
+    view.entries.resize(macros.size(), MacroListEntry{ std::string(), std::vector<std::string>(), false });
+    for (size_t i = 0; i < macros.size(); i++) {
+        const Macro& m = macros[i];
+        MacroListEntry& entry = view.entries[i];
+        entry.header.clear();
+        if (!m.hotkeys.empty()) entry.header = u8"起動: " + JoinKeys(m.hotkeys);
+        if (m.holdKey != 0) entry.header += u8" (押し続けると " + VkCodeToString(m.holdKey) + ")";
+        if (!m.hotstring.empty()) {
+            if (!entry.header.empty()) entry.header += " / ";
+            entry.header += u8"入力: " + m.hotstring;
+        }
+        if (!m.sequence.empty()) {
+            if (!entry.header.empty()) entry.header += " / ";
+            entry.header += u8"キー列: " + JoinSequence(m.sequence);
+        }
+        entry.header += "###macro";
+        entry.actions.clear();
+        for (const auto& act : m.actions) {
+            if (act.type == ACTION_COMBO) entry.actions.push_back(u8"キー: " + JoinKeys(act.comboKeys));
+            else if (act.type == ACTION_TEXT) entry.actions.push_back(u8"文字: " + act.text);
+            else if (act.type == ACTION_RAW) entry.actions.push_back(u8"記録: " + DescribeRawAction(act));
+            else if (act.type == ACTION_LAYER_TOGGLE || act.type == ACTION_LAYER_HOLD) entry.actions.push_back(u8"レイヤー: " + DescribeLayerAction(act));
+            else entry.actions.push_back(u8"待機: " + std::to_string(act.waitMs) + " ms");
+        }
+    }
+    view.layers.assign(1, std::string());
+    for (const auto& m : macros) {
+        if (std::find(view.layers.begin(), view.layers.end(), m.layer) == view.layers.end()) {
+            view.layers.push_back(m.layer);
+        }
+    }
+    RebuildMacroListRows(view, macros);
+    view.dirty = false;
+}
+
+int EffectiveLayerIndex(const MacroListView& view, const LayerStack& stack) {
+    for (uint32_t i = stack.count; i-- > 0;) {
+        for (size_t l = 1; l < view.layers.size(); l++) {
+            if (LayerId(view.layers[l]) == stack.ids[i]) return (int)l;
+        }
+    }
+    return 0;
+}
+
+MacroListClicks DrawMacroList(MacroListView& view, const std::vector<Macro>& macros, const LayerStack& activeLayers) {
+    if (view.dirty) RefreshMacroListView(view, macros);
+    const int effective = EffectiveLayerIndex(view, activeLayers);
+
+    // 見えている行だけ描画する。行の高さを揃えるため、アクションの行も AlignTextToFramePadding で
+    // ボタンの行と同じ高さにする。展開の変更はループの後でまとめて反映する。
+    MacroListClicks clicks = { -1, -1 };
+    bool rows_changed = false;
+    ImGuiListClipper clipper;
+    clipper.Begin((int)view.rows.size(), ImGui::GetFrameHeightWithSpacing());
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+            if (view.rows[row].macro < 0) {
+                // レイヤーの見出し（フックが引いているレイヤーは色を変える）
+                // 積まれていても、上のレイヤーがあれば使われないので有効とは表示しない
+                const std::string& name = view.layers[view.rows[row].action];
+                ImGui::AlignTextToFramePadding();
+                if (name.empty()) {
+                    ImGui::TextDisabled(u8"── 基本レイヤー ──");
+                } else if (view.rows[row].action == effective) {
+                    ImGui::TextColored(ImVec4(0.0f, 1.0f, 0.0f, 1.0f), u8"── レイヤー: %s (有効) ──", name.c_str());
+                } else if (activeLayers.Contains(LayerId(name))) {
+                    ImGui::TextDisabled(u8"── レイヤー: %s (上のレイヤーが優先) ──", name.c_str());
+                } else {
+                    ImGui::TextDisabled(u8"── レイヤー: %s ──", name.c_str());
+                }
+                continue;
+            }
+            const int i = view.rows[row].macro;
+            MacroListEntry& entry = view.entries[i];
+            ImGui::PushID(i);
+            if (view.rows[row].action >= 0) {
+                ImGui::Indent();
+                ImGui::AlignTextToFramePadding();
+                ImGui::BulletText("%s", entry.actions[view.rows[row].action].c_str());
+                ImGui::Unindent();
+                ImGui::PopID();
+                continue;
+            }
+
+            if (ImGui::Button(u8"削除")) clicks.deleteIndex = i;
+            ImGui::SameLine();
+
+            if (ImGui::Button(u8"編集")) {
+                clicks.editIndex = i;
+                // 画面の上（作成エリア）へ意識が向くようにスクロールさせる
+                ImGui::SetScrollHereY(0.0f);
+            }
+            ImGui::SameLine();
+
+            ImGui::SetNextItemOpen(entry.open);
+            bool open = ImGui::CollapsingHeader(entry.header.c_str());
+            if (open != entry.open) {
+                entry.open = open;
+                rows_changed = true;
+            }
+            ImGui::PopID(); // PushIDに対応するPopID
+        }
+    }
+    clipper.End();
+
+    // 削除するときは一覧を変更した後に作り直すので、ここでは並べ直さない
+    if (rows_changed && clicks.deleteIndex < 0) RebuildMacroListRows(view, macros);
+    return clicks;
+}
+
+void EraseMacroListEntry(MacroListView& view, int index) {
+    view.entries.erase(view.entries.begin() + index);
+    view.dirty = true;
+}
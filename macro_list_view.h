@@ -0,0 +1,64 @@
+﻿#pragma once
+
+// 登録済みショートカット一覧の表示 (Dear ImGui)
+// 表示用の文字列はマクロを変更したときだけ作り直し、毎フレームは作りません。
+// 一覧は ImGuiListClipper で見えている行だけ描画するため、見出しと展開したアクションを
+// 同じ高さの「行」に平らに並べておきます。
+// Windows に依存しないので、null バックエンドで描画時間を測れます (bench/macro_list_bench.cpp)。
+
+#include <string>
+#include <vector>
+
+#include "engine/macro_engine.h"
+#include "engine/macro_layers.h"
+
+// キーコードを読みやすい文字に変換する（左右の Ctrl / Shift / Alt は共通の名前にする）
+std::string VkCodeToString(VkCode vk);
+
+// キー列を "無変換 → J → K" の形にする
+std::string JoinSequence(const std::vector<VkCode>& keys);
+
+// 記録したキー操作の概要 "120 操作 / 4.5 秒"
+std::string DescribeRawAction(const MacroAction& action);
+
+// レイヤー切り替えの表示 "編集 (切り替え)"
+std::string DescribeLayerAction(const MacroAction& action);
+
+struct MacroListEntry {
+    std::string header;               // "起動: Ctrl+A" （ImGui の ID を含む）
+    std::vector<std::string> actions; // アクション1つ分の表示 "キー: Ctrl+C" など
+    bool open;                        // 展開しているか
+};
+
+struct MacroListRow {
+    int macro;  // マクロの添字（-1 ならレイヤーの見出しの行で、action は layers の添字）
+    int action; // -1 なら見出しの行
+};
+
+struct MacroListView {
+    std::vector<MacroListEntry> entries; // 添字はマクロ一覧と同じ
+    std::vector<MacroListRow> rows;
+    // 一覧に出てくるレイヤー名（[0] は基本レイヤーの ""。以降は一覧で最初に出てきた順）
+    std::vector<std::string> layers;
+    bool dirty = true; // 表示用の文字列がマクロ一覧と食い違っているか（一覧を変更したら立てる）
+};
+
+// DrawMacroList で押されたボタン（押されていなければ -1）
+struct MacroListClicks {
+    int deleteIndex;
+    int editIndex;
+};
+
+// macros から表示用の文字列を作り直す（展開状態は添字ごとに引き継ぐ）
+void RefreshMacroListView(MacroListView& view, const std::vector<Macro>& macros);
+
+// フックが引いているレイヤー（layers の添字。0 なら基本レイヤーだけ）
+// MacroTable::Resolve と同じく、積み重ねの上から見て最初にマクロを持つレイヤーで、それより下のレイヤーは使われない
+int EffectiveLayerIndex(const MacroListView& view, const LayerStack& stack);
+
+// 一覧を描画する（dirty なら先に作り直す）。フックが引いているレイヤーの見出しは色を変える
+// 削除・編集は呼び出し側が行い、削除したら EraseMacroListEntry で展開状態を詰める
+MacroListClicks DrawMacroList(MacroListView& view, const std::vector<Macro>& macros, const LayerStack& activeLayers);
+
+// macros から index のマクロを消したときに呼ぶ
+void EraseMacroListEntry(MacroListView& view, int index);
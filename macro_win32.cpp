@@ -0,0 +1,242 @@
+﻿#include "macro_win32.h"
+
+#include <cstring>
+#include <iostream>
+
+#include "engine/macro_cache.h"
+#include "engine/macro_file.h"
+
+void Win32InputSink::Send(const InputEvent* events, size_t count) {
+    if (count == 0) return;
+
+    // 1回の送信分はコンボ1回分か TEXT の1まとまり (既定 32 文字 = 64 イベント) なので、
+    // 通常はスタック上のバッファで足りる
+    INPUT stackBuf[64];
+    std::vector<INPUT> heapBuf;
+    INPUT* inputs = stackBuf;
+    if (count > 64) {
+        heapBuf.resize(count);
+        inputs = heapBuf.data();
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const InputEvent& ev = events[i];
+        INPUT& input = inputs[i];
+        ZeroMemory(&input, sizeof(INPUT));
+        input.type = INPUT_KEYBOARD;
+        switch (ev.type) {
+        case EVENT_KEY_DOWN:
+        case EVENT_KEY_UP:
+            input.ki.wVk = ev.code;
+            // 右Ctrl(VK_RCONTROL)や右Alt(VK_RMENU)の場合、拡張キーフラグ(KEYEVENTF_EXTENDEDKEY)が必要
+            if (ev.extended) input.ki.dwFlags |= KEYEVENTF_EXTENDEDKEY;
+            if (ev.type == EVENT_KEY_UP) input.ki.dwFlags |= KEYEVENTF_KEYUP;
+            break;
+        case EVENT_UNICODE_DOWN:
+        case EVENT_UNICODE_UP:
+            input.ki.wScan = ev.code;
+            input.ki.dwFlags = KEYEVENTF_UNICODE;
+            if (ev.type == EVENT_UNICODE_UP) input.ki.dwFlags |= KEYEVENTF_KEYUP;
+            break;
+        }
+    }
+    SendInput((UINT)count, inputs, sizeof(INPUT));
+}
+
+Win32MacroClock::Win32MacroClock() {
+    LARGE_INTEGER freq;
+    QueryPerformanceFrequency(&freq);
+    frequency_ = freq.QuadPart;
+}
+
+int64_t Win32MacroClock::NowNs() {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    // 桁あふれしないように秒と端数に分けて換算する
+    int64_t sec = counter.QuadPart / frequency_;
+    int64_t rem = counter.QuadPart % frequency_;
+    return sec * 1000000000 + rem * 1000000000 / frequency_;
+}
+
+// スレッドごとの待機用タイマー（高分解能タイマーが使えない古い Windows では通常のタイマー）
+static HANDLE GetThreadTimer() {
+    thread_local HANDLE timer = NULL;
+    if (timer == NULL) {
+        timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (timer == NULL) timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+    }
+    return timer;
+}
+
+void Win32MacroClock::SleepUntil(int64_t deadlineNs) {
+    // タイマーで期限の 0.5ms 手前まで眠り、残りは譲りながら待つ
+    const int64_t kSpinNs = 500000;
+    HANDLE timer = GetThreadTimer();
+    for (;;) {
+        int64_t remaining = deadlineNs - NowNs();
+        if (remaining <= 0) return;
+        if (remaining > kSpinNs) {
+            LARGE_INTEGER due;
+            due.QuadPart = -(remaining - kSpinNs) / 100; // 負の値は相対時間 (100ns 単位)
+            if (timer != NULL && SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE)) {
+                WaitForSingleObject(timer, INFINITE);
+            } else {
+                Sleep((DWORD)((remaining - kSpinNs) / 1000000));
+            }
+            continue;
+        }
+        Sleep(0);
+    }
+}
+
+void SyncKeyStateFromOS(KeyStateBitmap& bitmap) {
+    Win32KeyStateProvider os;
+    bitmap.Reset();
+    for (int vk = 1; vk < 256; vk++) {
+        if (os.IsKeyDown((VkCode)vk)) bitmap.OnKeyEvent((VkCode)vk, true);
+    }
+}
+
+TypedCharTable::TypedCharTable() {
+    memset(chars_, 0, sizeof(chars_));
+}
+
+void TypedCharTable::Build() {
+    HKL layout = GetKeyboardLayout(0);
+    BYTE state[256];
+    for (int shift = 0; shift < 2; shift++) {
+        memset(state, 0, sizeof(state));
+        if (shift) state[VK_SHIFT] = 0x80;
+        for (UINT vk = 0; vk < 256; vk++) {
+            WCHAR buf[4];
+            UINT scan = MapVirtualKeyExW(vk, MAPVK_VK_TO_VSC, layout);
+            // フラグ 4: キーボードの状態（デッドキーの入力途中など）を変えない
+            int n = ToUnicodeEx(vk, scan, state, buf, 4, 4, layout);
+            // 制御文字 (Enter, Tab, BackSpace など) とデッドキー・複数文字になるキーは文字として扱わない
+            chars_[shift][vk] = (n == 1 && buf[0] >= 0x20) ? (char16_t)buf[0] : 0;
+        }
+    }
+}
+
+static std::wstring PathToWide(const std::string& path) {
+    if (path.empty()) return std::wstring();
+    int n = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), (int)path.size(), NULL, 0);
+    std::wstring wide(n, 0);
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), (int)path.size(), &wide[0], n);
+    return wide;
+}
+
+MappedFile::MappedFile() : file_(INVALID_HANDLE_VALUE), mapping_(NULL), view_(NULL), size_(0), mtime_(0) {}
+
+MappedFile::~MappedFile() { Close(); }
+
+bool MappedFile::Open(const std::string& path) {
+    Close();
+    file_ = CreateFileW(PathToWide(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file_ == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    FILETIME writeTime;
+    if (!GetFileSizeEx(file_, &size) || !GetFileTime(file_, NULL, NULL, &writeTime)) {
+        Close();
+        return false;
+    }
+    size_ = (size_t)size.QuadPart;
+    mtime_ = ((uint64_t)writeTime.dwHighDateTime << 32) | writeTime.dwLowDateTime;
+    if (size_ == 0) return true; // 空のファイルはマップできない
+
+    mapping_ = CreateFileMappingW(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping_ != NULL) view_ = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    if (view_ == NULL) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::Close() {
+    if (view_ != NULL) UnmapViewOfFile(view_);
+    if (mapping_ != NULL) CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+    file_ = INVALID_HANDLE_VALUE;
+    mapping_ = NULL;
+    view_ = NULL;
+    size_ = 0;
+    mtime_ = 0;
+}
+
+bool WriteFileAtomic(const std::string& path, const std::string& data) {
+    std::wstring target = PathToWide(path);
+    std::wstring temp = target + L".tmp";
+
+    HANDLE file = CreateFileW(temp.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    DWORD written = 0;
+    bool ok = WriteFile(file, data.data(), (DWORD)data.size(), &written, NULL) && written == data.size();
+    // 置き換える前に中身をディスクまで書き出しておく
+    ok = ok && FlushFileBuffers(file);
+    CloseHandle(file);
+    if (!ok || !MoveFileExW(temp.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        DeleteFileW(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+static MacroCacheKey MakeCacheKey(const MappedFile& source) {
+    MacroCacheKey key;
+    key.sourceSize = source.Size();
+    key.sourceMtime = source.LastWriteTime();
+    key.sourceHash = HashMacroSource(source.Data(), source.Size());
+    return key;
+}
+
+bool LoadMacrosCached(const std::string& filename, std::vector<Macro>& macros, std::unique_ptr<MacroTable>& table) {
+    MappedFile source;
+    if (!source.Open(filename)) {
+        // 初回起動時などはファイルがないのが普通なので、エラーにはしない
+        std::cout << "[INFO] Macro file not found. Starting with empty list." << std::endl;
+        return false;
+    }
+    MacroCacheKey key = MakeCacheKey(source);
+
+    std::string cachePath = filename + ".cache";
+    {
+        MappedFile cache;
+        if (cache.Open(cachePath) && ReadMacroCache(cache.Data(), cache.Size(), key, macros, table)) {
+            std::cout << "[INFO] Loaded macros from cache." << std::endl;
+            return true;
+        }
+    }
+
+    // キャッシュが無いか古いので、設定ファイルを解析して作り直す
+    ParseMacros((const char*)source.Data(), source.Size(), macros);
+    table = BuildMacroTable(macros);
+    if (!WriteFileAtomic(cachePath, BuildMacroCache(key, macros, table->macros))) {
+        std::cerr << "[WARN] Could not write macro cache: " << cachePath << std::endl;
+    }
+    std::cout << "[INFO] Loaded macros." << std::endl;
+    return true;
+}
+
+bool WriteMacroCache(const std::string& filename, const std::vector<Macro>& macros,
+                     const std::vector<CompiledMacroPtr>& compiled) {
+    MappedFile source;
+    if (!source.Open(filename)) return false;
+    MacroCacheKey key = MakeCacheKey(source);
+    source.Close();
+    return WriteFileAtomic(filename + ".cache", BuildMacroCache(key, macros, compiled));
+}
+
+bool Win32MacroStore::Save(const std::vector<Macro>& macros, const std::vector<CompiledMacroPtr>& compiled) {
+    if (!WriteFileAtomic(filename_, SerializeMacros(macros))) {
+        std::cerr << "[ERROR] Could not write file: " << filename_ << std::endl;
+        return false;
+    }
+    // キャッシュは保存した設定ファイルの更新時刻・ハッシュで作る（失敗しても次回の起動で作り直される）
+    // 設定ファイルに書かれないマクロは BuildMacroCache も書かないので、読み直した一覧と同じ並びになる
+    WriteMacroCache(filename_, macros, compiled);
+    std::cout << "[INFO] Macros saved to " << filename_ << std::endl;
+    return true;
+}
@@ -0,0 +1,110 @@
+﻿#pragma once
+
+// マクロエンジンの Windows 向け実装
+// IInputSink は SendInput、IKeyStateProvider は GetAsyncKeyState で実装します。
+
+#include <windows.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "engine/key_state.h"
+#include "engine/macro_engine.h"
+#include "engine/macro_saver.h"
+#include "engine/macro_table.h"
+
+// SendInput でキーを送信するシンク（Send 1回分をまとめて SendInput 1回で送る）
+class Win32InputSink : public IInputSink {
+public:
+    void Send(const InputEvent* events, size_t count) override;
+};
+
+// QueryPerformanceCounter と高分解能の待機可能タイマーによる時計
+// Sleep の分解能 (既定 15.6ms) に左右されずに予定時刻まで待ちます。タイマーはスレッドごとに作ります。
+class Win32MacroClock : public IMacroClock {
+public:
+    Win32MacroClock();
+    int64_t NowNs() override;
+    void SleepUntil(int64_t deadlineNs) override;
+
+private:
+    int64_t frequency_;
+};
+
+// GetAsyncKeyState で物理キーの状態を返すプロバイダ
+class Win32KeyStateProvider : public IKeyStateProvider {
+public:
+    bool IsKeyDown(VkCode vk) const override {
+        // 最上位ビットが1なら押されている
+        return (GetAsyncKeyState(vk) & 0x8000) != 0;
+    }
+};
+
+// 現在の OS 上のキー状態で bitmap を初期化する
+// フックを入れる前から押されていたキーを取りこぼさないよう、フック設定時に1度だけ呼びます。
+void SyncKeyStateFromOS(KeyStateBitmap& bitmap);
+
+// キー → 入力される文字 の対応表（ホットストリングの照合用）
+// フックの中で ToUnicodeEx を呼ぶとデッドキーなどの入力状態を崩すため、起動時にキーボード
+// レイアウトから表を作っておき、フックでは表を引くだけにします。
+class TypedCharTable {
+public:
+    TypedCharTable();
+
+    // このスレッドのキーボードレイアウトで作り直す（UI スレッドから呼ぶ）
+    void Build();
+
+    // vk を押したときに入力される文字（文字を入力しないキーは 0）
+    char16_t Translate(VkCode vk, bool shift) const { return vk < 256 ? chars_[shift ? 1 : 0][vk] : 0; }
+
+private:
+    char16_t chars_[2][256];
+};
+
+// ファイル全体を読み取り専用でメモリにマップする
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // path は UTF-8。開けなければ false
+    bool Open(const std::string& path);
+    void Close();
+
+    const void* Data() const { return view_; } // 空のファイルなら NULL
+    size_t Size() const { return size_; }
+    uint64_t LastWriteTime() const { return mtime_; } // FILETIME の値
+
+private:
+    HANDLE file_;
+    HANDLE mapping_;
+    const void* view_;
+    size_t size_;
+    uint64_t mtime_;
+};
+
+// data を一時ファイルに書いてから path に置き換える（途中で落ちても path は元のまま残る）
+bool WriteFileAtomic(const std::string& path, const std::string& data);
+
+// 設定ファイルを読み込んで macros とマクロ表を作る
+// 隣のキャッシュ (filename + ".cache") が設定ファイルと一致すれば解析・変換をせずにそれを使い、
+// 一致しなければ設定ファイルを解析してキャッシュを作り直します。設定ファイルが無ければ false。
+bool LoadMacrosCached(const std::string& filename, std::vector<Macro>& macros, std::unique_ptr<MacroTable>& table);
+
+// 保存し終えた設定ファイルに合わせてキャッシュを書き直す（compiled は macros を変換したもの）
+bool WriteMacroCache(const std::string& filename, const std::vector<Macro>& macros,
+                     const std::vector<CompiledMacroPtr>& compiled);
+
+// 設定ファイルとキャッシュを、それぞれ一時ファイル経由で置き換えて保存する
+class Win32MacroStore : public IMacroStore {
+public:
+    explicit Win32MacroStore(const std::string& filename) : filename_(filename) {}
+    bool Save(const std::vector<Macro>& macros, const std::vector<CompiledMacroPtr>& compiled) override;
+
+private:
+    std::string filename_;
+};
@@ -4,11 +4,10 @@
 #include <iostream>
 #include <cstdio>
 #include <vector>
-#include <fstream>
-#include <sstream>
 #include <string>
 #include <thread>
 #include <algorithm>
+#include <chrono>
 
 // Dear ImGuiの内部的な数学演算子の定義を強制的に含めるためのマクロ。
 // cl.exeでのビルド時に発生しやすいシンボル解決エラーを回避するのに役立ちます。
@@ -22,26 +21,22 @@
 // DirectX 11 のヘッダー
 #include <d3d11.h>
 
-// アクションの種類
-enum MacroActionType {
-    ACTION_COMBO,   // 複数のキーを同時に押して離す (例: Ctrl+C)
-    ACTION_TEXT,    // テキストを入力する
-    ACTION_WAIT     // 待機する
-};
-
-// マクロの個々のアクション（操作）を定義する構造体
-struct MacroAction {
-    MacroActionType type;
-    std::vector<WORD> comboKeys; // COMBO用: キーコードのリスト
-    std::string text;            // TEXT用: 文字列 (UTF-8)
-    int waitMs;                  // WAIT用: 待機時間
-};
-
-// マクロ全体を定義する構造体
-struct Macro {
-    std::vector<WORD> hotkeys;         // 複数のキーを保持できるように vector に変更
-    std::vector<MacroAction> actions;  // 実行する一連の操作リスト
-};
+// マクロエンジン
+#include "engine/macro_engine.h"
+#include "engine/compiled_macro.h"
+#include "engine/diagnostics.h"
+#include "engine/event_log.h"
+#include "engine/key_capture.h"
+#include "engine/key_state.h"
+#include "engine/macro_executor.h"
+#include "engine/macro_file.h"
+#include "engine/macro_layers.h"
+#include "engine/macro_saver.h"
+#include "engine/macro_table.h"
+#include "engine/raw_recorder.h"
+#include "engine/vk_names.h"
+#include "macro_list_view.h"
+#include "macro_win32.h"
 
 // UTF-8 (std::string) を Windows ワイド文字 (std::wstring / UTF-16) に変換する
 std::wstring utf8_to_wstring(const std::string& str)
@@ -60,14 +55,47 @@ std::wstring utf8_to_wstring(const std::string& str)
     return wstrTo;
 }
 
-// マクロ全体を保持するグローバルリスト
+// マクロ全体を保持するグローバルリスト（UI スレッド専用。フックからは触らない）
 std::vector<Macro> global_macros;
+// global_macros から作ったフック用のマクロ表（global_macros を変更したら RebuildMacroTable を呼ぶ）
+MacroTablePublisher g_macroTable;
 // グローバルフックのハンドル（IDのようなもの）を格納する変数
 HHOOK hKeyboardHook;
 
+// マクロの実行で使うキー送信先
+Win32InputSink g_inputSink;
+// フックが管理する物理キーの押下状態（GetAsyncKeyState の代わりに使う）
+KeyStateBitmap g_keyState;
+// 記録 UI へのキー押下の受け渡し（フック → UI スレッド）
+KeyCapture g_keyCapture;
+// キー操作の記録（記録中はフックがキーの押す・離すを時刻付きで渡す）
+RawKeyRecorder g_rawRecorder;
+// キー → 入力される文字 の対応表（ホットストリングの照合用。フックを入れる前に作る）
+TypedCharTable g_typedChars;
+// マクロの待機に使う高分解能の時計
+Win32MacroClock g_clock;
+// マクロを実行する常駐スレッド
+MacroExecutor g_executor(g_inputSink, g_keyState, g_clock);
+// フック・実行スレッドのログ（積むだけ。文字列にして macros.log へ書くのは g_logWriter のスレッド）
+EventLog g_eventLog(1024);
+LogWriter g_logWriter(g_eventLog, "macros.log");
+// フック1回の処理時間 (µs)。OS の制限時間 (LowLevelHooksTimeout) にどれだけ近いかを見る
+LatencyHistogram g_hookTime;
+// macros.txt への保存先と、編集後の自動保存（最後の編集から 1.5 秒後に書く）
+Win32MacroStore g_macroStore("macros.txt");
+MacroSaver g_saver(g_macroStore, std::chrono::milliseconds(1500));
+// 有効なレイヤー（切り替えるのはフックのスレッドだけ。UI は表示用に読む）
+LayerStackPublisher g_layers;
+
 // マクロの有効/無効フラグ（F12 + Ctrlで切り替える）
 bool g_macroEnabled = true;
 
+// 描画したフレーム数（隠している間・操作が無い間に増えていないことの確認用）
+uint64_t g_renderedFrames = 0;
+
+// 登録済み一覧の表示用キャッシュ（RebuildMacroTable で作り直しを指示する）
+MacroListView g_macroList;
+
 #define WM_TRAYICON (WM_USER + 1) // トレイアイコンからの通知用メッセージ
 NOTIFYICONDATAW g_nid = { 0 };    // トレイアイコンの設定データ
 
@@ -84,304 +112,245 @@ void CreateRenderTarget();
 void CleanupRenderTarget();
 LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
-// 文字列から仮想キーコード(WORD)に変換する
-// 例: "VK_CONTROL" -> 0x11, "F11" -> 0x7A, "0x41" -> 0x41
-WORD StringToVkCode(const std::string& str) {
-    if (str.empty()) return 0;
-    
-    // 16進数 ('0x...') として解析を試みる
-    if (str.size() > 2 && str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
-        try {
-            return (WORD)std::stoul(str, nullptr, 16);
-        } catch (...) {
-            // 解析失敗
-        }
-    }
+// global_macros の変更後に新しいマクロ表を作ってフックに公開する（変更は自動保存される）
+void RebuildMacroTable() {
+    std::unique_ptr<MacroTable> table = BuildMacroTable(global_macros);
+    g_saver.MarkDirty(global_macros, table->macros);
+    g_macroTable.Publish(std::move(table));
+    g_macroList.dirty = true;
+}
 
-    // 単一文字（'A'?'Z'、'0'?'9'）の変換
-    if (str.size() == 1) {
-        char c = (char)std::toupper(str[0]); // キャストを追加
-        // char c = std::toupper(str[0]); // 大文字に統一
-        
-        if (c >= 'A' && c <= 'Z') {
-            // アルファベット ('A'?'Z') のキーコードは、ASCIIコードと一致
-            return (WORD)c;
-        }
-        if (c >= '0' && c <= '9') {
-            // 数字キー ('0'?'9') のキーコードも、ASCIIコードと一致
-            return (WORD)c;
-        }
-        // 他の単一文字キー（例: '-', '=', ';' など）もここに追加可能
-    }
-    
-    // 特殊なVKコード文字列を解析する (代表的なもののみ)
-    if (str == "VK_CONTROL" || str == "CONTROL" || str == "Ctrl") return VK_CONTROL;
-    if (str == "VK_SHIFT"   || str == "SHIFT") return VK_SHIFT;
-    if (str == "VK_MENU"    || str == "ALT") return VK_MENU; // Altキー
-    if (str == "VK_RETURN"  || str == "ENTER") return VK_RETURN; // Enterキー
-
-    // ファンクションキー
-    if (str == "F1" || str == "VK_F1") return VK_F1;
-    if (str == "F2" || str == "VK_F2") return VK_F2;
-    if (str == "F3" || str == "VK_F3") return VK_F3;
-    if (str == "F4" || str == "VK_F4") return VK_F4;
-    if (str == "F5" || str == "VK_F5") return VK_F5;
-    if (str == "F6" || str == "VK_F6") return VK_F6;
-    if (str == "F7" || str == "VK_F7") return VK_F7;
-    if (str == "F8" || str == "VK_F8") return VK_F8;
-    if (str == "F9" || str == "VK_F9") return VK_F9;
-    if (str == "F11" || str == "VK_F11") return VK_F11;
-    if (str == "F10" || str == "VK_F10") return VK_F10;
-    if (str == "F12" || str == "VK_F12") return VK_F12;
-
-    // ナビゲーションおよび編集キー
-    if (str == "TAB" || str == "VK_TAB") return VK_TAB;
-    if (str == "ESC" || str == "VK_ESCAPE") return VK_ESCAPE;
-    if (str == "BACKSPACE" || str == "BKSP") return VK_BACK;
-    if (str == "DELETE" || str == "DEL") return VK_DELETE;
-    if (str == "INSERT" || str == "INS") return VK_INSERT;
-    if (str == "HOME" || str == "END") return VK_END;
-
-    // 矢印キー (Arrows)
-    if (str == "UP" || str == "VK_UP") return VK_UP;
-    if (str == "DOWN" || str == "VK_DOWN") return VK_DOWN;
-    if (str == "LEFT" || str == "VK_LEFT") return VK_LEFT;
-    if (str == "RIGHT" || str == "VK_RIGHT") return VK_RIGHT;
-    
-    // 上記以外の場合は、Windows APIの定義を利用するため、そのまま0を返すか、
-    // ASCII/キーコードとして扱う（ファイル読み込みの簡略化のため、ここでは代表的なもののみ対応）
-    return 0; 
+// --- 1. フックプロシージャ（監視関数） -----------------------------
+
+// 今のレイヤーでフックが引く表
+static const DispatchTable& ActiveDispatch(const MacroTable& table) {
+    return table.Resolve(g_layers.Current());
 }
 
-// 待機関数（ミリ秒単位で処理を停止させる）
-// ACTION_WAIT が指定されたときに実行されます。
-void PerformWait(int ms) {
-    if (ms > 0) {
-        Sleep(ms); // windows.h の Sleep 関数を使用
+// ホットストリングの照合状態（フックのスレッドだけが触る）。マクロ表やレイヤーが変わったら最初から照合し直す
+static uint64_t g_hotstringGeneration = 0; // 照合中の表の DispatchTable::generation
+static uint32_t g_hotstringState = HotstringMatcher::kRootState;
+
+// 押されたキーで入力される文字の分だけ照合を進め、入力し終えたホットストリングのマクロ番号を返す（無ければ -1）
+static int AdvanceHotstring(const DispatchTable& table, VkCode vk) {
+    if (g_hotstringGeneration != table.generation || g_hotstringState >= table.hotstrings.StateCount()) {
+        g_hotstringGeneration = table.generation;
+        g_hotstringState = HotstringMatcher::kRootState;
+    }
+    // Shift や CapsLock だけの押下は入力の途中とみなす
+    if (vk == VK_SHIFT || vk == VK_LSHIFT || vk == VK_RSHIFT || vk == VK_CAPITAL) return -1;
+    // Ctrl / Alt との組み合わせや、文字を入力しないキー (Enter, BackSpace, 矢印など) を押したら最初から
+    char16_t c = 0;
+    if (!g_keyState.IsKeyDown(VK_CONTROL) && !g_keyState.IsKeyDown(VK_MENU)) {
+        c = g_typedChars.Translate(vk, g_keyState.IsKeyDown(VK_SHIFT));
+    }
+    if (c == 0) {
+        g_hotstringState = HotstringMatcher::kRootState;
+        return -1;
     }
+    return table.hotstrings.Advance(g_hotstringState, c);
 }
 
-// --- 仮想入力 送信機能 ------------------------------------------
-// 特定のキーコード（vkCode）に対応するキーを押す動作（KeyDown）を送信する関数
-void SendKeyDown(WORD vkCode) {
-    INPUT input = {0};
-    input.type = INPUT_KEYBOARD;
-    input.ki.wVk = vkCode;
-    // 右Ctrl(VK_RCONTROL)や右Alt(VK_RMENU)の場合、拡張キーフラグ(KEYEVENTF_EXTENDEDKEY)が必要
-    if (vkCode == VK_RCONTROL || vkCode == VK_RMENU || vkCode == VK_RSHIFT ||
-        vkCode == VK_UP || vkCode == VK_DOWN || vkCode == VK_LEFT || vkCode == VK_RIGHT ||
-        vkCode == VK_DELETE || vkCode == VK_HOME || vkCode == VK_END || vkCode == VK_INSERT ||
-        vkCode == VK_PRIOR || vkCode == VK_NEXT) {
-        input.ki.dwFlags = KEYEVENTF_EXTENDEDKEY;
-    }
-    SendInput(1, &input, sizeof(INPUT));
+// 1:1 のキー置き換えで押しているキー（フックのスレッドだけが触る）
+// 物理キー → 送ったキー。離すときに表が差し替わっていても、押したキーを離す
+static VkCode g_remappedTo[256];
+
+// キーを1つ押す・離す（置き換え先のキーや、止めていたキーの送り直し）
+static void SendKey(VkCode vk, bool down) {
+    InputEvent ev;
+    ev.type = down ? EVENT_KEY_DOWN : EVENT_KEY_UP;
+    ev.extended = IsExtendedKey(vk);
+    ev.code = vk;
+    g_inputSink.Send(&ev, 1);
 }
 
-// 特定のキーコード（vkCode）に対応するキーを離す動作（KeyUp）を送信する関数
-void SendKeyUp(WORD vkCode) {
-    INPUT input = {0};
-    input.type = INPUT_KEYBOARD;
-    input.ki.wVk = vkCode;
-    input.ki.dwFlags = KEYEVENTF_KEYUP;
-    if (vkCode == VK_RCONTROL || vkCode == VK_RMENU || vkCode == VK_RSHIFT ||
-        vkCode == VK_UP || vkCode == VK_DOWN || vkCode == VK_LEFT || vkCode == VK_RIGHT ||
-        vkCode == VK_DELETE || vkCode == VK_HOME || vkCode == VK_END || vkCode == VK_INSERT ||
-        vkCode == VK_PRIOR || vkCode == VK_NEXT) {
-        input.ki.dwFlags |= KEYEVENTF_EXTENDEDKEY;
-    }
-    SendInput(1, &input, sizeof(INPUT));
+// 押している間だけ有効にしたレイヤー（フックのスレッドだけが触る）。キー → LayerId（0 なら無し）
+static uint32_t g_layerHeldBy[256];
+
+// 画面に出している状態（稼働中/停止中・有効なレイヤー）をフックが変えたら、描画ループを起こす
+// フックは描画ループと同じスレッドで呼ばれるので、自分のスレッドに空のメッセージを積むだけでよい
+static void RequestRedraw() {
+    PostThreadMessageW(GetCurrentThreadId(), WM_NULL, 0, 0);
 }
 
-// Unicode文字列送信
-void SendText(const std::string& utf8Text) {
-    std::wstring wstr = utf8_to_wstring(utf8Text);
-    for (wchar_t c : wstr) {
-        INPUT inputs[2] = {};
-        // Down
-        inputs[0].type = INPUT_KEYBOARD;
-        inputs[0].ki.wScan = c;
-        inputs[0].ki.dwFlags = KEYEVENTF_UNICODE;
-        // Up
-        inputs[1] = inputs[0];
-        inputs[1].ki.dwFlags |= KEYEVENTF_KEYUP;
-        
-        SendInput(2, inputs, sizeof(INPUT));
+// 発動したマクロを実行側に積む。レイヤーの切り替えはその場で行う
+// vk は発動させたキー（押している間だけのレイヤーはこのキーを離したときに外す。0 なら入れ替えとして扱う）
+static void TriggerMacro(const CompiledMacroPtr& macro, VkCode vk, bool isRepeat, int64_t nowNs) {
+    g_eventLog.Push(LOG_MACRO_TRIGGERED, macro->id, (int64_t)vk);
+    if (macro->layerSwitch != LAYER_SWITCH_NONE && !isRepeat) {
+        if (macro->layerSwitch == LAYER_SWITCH_HOLD && vk != 0 && vk < 256) {
+            g_layers.Push(macro->layerSwitchId);
+            g_layerHeldBy[vk] = macro->layerSwitchId;
+        } else {
+            g_layers.Toggle(macro->layerSwitchId);
+        }
+        RequestRedraw();
     }
+    // 切り替えだけのマクロは送るものが無い
+    if (!macro->stream.spans.empty()) g_executor.Submit(macro, isRepeat, nowNs);
 }
 
-// 修正版: エラーに強い読み込み関数
-void LoadMacrosFromFile(const std::string& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        // 初回起動時などはファイルがないのが普通なので、エラーにはしない
-        std::cout << "[INFO] Macro file not found. Starting with empty list." << std::endl;
-        return;
+// デュアルロールキーの判定状態（フックのスレッドだけが触る）
+static TapHoldTracker g_tapHold;
+
+// キー列の照合状態（フックのスレッドだけが触る。待ち時間切れのタイマーも同じスレッドで呼ばれる）
+static KeySequenceTracker g_sequenceTracker;
+static UINT_PTR g_sequenceTimer = 0;
+
+static VOID CALLBACK SequenceTimerProc(HWND, UINT, UINT_PTR, DWORD);
+
+// キー列の照合結果を反映する: 止めていたキーを送り直し、発動したマクロを実行側に積む
+// 続きのキーを待っている間は、待ち時間が切れたときに呼ばれるようタイマーを掛け直す
+static void ApplySequenceOutput(const DispatchTable& table, const KeySequenceOutput& out, VkCode vk, int64_t nowNs) {
+    if (out.replayCount > 0) g_inputSink.Send(out.replay, out.replayCount);
+    if (out.fireMacro >= 0 && g_macroEnabled) TriggerMacro(table.macros[out.fireMacro], vk, false, nowNs);
+    if (g_sequenceTracker.Pending()) {
+        int64_t remainingMs = (g_sequenceTracker.DeadlineNs() - nowNs + 999999) / 1000000;
+        if (remainingMs < USER_TIMER_MINIMUM) remainingMs = USER_TIMER_MINIMUM;
+        g_sequenceTimer = SetTimer(NULL, g_sequenceTimer, (UINT)remainingMs, SequenceTimerProc);
+    } else if (g_sequenceTimer != 0) {
+        KillTimer(NULL, g_sequenceTimer);
+        g_sequenceTimer = 0;
     }
+}
 
-    global_macros.clear();
-    std::string line;
-
-    while (std::getline(file, line)) {
-        if (line.empty() || line[0] == '#') continue;
-        
-        // 最後の2つ (Type, Data) とそれ以前 (Hotkeys) に分ける
-        size_t lastComma = line.find_last_of(',');
-        if (lastComma == std::string::npos) continue;
-        std::string dataPart = line.substr(lastComma + 1); // Data
-        
-        // Dataの前の部分 (Hotkeys..., Type)
-        std::string preData = line.substr(0, lastComma);
-        size_t typeComma = preData.find_last_of(',');
-        if (typeComma == std::string::npos) continue;
-        
-        std::string typeStr = preData.substr(typeComma + 1); // Type
-        std::string hotkeysPart = preData.substr(0, typeComma); // Hotkeys...
+static VOID CALLBACK SequenceTimerProc(HWND, UINT, UINT_PTR, DWORD) {
+    MacroTableSnapshot table(g_macroTable);
+    const DispatchTable& dispatch = ActiveDispatch(*table);
+    KeySequenceOutput out;
+    int64_t now = g_clock.NowNs();
+    g_sequenceTracker.OnTimeout(dispatch.sequences, dispatch.generation, now, out);
+    ApplySequenceOutput(dispatch, out, 0, now);
+}
 
-        // 空白除去
-        auto trim = [](std::string& s) {
-            s.erase(0, s.find_first_not_of(" \t"));
-            s.erase(s.find_last_not_of(" \t") + 1);
-        };
-        trim(typeStr); trim(dataPart);
-
-        // アクション作成
-        MacroAction action;
-        if (typeStr == "COMBO") {
-            action.type = ACTION_COMBO;
-            std::stringstream ss(dataPart);
-            std::string codeStr;
-            while (std::getline(ss, codeStr, ':')) {
-                try { action.comboKeys.push_back((WORD)std::stoi(codeStr)); } catch(...) {}
+// 物理キーのイベントをマクロの判定（置き換え・ホットキー・キー列・ホットストリング）に通す。キーを止めるなら true
+// デュアルロールキーの判定で止めていたイベントも、送り直す前にここを通す
+static bool DispatchKeyEvent(VkCode vk, bool down, bool isRepeat, int64_t nowNs) {
+    if (down) {
+        // マクロが無効なら通常キー入力をそのまま通す
+        if (!g_macroEnabled) return false;
+
+        // 押されたキーを含むマクロだけを索引から引いてチェック
+        // キー列の続きを待っている間は、途中のキーでホットキーを発動させない
+        MacroTableSnapshot table(g_macroTable);
+        const DispatchTable& dispatch = ActiveDispatch(*table);
+
+        // 1:1 の置き換え: 実行スレッドを通さず、押す（キーリピートも）をその場で送る
+        if (vk < 256 && !g_sequenceTracker.Pending()) {
+            VkCode to = g_remappedTo[vk] != 0 ? g_remappedTo[vk] : dispatch.remap.to[vk];
+            if (to != 0) {
+                if (g_remappedTo[vk] == 0) {
+                    g_remappedTo[vk] = to;
+                    g_eventLog.Push(LOG_MACRO_TRIGGERED, dispatch.macros[dispatch.remap.macro[vk]]->id, (int64_t)vk);
+                }
+                SendKey(to, true);
+                return true;
             }
-        } else if (typeStr == "TEXT") {
-            action.type = ACTION_TEXT;
-            action.text = dataPart;
-        } else if (typeStr == "WAIT") {
-            action.type = ACTION_WAIT;
-            try { action.waitMs = std::stoi(dataPart); } catch(...) { action.waitMs = 0; }
-        } else {
-            // 旧フォーマット互換用 (KEYDOWN/KEYUPなど) は今回は簡易化のため省略
-            // 必要ならここにロジック追加
-            continue; 
         }
 
-        // ホットキー解析
-        std::vector<WORD> hks;
-        std::stringstream ssHk(hotkeysPart);
-        std::string hkToken;
-        while (std::getline(ssHk, hkToken, ',')) {
-            trim(hkToken);
-            if (!hkToken.empty()) hks.push_back(StringToVkCode(hkToken));
+        int macroIndex = -1;
+        if (!g_sequenceTracker.Pending()) {
+            macroIndex = dispatch.index.FindTriggered(vk, g_keyState.Snapshot());
         }
-
-        if (!hks.empty()) {
-            bool found = false;
-            for (auto& m : global_macros) {
-                if (m.hotkeys == hks) {
-                    m.actions.push_back(action);
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
-                Macro new_m;
-                new_m.hotkeys = hks;
-                new_m.actions.push_back(action);
-                global_macros.push_back(new_m);
-            }
+        if (macroIndex >= 0) {
+            // マクロ実行は常駐スレッドに任せる（ここではキューに積むだけ）
+            // 実行中の再発動やキーリピートを無視した場合も、キー入力自体はブロックする
+            TriggerMacro(dispatch.macros[macroIndex], vk, isRepeat, nowNs);
+            return true;
         }
-    }
-    std::cout << "[INFO] Loaded macros." << std::endl;
-}
-
-// マクロをファイルに保存する関数
-void SaveMacrosToFile(const std::string& filename) {
-    std::ofstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "[ERROR] Could not open file for writing: " << filename << std::endl;
-        return;
-    }
 
-    // ヘッダー（説明書き）
-    file << "# Hotkey, Key, Type, WaitMs\n";
+        // キー列: 途中まで一致したキーは止めておき、一致しなければ送り直す
+        // キー列を始めないキーは遷移表を1回引くだけで通す
+        if (!dispatch.sequences.Empty() || g_sequenceTracker.Pending()) {
+            KeySequenceOutput out;
+            bool block = g_sequenceTracker.OnKeyDown(dispatch.sequences, dispatch.generation, vk, isRepeat, nowNs, out);
+            ApplySequenceOutput(dispatch, out, vk, nowNs);
+            if (block) return true;
+        }
 
-    for (const auto& macro : global_macros) {
-        for (const auto& action : macro.actions) {
-            // 1. ホットキーたちを書き出す
-            for (size_t i = 0; i < macro.hotkeys.size(); i++) {
-                char hkStr[16];
-                sprintf_s(hkStr, "0x%02X, ", macro.hotkeys[i]);
-                file << hkStr;
+        // ホットストリング: 入力し終えたら、最後の1文字は通さずに展開する（それまでの文字は実行側が消す）
+        if (!dispatch.hotstrings.Empty()) {
+            int hotstringIndex = AdvanceHotstring(dispatch, vk);
+            if (hotstringIndex >= 0) {
+                g_hotstringState = HotstringMatcher::kRootState;
+                TriggerMacro(dispatch.macros[hotstringIndex], vk, false, nowNs);
+                return true;
             }
-            
-            // 2. アクション内容を書き出す
-            if (action.type == ACTION_COMBO) {
-                file << "COMBO, ";
-                for (size_t k = 0; k < action.comboKeys.size(); k++) {
-                    file << (int)action.comboKeys[k] << (k == action.comboKeys.size() - 1 ? "" : ":");
-                }
-            } else if (action.type == ACTION_TEXT) {
-                file << "TEXT, " << action.text;
-            } else if (action.type == ACTION_WAIT) {
-                file << "WAIT, " << action.waitMs;
-            }
-            file << "\n";
         }
+        return false;
     }
-    std::cout << "[INFO] Macros saved to " << filename << std::endl;
-}
 
-// マクロ読み込み関数
-void RunMacroAsync(std::vector<MacroAction> actions) {
-    // 1. フック処理が落ち着くまでほんの少し待つ
-    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-
-    // 2. 邪魔になりそうな修飾キー（Ctrl, Shift, Alt）が押されていたら、一時的に「離す」信号を送る
-    std::vector<WORD> modifiersToRestore;
-    // チェックするキー: Shift, Ctrl, Alt (左右含む)
-    WORD checkList[] = {VK_LSHIFT, VK_RSHIFT, VK_SHIFT, 
-                        VK_LCONTROL, VK_RCONTROL, VK_CONTROL, 
-                        VK_LMENU, VK_RMENU, VK_MENU };
-
-    for (WORD vk : checkList) {
-        // 物理的に押されているかチェック (最上位ビットが1なら押されている)
-        if (GetAsyncKeyState(vk) & 0x8000) {
-            SendKeyUp(vk);             // 一旦離す
-            modifiersToRestore.push_back(vk); // 「離したよ」と記録しておく
-        }
+    // 押している間だけ有効にしたレイヤーは、発動させたキーを離したときに外す（離す操作自体は通す）
+    if (vk < 256 && g_layerHeldBy[vk] != 0) {
+        g_layers.Remove(g_layerHeldBy[vk]);
+        g_layerHeldBy[vk] = 0;
+        RequestRedraw();
+    }
+    // 置き換えたキーは、物理キーを離したときに離す
+    if (vk < 256 && g_remappedTo[vk] != 0) {
+        SendKey(g_remappedTo[vk], false);
+        g_remappedTo[vk] = 0;
+        return true;
     }
+    // キー列のために止めた押下に対応する離す操作も止める
+    return g_sequenceTracker.OnKeyUp(vk);
+}
 
-    // 念のため少し待機
-    std::this_thread::sleep_for(std::chrono::milliseconds(5));
-
-    // 3. マクロ本番を実行
-    for (const auto& action : actions) {
-        if (action.type == ACTION_COMBO) {
-            // 全押し
-            for (WORD k : action.comboKeys) SendKeyDown(k);
-            std::this_thread::sleep_for(std::chrono::milliseconds(10)); // 安定のため少し待つ
-            // 全離し（逆順推奨だが同時なら順序問わず）
-            for (WORD k : action.comboKeys) SendKeyUp(k);
-        }
-        else if (action.type == ACTION_TEXT) {
-            SendText(action.text);
+// デュアルロールキーの判定で、タップの時間が切れたときに呼ばれるタイマー（フックのスレッドで呼ばれる）
+static UINT_PTR g_tapHoldTimer = 0;
+
+static VOID CALLBACK TapHoldTimerProc(HWND, UINT, UINT_PTR, DWORD);
+
+// デュアルロールキーの判定結果を順番に反映する
+// 止めていた物理キーは、押下状態をそのイベントの時点に合わせてからマクロの判定に通し、止めなければ送る
+// 判定待ちのキーがあれば、ホールドに決まる時刻に呼ばれるようタイマーを掛け直す
+static void ApplyTapHoldOutput(const DispatchTable& table, const TapHoldOutput& out, int64_t nowNs) {
+    InputEvent send[kMaxTapHoldOutput];
+    uint32_t sendCount = 0;
+    for (uint32_t i = 0; i < out.count; i++) {
+        const TapHoldStep& step = out.steps[i];
+        VkCode vk = step.event.code;
+        bool down = step.event.type == EVENT_KEY_DOWN;
+        if (step.type == TAP_HOLD_SEND || step.type == TAP_HOLD_HOLD_KEY) {
+            // ホールドの代わりのキーは物理キーと同じく押下状態に入れる（Ctrl+C などのホットキーの判定に使う）
+            if (step.type == TAP_HOLD_HOLD_KEY) g_keyState.OnKeyEvent(vk, down);
+            send[sendCount++] = step.event;
+            continue;
         }
-        else if (action.type == ACTION_WAIT) {
-            if (action.waitMs > 0) Sleep(action.waitMs);
+        // 判定やマクロが送るものより後に届くよう、ここまでの分を送ってから
+        if (sendCount > 0) g_inputSink.Send(send, sendCount);
+        sendCount = 0;
+        if (step.type == TAP_HOLD_MACRO) {
+            // タップで決まったときはキーを離し終えているので、押している間だけのレイヤーも入れ替えにする
+            TriggerMacro(table.macros[step.macro], 0, false, nowNs);
+        } else {
+            g_keyState.OnKeyEvent(vk, down);
+            if (!DispatchKeyEvent(vk, down, false, nowNs)) SendKey(vk, down);
         }
     }
-
-    // 4. マクロ終了後の処理: 修飾キー復帰
-    for (WORD vk : modifiersToRestore) {
-        if (GetAsyncKeyState(vk) & 0x8000) {
-            SendKeyDown(vk); // まだ指があるなら、論理的にも押した状態に戻す
-        }
-        // 指を離していたら何もしない（これで押しっぱなし地獄から解放されます）
+    if (sendCount > 0) g_inputSink.Send(send, sendCount);
+
+    if (g_tapHold.Undecided()) {
+        int64_t remainingMs = (g_tapHold.DeadlineNs() - nowNs + 999999) / 1000000;
+        if (remainingMs < USER_TIMER_MINIMUM) remainingMs = USER_TIMER_MINIMUM;
+        g_tapHoldTimer = SetTimer(NULL, g_tapHoldTimer, (UINT)remainingMs, TapHoldTimerProc);
+    } else if (g_tapHoldTimer != 0) {
+        KillTimer(NULL, g_tapHoldTimer);
+        g_tapHoldTimer = 0;
     }
 }
 
-// --- 1. フックプロシージャ（監視関数） -----------------------------
-LRESULT CALLBACK KeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
+static VOID CALLBACK TapHoldTimerProc(HWND, UINT, UINT_PTR, DWORD) {
+    MacroTableSnapshot table(g_macroTable);
+    const DispatchTable& dispatch = ActiveDispatch(*table);
+    TapHoldOutput out;
+    int64_t now = g_clock.NowNs();
+    g_tapHold.OnTimeout(dispatch.tapHold, dispatch.generation, now, out);
+    ApplyTapHoldOutput(dispatch, out, now);
+}
+
+// hookStartNs はフックが呼ばれた時刻（マクロの発動時刻として実行側に渡す）
+static LRESULT HandleKeyboardEvent(int nCode, WPARAM wParam, LPARAM lParam, int64_t hookStartNs) {
     if (nCode >= 0) {
         KBDLLHOOKSTRUCT* pKeyBoard = (KBDLLHOOKSTRUCT*)lParam;
 
@@ -390,92 +359,66 @@ LRESULT CALLBACK KeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
             return CallNextHookEx(hKeyboardHook, nCode, wParam, lParam);
         }
 
-        if (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN) {
-            // F12 は常にハンドル（Ctrl+F12でマクロON/OFF、単独F12で終了）
-            if (pKeyBoard->vkCode == VK_F12) {
-                if (GetAsyncKeyState(VK_CONTROL) & 0x8000) {
-                    g_macroEnabled = !g_macroEnabled; // ON/OFF反転
-                    std::cout << "[INFO] Macro " << (g_macroEnabled ? "enabled" : "disabled") << std::endl;
-                } else {
-                    PostQuitMessage(0); // Ctrlなしなら終了
-                }
-                return 1;
-            }
-
-            // マクロが無効なら通常キー入力をそのまま通す
-            if (!g_macroEnabled) {
-                return CallNextHookEx(hKeyboardHook, nCode, wParam, lParam);
-            }
+        // 物理キーの押下状態を更新（マクロ判定より先に反映する）
+        bool isKeyDown = (wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN);
+        bool isRepeat = false; // 押しっぱなしによるキーリピートか
+        if (isKeyDown || wParam == WM_KEYUP || wParam == WM_SYSKEYUP) {
+            isRepeat = g_keyState.OnKeyEvent((WORD)pKeyBoard->vkCode, isKeyDown) && isKeyDown;
+        }
+        // 起動キー・コンボの記録中なら UI にも渡す
+        if (isKeyDown && !isRepeat) g_keyCapture.OnKeyDown((WORD)pKeyBoard->vkCode);
 
-            // 登録されている全マクロをチェック
-            for (const auto& macro : global_macros) {
-                if (macro.hotkeys.empty()) continue;
-
-                // 1. まず「今押されたキー」がホットキーの一部に含まれているか確認
-                bool isTriggerKey = false;
-                for (WORD hk : macro.hotkeys) {
-                    // 左右の区別なく判定（今押されたのがLかRで、設定が共通コードなら一致とみなす）
-                    if (pKeyBoard->vkCode == hk) {
-                        isTriggerKey = true;
-                    } else if (hk == VK_CONTROL && (pKeyBoard->vkCode == VK_LCONTROL || pKeyBoard->vkCode == VK_RCONTROL)) {
-                        isTriggerKey = true;
-                    } else if (hk == VK_MENU && (pKeyBoard->vkCode == VK_LMENU || pKeyBoard->vkCode == VK_RMENU)) {
-                        isTriggerKey = true;
-                    } else if (hk == VK_SHIFT && (pKeyBoard->vkCode == VK_LSHIFT || pKeyBoard->vkCode == VK_RSHIFT)) {
-                        isTriggerKey = true;
-                    }
-                    if (isTriggerKey) break;
-                }
-                if (!isTriggerKey) continue; 
-
-                // 2. ホットキーの構成キーが「全て」押されているかチェック
-                bool allPressed = true;
-                for (WORD hk : macro.hotkeys) {
-                    bool isThisKeyPressed = false;
-
-                    // 今まさに押されたキーそのものならOK
-                    if (hk == pKeyBoard->vkCode) {
-                        isThisKeyPressed = true;
-                    } 
-                    // 設定が共通Ctrlで、物理的にLかRのどちらかが押されているか
-                    else if (hk == VK_CONTROL) {
-                        if ((GetAsyncKeyState(VK_LCONTROL) & 0x8000) || (GetAsyncKeyState(VK_RCONTROL) & 0x8000)) isThisKeyPressed = true;
-                    }
-                    // 設定が共通Alt(MENU)で、物理的にLかRのどちらかが押されているか
-                    else if (hk == VK_MENU) {
-                        if ((GetAsyncKeyState(VK_LMENU) & 0x8000) || (GetAsyncKeyState(VK_RMENU) & 0x8000)) isThisKeyPressed = true;
-                    }
-                    // 設定が共通Shiftで、物理的にLかRのどちらかが押されているか
-                    else if (hk == VK_SHIFT) {
-                        if ((GetAsyncKeyState(VK_LSHIFT) & 0x8000) || (GetAsyncKeyState(VK_RSHIFT) & 0x8000)) isThisKeyPressed = true;
-                    }
-                    // その他の通常のキー
-                    else if (GetAsyncKeyState(hk) & 0x8000) {
-                        isThisKeyPressed = true;
-                    }
+        // キー操作の記録中は、押す・離す（キーリピートを含む）をそのまま記録し、マクロは発動させない
+        if (g_rawRecorder.Recording() && (isKeyDown || wParam == WM_KEYUP || wParam == WM_SYSKEYUP)) {
+            g_rawRecorder.OnKeyEvent((WORD)pKeyBoard->vkCode, isKeyDown, (pKeyBoard->flags & LLKHF_EXTENDED) != 0, hookStartNs);
+            return CallNextHookEx(hKeyboardHook, nCode, wParam, lParam);
+        }
 
-                    if (!isThisKeyPressed) {
-                        allPressed = false;
-                        break;
-                    }
-                }
+        // デュアルロールキー: タップかホールドか決まるまで後のキーを止めておき、決まったら順番どおり判定に通し直す
+        // F12 は止めない。マクロを無効にしても、ホールド中のキーを離す処理は続ける
+        bool isKeyUp = (wParam == WM_KEYUP || wParam == WM_SYSKEYUP);
+        if ((isKeyDown || isKeyUp) && pKeyBoard->vkCode != VK_F12 && (g_macroEnabled || g_tapHold.Busy())) {
+            MacroTableSnapshot table(g_macroTable);
+            const DispatchTable& dispatch = ActiveDispatch(*table);
+            if (!dispatch.tapHold.Empty() || g_tapHold.Busy()) {
+                TapHoldOutput out;
+                bool block = g_tapHold.OnKeyEvent(dispatch.tapHold, dispatch.generation, (WORD)pKeyBoard->vkCode, isKeyDown, isRepeat, hookStartNs, out);
+                ApplyTapHoldOutput(dispatch, out, hookStartNs);
+                if (block) return 1;
+            }
+        }
 
-                if (allPressed) {
-                    std::cout << "\n[MACRO] Detected. Executing in thread..." << std::endl;
-                    // マクロ実行を別スレッドに投げる
-                    std::thread(RunMacroAsync, macro.actions).detach();
-                    return 1; // 入力をブロック
-                }
+        if (isKeyDown && pKeyBoard->vkCode == VK_F12) {
+            // F12 は常にハンドル（Ctrl+F12でマクロON/OFF、単独F12で終了）
+            if (g_keyState.IsKeyDown(VK_CONTROL)) {
+                g_macroEnabled = !g_macroEnabled; // ON/OFF反転
+                RequestRedraw();
+                g_eventLog.Push(LOG_MACROS_TOGGLED, kNoMacroId, g_macroEnabled ? 1 : 0);
+            } else {
+                PostQuitMessage(0); // Ctrlなしなら終了
             }
+            return 1;
+        }
+        if ((isKeyDown || isKeyUp) && DispatchKeyEvent((WORD)pKeyBoard->vkCode, isKeyDown, isRepeat, hookStartNs)) {
+            return 1; // 入力をブロック
         }
     }
 
     return CallNextHookEx(hKeyboardHook, nCode, wParam, lParam);
 }
 
+LRESULT CALLBACK KeyboardProc(int nCode, WPARAM wParam, LPARAM lParam) {
+    int64_t start = g_clock.NowNs();
+    LRESULT result = HandleKeyboardEvent(nCode, wParam, lParam, start);
+    g_hookTime.Record((uint64_t)(g_clock.NowNs() - start) / 1000);
+    return result;
+}
+
 // --- 2. フック設定 ------------------------------------------------
 void SetHook() {
     std::cout << "[INFO] Setting up Global Keyboard Hook..." << std::endl;
+    // フックはこのスレッドで呼ばれるので、設定前にここで押下状態を合わせておく
+    SyncKeyStateFromOS(g_keyState);
     hKeyboardHook = SetWindowsHookEx(WH_KEYBOARD_LL, KeyboardProc, NULL, 0);
 
     if (hKeyboardHook == NULL) {
@@ -600,40 +543,6 @@ LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
     return DefWindowProc(hWnd, msg, wParam, lParam);
 }
 
-// キーコードを読みやすい文字に変換するヘルパー関数
-std::string VkCodeToString(WORD vk) {
-    // 左右のキーを共通の名前に変換して表示
-    if (vk == VK_CONTROL || vk == 162 || vk == 163) return "Ctrl";
-    if (vk == VK_MENU    || vk == 164 || vk == 165) return "Alt";
-    if (vk == VK_SHIFT   || vk == 160 || vk == 161) return "Shift";
-
-    // 数字 (0-9) と アルファベット (A-Z)
-    if ((vk >= '0' && vk <= '9') || (vk >= 'A' && vk <= 'Z')) {
-        return std::string(1, (char)vk);
-    }
-    // ファンクションキー (F1 - F24)
-    if (vk >= VK_F1 && vk <= VK_F24) {
-        return "F" + std::to_string(vk - VK_F1 + 1);
-    }
-    // 特殊キー
-    switch(vk) {
-        case VK_RETURN: return "Enter";
-        case VK_ESCAPE: return "Esc";
-        case VK_BACK:   return "BackSpace";
-        case VK_TAB:    return "Tab";
-        case VK_SPACE:  return "Space";
-        case VK_SHIFT:  return "Shift";
-        case VK_CONTROL:return "Ctrl";
-        case VK_MENU:   return "Alt";
-        case VK_UP:     return "Up";
-        case VK_DOWN:   return "Down";
-        case VK_LEFT:   return "Left";
-        case VK_RIGHT:  return "Right";
-    }
-    // その他は数値をそのまま表示
-    return "Key:" + std::to_string(vk);
-}
-
 // --- 最終的なプログラムの開始点 ---
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
@@ -647,7 +556,11 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     // SetConsoleOutputCP(CP_UTF8);
     
     // A. マクロデータのロード
-    LoadMacrosFromFile("macros.txt");
+    // 変換済みのキャッシュがあればそれを使い、無ければ macros.txt を解析する
+    std::unique_ptr<MacroTable> loadedTable;
+    if (LoadMacrosCached("macros.txt", global_macros, loadedTable)) {
+        g_macroTable.Publish(std::move(loadedTable));
+    }
     
     // B. ウィンドウクラスの登録
 
@@ -682,7 +595,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         return 1;
     }
 
-    // E. フックの設定
+    // E. マクロ実行スレッド・自動保存スレッドの起動とフックの設定
+    g_logWriter.Start();
+    g_executor.SetEventLog(&g_eventLog);
+    g_executor.Start(4);
+    g_saver.Start();
+    g_typedChars.Build();
     SetHook(); // 既存のフック設定関数
 
     // F. ウィンドウの表示
@@ -723,16 +641,44 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     }
 
     // --- 2. メインループ（描画ループ） ---
+    // 描画は入力などのメッセージが来てから数フレームだけ行い、それ以外はメッセージを待って眠る。
+    // ウィンドウを隠している (タスクトレイ) / 最小化している間は一切描画しない。
+    // フックの呼び出しもこのスレッドのメッセージ処理で行われるので、待機中もフックは動きます。
+    const int kFramesAfterInput = 3;     // 入力後に描画するフレーム数（ImGui の状態が落ち着くまで）
+    const DWORD kIdleRefreshMs = 250;    // 診断タブを開いている間は、操作が無くても数値をこの間隔で更新する
+    int framesToRender = kFramesAfterInput;
+    bool diagnosticsOpen = false;        // 前のフレームで診断タブを開いていたか
     MSG msg;
     ZeroMemory(&msg, sizeof(msg));
     while (msg.message != WM_QUIT)
     {
-        if (PeekMessage(&msg, NULL, 0U, 0U, PM_REMOVE))
+        bool visible = IsWindowVisible(hwnd) && !IsIconic(hwnd);
+        // キーの記録中は、フックから届いたキーをすぐ表示するため描画し続ける
+        if (visible && (g_keyCapture.Enabled() || g_rawRecorder.Recording())) framesToRender = kFramesAfterInput;
+
+        if (!visible || framesToRender == 0) {
+            // 待っている間の状態の変化は、フックが RequestRedraw で知らせる
+            DWORD wait = MsgWaitForMultipleObjectsEx(0, NULL, (visible && diagnosticsOpen) ? kIdleRefreshMs : INFINITE,
+                                                     QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+            if (wait == WAIT_TIMEOUT && visible) framesToRender = 1;
+        }
+
+        while (PeekMessage(&msg, NULL, 0U, 0U, PM_REMOVE))
         {
             TranslateMessage(&msg);
             DispatchMessage(&msg);
-            continue;
+            if (msg.message == WM_QUIT) break;
+            framesToRender = kFramesAfterInput;
         }
+        if (msg.message == WM_QUIT) break;
+
+        // 差し替え済みのマクロ表を解放する（フックが参照中なら次のフレームに回す）
+        g_macroTable.Reclaim();
+
+        if (!visible || framesToRender == 0) continue;
+        framesToRender--;
+        g_renderedFrames++;
+        diagnosticsOpen = false;
 
         // H. ImGuiの描画開始
         ImGui_ImplDX11_NewFrame();
@@ -771,6 +717,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
             { u8"Esc", VK_ESCAPE },      { u8"Tab", VK_TAB },
             { u8"Enter", VK_RETURN },    { u8"BackSpace", VK_BACK }
         };
+        // デュアルロールキーを押し続けたときに代わりに押すキー（修飾キー）
+        static const std::vector<SpKeyDef> hold_keys = {
+            { u8"左Ctrl", VK_LCONTROL }, { u8"右Ctrl", VK_RCONTROL },
+            { u8"左Shift", VK_LSHIFT },  { u8"右Shift", VK_RSHIFT },
+            { u8"左Alt", VK_LMENU },     { u8"右Alt", VK_RMENU },
+            { u8"左Win", VK_LWIN }
+        };
 
         // 新規マクロ追加エリア
         static std::vector<WORD> new_hotkeys; // 登録予定のキーリスト
@@ -788,7 +741,18 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         static bool is_rec_combo = false;
         static std::vector<WORD> temp_combo_keys;
         static char temp_text_buf[256] = "";
+        static char new_hotstring_buf[64] = ""; // 入力で発動する文字列 (基本タブのみ)
+        static std::vector<WORD> new_sequence;  // 順に押すと発動するキー列 (基本タブのみ)
+        static bool is_recording_sequence = false;
+        static int new_sequence_timeout_ms = 1000; // キー列で次のキーを待つ時間
         static int temp_wait_ms = 100;
+        static int new_concurrency = CONCURRENCY_DROP; // 実行中に再発動したときの扱い
+        static bool new_allow_repeat = false;          // 押しっぱなしで連続実行するか
+        static int new_hold_ms = 10;                   // コンボの押しっぱなし時間
+        static int new_inter_key_ms = 0;               // キー・文字を1つずつ送る間隔 (0:まとめて送る)
+        static char new_layer_buf[32] = "";            // 所属するレイヤー (空欄なら基本レイヤー)
+        static char temp_layer_buf[32] = "";           // レイヤー切り替えのアクションで切り替えるレイヤー
+        static int temp_layer_mode = 0;                // 0:切り替え, 1:押している間だけ
 
         // --- 特殊ページ専用の変数を追加 (sp_ を付与) ---
         static std::vector<WORD> sp_new_hotkeys; 
@@ -796,11 +760,21 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         static std::vector<MacroAction> sp_new_actions;
         static bool sp_is_rec_combo = false;
         static std::vector<WORD> sp_temp_combo_keys;
+        static bool sp_dual_role = false;       // 短く押すと実行内容、押し続けると修飾キーとして使う
+        static int sp_hold_key_idx = 0;         // 押し続けたときのキー (hold_keys の添字)
+        static int sp_tap_timeout_ms = 200;     // これより短く押して離したらタップ
+        static bool sp_permissive_hold = true;  // タップの時間内でも、他のキーを押して離したらホールド
 
         static int current_tab = 0; // 0:基本, 1:特殊 を記録する変数
 
         static bool request_text_popup = false; // ポップアップを開く合図
         static bool request_wait_popup = false;
+        static bool request_layer_popup = false;
+
+        // 記録中だけフックからキー押下を受け取る
+        g_keyCapture.SetEnabled(is_recording_hotkey || is_rec_combo || is_recording_sequence || sp_is_recording_hotkey || sp_is_rec_combo, g_keyState);
+        // キー操作の記録中は、フックから届いたイベントを毎フレーム取り込む
+        g_rawRecorder.Drain();
 
         // タブ機能の開始
         if (ImGui::BeginTabBar("MacroTabs")) {
@@ -837,27 +811,74 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                     }
                     ImGui::SameLine(); ImGui::Text(u8"キーを入力中...");
 
-                    for (int k = 8; k < 240; k++) {
-                        if (GetAsyncKeyState(k) & 0x8001 && k != VK_LBUTTON && k != VK_RBUTTON) {
-                            WORD nmK = (WORD)k; // 通常のキー記録処理
-                            if (k==VK_LCONTROL||k==VK_RCONTROL) nmK=VK_CONTROL;
-                            if (k==VK_LSHIFT||k==VK_RSHIFT) nmK=VK_SHIFT;
-                            if (k==VK_LMENU||k==VK_RMENU) nmK=VK_MENU;
-                            if (std::find(new_hotkeys.begin(), new_hotkeys.end(), nmK) == new_hotkeys.end()) new_hotkeys.push_back(nmK);
-                        }
-                    }
+                    // フックから届いたキー押下を取り込む
+                    g_keyCapture.DrainInto(new_hotkeys);
                 } else {
                     // 記録開始ボタンを押すと、入力をクリアして記録モードに入る
-                    if (ImGui::Button(u8"記録開始")) { new_hotkeys.clear(); is_recording_hotkey = true; selected_sp_hotkey_idx = 0; } // 通常記録時は特殊選択リセット
+                    if (ImGui::Button(u8"記録開始")) { new_hotkeys.clear(); is_recording_hotkey = true; is_recording_sequence = false; selected_sp_hotkey_idx = 0; } // 通常記録時は特殊選択リセット
                     ImGui::SameLine();
                     if (ImGui::Button(u8"クリア")) { new_hotkeys.clear(); }
                 }
 
+                // --- ホットストリング（起動キーの代わりに、この文字列を入力したら発動） ---
+                ImGui::SetNextItemWidth(160);
+                ImGui::InputText(u8"入力で発動 (例: ;addr)##Hotstring", new_hotstring_buf, sizeof(new_hotstring_buf));
+                ImGui::SameLine();
+                ImGui::TextDisabled(u8"最後の文字を打つと、打った文字を消して実行します");
+
+                // --- キー列（リーダーキー。例: 無変換 → J → K の順に押したら発動） ---
+                ImGui::Text(u8"キー列で発動: %s", new_sequence.empty() ? u8"(未設定)" : JoinSequence(new_sequence).c_str());
+                if (is_recording_sequence) {
+                    ImGui::PushStyleColor(ImGuiCol_Button, (ImVec4)ImColor::HSV(0.0f, 0.6f, 0.6f));
+                    if (ImGui::Button(u8"記録完了##Sequence")) is_recording_sequence = false;
+                    ImGui::PopStyleColor();
+                    ImGui::SameLine();
+                    if (ImGui::Button(u8"1つ削除##Sequence")) {
+                        if (!new_sequence.empty()) new_sequence.pop_back();
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button(u8"キャンセル##Sequence")) {
+                        is_recording_sequence = false; new_sequence.clear();
+                    }
+                    ImGui::SameLine(); ImGui::Text(u8"順にキーを押してください (最大 %d キー)", (int)kMaxSequenceKeys);
+
+                    g_keyCapture.DrainOrdered(new_sequence);
+                    if (new_sequence.size() > kMaxSequenceKeys) new_sequence.resize(kMaxSequenceKeys);
+                } else {
+                    if (ImGui::Button(u8"記録開始##Sequence")) { new_sequence.clear(); is_recording_sequence = true; is_recording_hotkey = false; }
+                    ImGui::SameLine();
+                    if (ImGui::Button(u8"クリア##Sequence")) { new_sequence.clear(); }
+                }
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(100);
+                ImGui::InputInt(u8"次のキーを待つ ms##SequenceTimeout", &new_sequence_timeout_ms, 100);
+                if (new_sequence_timeout_ms < 100) new_sequence_timeout_ms = 100;
+                if (new_sequence_timeout_ms > 10000) new_sequence_timeout_ms = 10000;
+
                 ImGui::Separator();
                 ImGui::Text(u8"② 実行内容");
 
                 // --- アクション設定 (既存コード) ---
-                if (is_rec_combo) {
+                if (g_rawRecorder.Recording()) {
+                    ImGui::PushStyleColor(ImGuiCol_Button, (ImVec4)ImColor::HSV(0.0f, 0.6f, 0.6f));
+                    if (ImGui::Button(u8"記録終了")) {
+                        g_rawRecorder.Stop();
+                        MacroAction recorded = g_rawRecorder.TakeAction();
+                        if (!recorded.rawEvents.empty()) new_actions.push_back(std::move(recorded));
+                    }
+                    ImGui::PopStyleColor();
+                    ImGui::SameLine();
+                    if (ImGui::Button(u8"キャンセル##RawRec")) {
+                        g_rawRecorder.Stop();
+                        g_rawRecorder.TakeAction();
+                    }
+                    ImGui::SameLine();
+                    ImGui::Text(u8"キー操作を記録中... %d 操作 / %.1f 秒", (int)g_rawRecorder.Events().size(),
+                                g_rawRecorder.DurationMs() / 1000.0);
+                    if (g_rawRecorder.Dropped() > 0) {
+                        ImGui::TextColored(ImVec4(1, 0.4f, 0.4f, 1), u8"取りこぼし: %llu", (unsigned long long)g_rawRecorder.Dropped());
+                    }
+                } else if (is_rec_combo) {
                     ImGui::PushStyleColor(ImGuiCol_Button, (ImVec4)ImColor::HSV(0.0f, 0.6f, 0.6f));
                     if (ImGui::Button(u8"コンボ確定")) { 
                         if (!temp_combo_keys.empty()) {
@@ -887,19 +908,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                     ImGui::Text(u8"現在の組み合わせ: %s", nDisp.empty() ? u8"(なし)" : nDisp.c_str());
                     // for(auto k : temp_combo_keys) ImGui::SameLine(), ImGui::Text("%s", VkCodeToString(k).c_str());
 
-                    for (int k = 8; k < 240; k++) { // コンボ記録処理
-                        if (GetAsyncKeyState(k) & 0x8001 && k != VK_LBUTTON && k != VK_RBUTTON) {
-                            WORD nmK = (WORD)k;
-                            if (k==VK_LCONTROL||k==VK_RCONTROL) nmK=VK_CONTROL;
-                            if (k==VK_LSHIFT||k==VK_RSHIFT) nmK=VK_SHIFT;
-                            if (k==VK_LMENU||k==VK_RMENU) nmK=VK_MENU;
-                            if (std::find(temp_combo_keys.begin(), temp_combo_keys.end(), nmK) == temp_combo_keys.end()) temp_combo_keys.push_back(nmK);
-                        }
-                    }
+                    // フックから届いたキー押下を取り込む
+                    g_keyCapture.DrainInto(temp_combo_keys);
                 } else {
                     if (ImGui::Button(u8"＋ 同時押し")) { 
                         is_rec_combo = true; temp_combo_keys.clear(); 
-                        is_recording_hotkey = false; 
+                        is_recording_hotkey = false; is_recording_sequence = false;
                     }
                     ImGui::SameLine(); 
                     if (ImGui::Button(u8"＋ テキスト")) { 
@@ -911,6 +925,18 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                         request_wait_popup = true;
                         // ImGui::OpenPopup("AddWaitPopup"); 
                     }
+                    ImGui::SameLine();
+                    if (ImGui::Button(u8"＋ レイヤー切替")) {
+                        request_layer_popup = true;
+                        temp_layer_buf[0] = '\0';
+                        temp_layer_mode = 0;
+                    }
+                    ImGui::SameLine();
+                    if (ImGui::Button(u8"＋ キー操作を記録")) {
+                        // 記録中はフックがキーをそのまま通し、マクロも発動しない
+                        g_rawRecorder.Start();
+                        is_recording_hotkey = false; is_recording_sequence = false;
+                    }
                     ImGui::SameLine(); 
                     if (ImGui::Button(u8"クリア##ClearActionList")) new_actions.clear();
                 }
@@ -970,16 +996,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                     }
                     ImGui::SameLine(); 
                     ImGui::Text(u8"キー入力中...");
-                    // 特殊タブ用の記録ループ
-                    for (int k = 8; k < 240; k++) {
-                        if (GetAsyncKeyState(k) & 0x8001 && k != VK_LBUTTON && k != VK_RBUTTON) {
-                            WORD nmK = (WORD)k;
-                            if (k==VK_LCONTROL||k==VK_RCONTROL) nmK=VK_CONTROL;
-                            if (k==VK_LSHIFT||k==VK_RSHIFT) nmK=VK_SHIFT;
-                            if (k==VK_LMENU||k==VK_RMENU) nmK=VK_MENU;
-                            if (std::find(sp_new_hotkeys.begin(), sp_new_hotkeys.end(), nmK) == sp_new_hotkeys.end()) sp_new_hotkeys.push_back(nmK);
-                        }
-                    }
+                    // フックから届いたキー押下を取り込む
+                    g_keyCapture.DrainInto(sp_new_hotkeys);
                 } else {
                     if (ImGui::Button(u8"＋ 組み合わせキーを追加")) { 
                         // 特殊キー未選択ならクリアしてから開始
@@ -989,6 +1007,23 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                     ImGui::SameLine(); if (ImGui::Button(u8"クリア##ClearHotkey")) { sp_new_hotkeys.clear(); selected_sp_hotkey_idx = 0; }
                 }
 
+                // --- デュアルロール（短く押すと②の実行内容、押し続けると修飾キー） ---
+                ImGui::Checkbox(u8"タップとホールドで使い分ける##DualRole", &sp_dual_role);
+                if (sp_dual_role) {
+                    ImGui::SameLine();
+                    ImGui::SetNextItemWidth(100);
+                    ImGui::Combo(u8"押し続けたとき##HoldKey", &sp_hold_key_idx, [](void* data, int idx, const char** out_text) {
+                        auto* items = (std::vector<SpKeyDef>*)data; *out_text = (*items)[idx].name; return true;
+                    }, (void*)&hold_keys, (int)hold_keys.size());
+                    ImGui::SetNextItemWidth(100);
+                    ImGui::InputInt(u8"タップとみなす時間 ms##TapTimeout", &sp_tap_timeout_ms, 10);
+                    if (sp_tap_timeout_ms < 50) sp_tap_timeout_ms = 50;
+                    if (sp_tap_timeout_ms > 2000) sp_tap_timeout_ms = 2000;
+                    ImGui::SameLine();
+                    ImGui::Checkbox(u8"他のキーを押して離したらホールド##Permissive", &sp_permissive_hold);
+                    if (sp_new_hotkeys.size() != 1) ImGui::TextColored(ImVec4(1, 0.5f, 0.5f, 1), u8"※ 起動キーは1つだけにしてください");
+                }
+
                 ImGui::Separator();
                 ImGui::Text(u8"② 実行内容");
 
@@ -1041,16 +1076,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                             nDisp.erase(nDisp.size() - suffix_sp.size());
                         ImGui::Text(u8"現在の組み合わせ: %s", nDisp.empty() ? u8"(なし)" : nDisp.c_str());
                         
-                        // コンボ記録処理
-                        for (int k = 8; k < 240; k++) {
-                            if (GetAsyncKeyState(k) & 0x8001 && k != VK_LBUTTON && k != VK_RBUTTON) {
-                                WORD nmK = (WORD)k;
-                                if (k==VK_LCONTROL||k==VK_RCONTROL) nmK=VK_CONTROL;
-                                if (k==VK_LSHIFT||k==VK_RSHIFT) nmK=VK_SHIFT;
-                                if (k==VK_LMENU||k==VK_RMENU) nmK=VK_MENU;
-                                if (std::find(sp_temp_combo_keys.begin(), sp_temp_combo_keys.end(), nmK) == sp_temp_combo_keys.end()) sp_temp_combo_keys.push_back(nmK);
-                            }
-                        }
+                        // フックから届いたキー押下を取り込む
+                        g_keyCapture.DrainInto(sp_temp_combo_keys);
                     } else {
                         if (ImGui::Button(u8"＋ 同時押し")) { sp_is_rec_combo = true; sp_temp_combo_keys.clear(); sp_is_recording_hotkey = false; }
                         ImGui::SameLine(); 
@@ -1070,6 +1097,70 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
                 ImGui::EndTabItem();
             }
+
+            // =================================================================================
+            // タブ3: 診断 (フック・マクロ実行の計測結果)
+            // =================================================================================
+            if (ImGui::BeginTabItem(u8"診断")) {
+                diagnosticsOpen = true;
+                const NamedHistogram histograms[] = {
+                    { "hook_time", &g_hookTime },
+                    { "trigger_to_first_send", &g_executor.TriggerLatency() },
+                    { "macro_run_time", &g_executor.RunTimes() },
+                    { "wait_lateness", &g_executor.TimingErrors() },
+                };
+                static const char* const labels[] = {
+                    u8"フック処理時間", u8"発動→最初の送信", u8"マクロ実行時間", u8"待機の遅れ"
+                };
+
+                ImGui::Text(u8"単位: µs（フック処理時間は OS の制限時間 既定 1000ms 以内である必要があります）");
+                if (ImGui::BeginTable("Histograms", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                    ImGui::TableSetupColumn(u8"項目");
+                    ImGui::TableSetupColumn(u8"回数");
+                    ImGui::TableSetupColumn(u8"平均");
+                    ImGui::TableSetupColumn("p50");
+                    ImGui::TableSetupColumn("p99");
+                    ImGui::TableSetupColumn(u8"最大");
+                    ImGui::TableHeadersRow();
+                    for (int i = 0; i < 4; i++) {
+                        const LatencyHistogram& h = *histograms[i].histogram;
+                        ImGui::TableNextRow();
+                        ImGui::TableNextColumn(); ImGui::TextUnformatted(labels[i]);
+                        ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)h.Count());
+                        ImGui::TableNextColumn(); ImGui::Text("%.1f", h.Mean());
+                        ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)h.Percentile(50));
+                        ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)h.Percentile(99));
+                        ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)h.Max());
+                    }
+                    ImGui::EndTable();
+                }
+
+                MacroExecutor::Stats stats = g_executor.GetStats();
+                ImGui::Text(u8"実行: 完了 %llu / 実行中 %llu / 待ち %llu / 無視 %llu / 中断 %llu / 満杯で破棄 %llu",
+                            (unsigned long long)stats.completed, (unsigned long long)stats.running,
+                            (unsigned long long)stats.queued, (unsigned long long)stats.ignored,
+                            (unsigned long long)stats.restarted, (unsigned long long)stats.dropped);
+                ImGui::Text(u8"ログ: バッファ満杯で破棄 %llu", (unsigned long long)g_eventLog.Dropped());
+                ImGui::Text(u8"描画したフレーム数: %llu", (unsigned long long)g_renderedFrames);
+
+                if (ImGui::Button(u8"CSVに書き出す (diagnostics.csv に追記)")) {
+                    AppendHistogramCsv("diagnostics.csv", histograms, 4);
+                }
+                ImGui::SameLine();
+                if (ImGui::Button(u8"計測をリセット")) {
+                    g_hookTime.Reset();
+                    g_executor.ResetHistograms();
+                }
+
+                // 直近のログ (macros.log と同じ内容)
+                ImGui::Separator();
+                ImGui::Text(u8"最近のログ");
+                ImGui::BeginChild("RecentLog", ImVec2(0, 150), true);
+                for (const auto& line : g_logWriter.RecentLines()) ImGui::TextUnformatted(line.c_str());
+                ImGui::EndChild();
+
+                ImGui::EndTabItem();
+            }
             ImGui::EndTabBar();
 
             ImGui::Separator(); // 区切り線
@@ -1089,7 +1180,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                 }
                 ImGui::SameLine();
 
-                if (ImGui::Button(u8"✎")) { // 編集機能
+                // 記録したキー操作は編集できない（削除して記録し直す）
+                const bool editable = active_actions[i].type != ACTION_RAW;
+                if (!editable) ImGui::BeginDisabled();
+                bool edit_clicked = ImGui::Button(u8"✎");
+                if (!editable) ImGui::EndDisabled();
+                if (edit_clicked) { // 編集機能
                     auto target = active_actions[i];
                     if (target.type == ACTION_COMBO) { 
                         is_rec_combo = true; 
@@ -1105,6 +1201,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                         temp_wait_ms = target.waitMs; 
                         request_wait_popup = true; // 合図
                     }
+                    // レイヤー切り替え用
+                    else if (target.type == ACTION_LAYER_TOGGLE || target.type == ACTION_LAYER_HOLD) {
+                        strncpy_s(temp_layer_buf, target.text.c_str(), sizeof(temp_layer_buf) - 1);
+                        temp_layer_mode = target.type == ACTION_LAYER_HOLD ? 1 : 0;
+                        request_layer_popup = true; // 合図
+                    }
                     active_actions.erase(active_actions.begin() + i); 
                     i--; 
                     ImGui::PopID(); 
@@ -1125,29 +1227,85 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
                     label += "[キー] "; for (auto k : active_actions[i].comboKeys) label += VkCodeToString(k) + "+";
                     if (label.back() == '+') label.pop_back();
                 } else if (active_actions[i].type == ACTION_TEXT) label += "[文字] " + active_actions[i].text;
+                else if (active_actions[i].type == ACTION_RAW) label += "[記録] " + DescribeRawAction(active_actions[i]);
+                else if (active_actions[i].type == ACTION_LAYER_TOGGLE || active_actions[i].type == ACTION_LAYER_HOLD) {
+                    label += "[レイヤー] " + DescribeLayerAction(active_actions[i]);
+                }
                 else label += "[待機] " + std::to_string(active_actions[i].waitMs) + " ms";
                 ImGui::Text("%s", label.c_str());
                 ImGui::PopID();
             }
             ImGui::EndChild();
 
+            // --- 実行中の再発動・押しっぱなしの扱い ---
+            static const char* concurrency_names[] = { u8"実行中は無視", u8"1回だけ予約", u8"中断して再実行", u8"並列に実行" };
+            ImGui::SetNextItemWidth(140);
+            ImGui::Combo(u8"再発動時##Concurrency", &new_concurrency, concurrency_names, IM_ARRAYSIZE(concurrency_names));
+            ImGui::SameLine();
+            ImGui::Checkbox(u8"長押しで連続実行", &new_allow_repeat);
+            ImGui::SetNextItemWidth(80);
+            ImGui::InputInt(u8"押下時間(ms)", &new_hold_ms, 0);
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(80);
+            ImGui::InputInt(u8"キー間隔(ms)", &new_inter_key_ms, 0);
+            if (new_hold_ms < 0) new_hold_ms = 0;
+            if (new_inter_key_ms < 0) new_inter_key_ms = 0;
+            ImGui::SetNextItemWidth(140);
+            ImGui::InputText(u8"レイヤー##MacroLayer", new_layer_buf, sizeof(new_layer_buf));
+            ImGui::SameLine();
+            ImGui::TextDisabled(u8"空欄なら常に有効。名前を入れると、そのレイヤーが有効な間だけ発動します");
+
             // --- 共通の保存ボタン (一番下に配置) ---
             std::string saveBtnLabel = is_editing_mode ? u8"更新 (上書き)" : u8"この設定で新規追加";
             if (ImGui::Button(saveBtnLabel.c_str(), ImVec2(-1, 40))) {
-                // 今のタブに応じた hotkeys と actions が入っているかチェック
-                if (!active_hotkeys.empty() && !active_actions.empty()) {
+                // 今のタブに応じた hotkeys (または基本タブのホットストリング・キー列) と actions が入っているかチェック
+                std::string active_hotstring = current_tab == 0 ? std::string(new_hotstring_buf) : std::string();
+                std::vector<WORD> active_sequence = current_tab == 0 ? new_sequence : std::vector<WORD>();
+                // デュアルロールは特殊タブで起動キーが1つのときだけ
+                WORD active_hold_key = (current_tab == 1 && sp_dual_role && active_hotkeys.size() == 1) ? hold_keys[sp_hold_key_idx].code : 0;
+                if ((!active_hotkeys.empty() || !active_hotstring.empty() || !active_sequence.empty()) && !active_actions.empty()) {
                     if (is_editing_mode && editing_macro_index != -1) {
                         global_macros[editing_macro_index].hotkeys = active_hotkeys;
+                        global_macros[editing_macro_index].hotstring = active_hotstring;
+                        global_macros[editing_macro_index].sequence = active_sequence;
+                        global_macros[editing_macro_index].sequenceTimeoutMs = new_sequence_timeout_ms;
+                        // 基本タブで編集したときはデュアルロールの設定をそのまま残す
+                        if (current_tab == 1) {
+                            global_macros[editing_macro_index].holdKey = active_hold_key;
+                            global_macros[editing_macro_index].tapTimeoutMs = sp_tap_timeout_ms;
+                            global_macros[editing_macro_index].permissiveHold = sp_permissive_hold;
+                        }
                         global_macros[editing_macro_index].actions = active_actions;
+                        global_macros[editing_macro_index].concurrency = (MacroConcurrency)new_concurrency;
+                        global_macros[editing_macro_index].allowAutoRepeat = new_allow_repeat;
+                        global_macros[editing_macro_index].holdMs = new_hold_ms;
+                        global_macros[editing_macro_index].interKeyMs = new_inter_key_ms;
+                        global_macros[editing_macro_index].layer = NormalizeLayerName(new_layer_buf);
                     } else {
                         Macro m;
                         m.hotkeys = active_hotkeys;
+                        m.hotstring = active_hotstring;
+                        m.sequence = active_sequence;
+                        m.sequenceTimeoutMs = new_sequence_timeout_ms;
+                        m.holdKey = active_hold_key;
+                        m.tapTimeoutMs = sp_tap_timeout_ms;
+                        m.permissiveHold = sp_permissive_hold;
                         m.actions = active_actions;
+                        m.concurrency = (MacroConcurrency)new_concurrency;
+                        m.allowAutoRepeat = new_allow_repeat;
+                        m.holdMs = new_hold_ms;
+                        m.interKeyMs = new_inter_key_ms;
+                        m.layer = NormalizeLayerName(new_layer_buf);
                         global_macros.push_back(m);
                     }
+                    RebuildMacroTable();
                     // 保存後はすべてクリア
-                    new_hotkeys.clear(); new_actions.clear();
+                    new_hotkeys.clear(); new_actions.clear(); new_hotstring_buf[0] = '\0';
+                    new_sequence.clear(); is_recording_sequence = false; new_sequence_timeout_ms = 1000;
                     sp_new_hotkeys.clear(); sp_new_actions.clear();
+                    sp_dual_role = false; sp_hold_key_idx = 0; sp_tap_timeout_ms = 200; sp_permissive_hold = true;
+                    new_concurrency = CONCURRENCY_DROP; new_allow_repeat = false;
+                    new_hold_ms = 10; new_inter_key_ms = 0; new_layer_buf[0] = '\0';
                     is_editing_mode = false; editing_macro_index = -1;
                     selected_sp_hotkey_idx = 0;
                 }
@@ -1160,6 +1318,26 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         } else {
             ImGui::TextColored(ImVec4(1.0f, 0.0f, 0.0f, 1.0f), u8"○ [停止中] - Ctrl+F12で再開");
         }
+        // 有効なレイヤー（フックが切り替えたものを読むだけ）
+        // フックが引くのは一番上のレイヤーだけなので、その下に積まれているものは分けて表示する
+        const LayerStack active_layers = g_layers.Current();
+        if (active_layers.count > 0) {
+            const int effective = EffectiveLayerIndex(g_macroList, active_layers);
+            std::string hidden;
+            for (uint32_t l = active_layers.count; l-- > 0;) {
+                for (size_t i = 1; i < g_macroList.layers.size(); i++) {
+                    if ((int)i == effective || LayerId(g_macroList.layers[i]) != active_layers.ids[l]) continue;
+                    if (!hidden.empty()) hidden += ", ";
+                    hidden += g_macroList.layers[i];
+                }
+            }
+            ImGui::SameLine();
+            ImGui::Text(u8"レイヤー: %s", effective > 0 ? g_macroList.layers[effective].c_str() : u8"(一覧に無いレイヤー)");
+            if (!hidden.empty()) {
+                ImGui::SameLine();
+                ImGui::TextDisabled(u8"(優先されていない: %s)", hidden.c_str());
+            }
+        }
         ImGui::Separator();
 
         // この定義がポップアップより上に書いてあることを確認してください
@@ -1176,6 +1354,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
             ImGui::OpenPopup("AddWaitPopup");
             request_wait_popup = false;
         }
+        if (request_layer_popup) {
+            ImGui::OpenPopup("AddLayerPopup");
+            request_layer_popup = false;
+        }
         
         // --- 共通: ポップアップ処理 ---
         if (ImGui::BeginPopup("AddTextPopup")) {
@@ -1195,9 +1377,26 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
             }
             ImGui::EndPopup();
         }
+        if (ImGui::BeginPopup("AddLayerPopup")) {
+            ImGui::InputText(u8"レイヤー名##LayerName", temp_layer_buf, sizeof(temp_layer_buf));
+            ImGui::RadioButton(u8"押すたびに有効/無効", &temp_layer_mode, 0);
+            ImGui::SameLine();
+            ImGui::RadioButton(u8"押している間だけ有効", &temp_layer_mode, 1);
+            // 空白だけの名前は基本レイヤーになってしまうので追加しない
+            std::string layer_name = NormalizeLayerName(temp_layer_buf);
+            if (ImGui::Button(u8"追加") && !layer_name.empty()) {
+                active_actions.push_back({ temp_layer_mode == 1 ? ACTION_LAYER_HOLD : ACTION_LAYER_TOGGLE, {}, layer_name, 0 });
+                ImGui::CloseCurrentPopup();
+            }
+            ImGui::EndPopup();
+        }
         
         if (is_editing_mode && ImGui::Button(u8"編集をキャンセル", ImVec2(-1, 40))) {
-            new_hotkeys.clear(); new_actions.clear();
+            new_hotkeys.clear(); new_actions.clear(); new_hotstring_buf[0] = '\0';
+            new_sequence.clear(); is_recording_sequence = false; new_sequence_timeout_ms = 1000;
+            sp_dual_role = false; sp_hold_key_idx = 0; sp_tap_timeout_ms = 200; sp_permissive_hold = true;
+            new_concurrency = CONCURRENCY_DROP; new_allow_repeat = false;
+            new_hold_ms = 10; new_inter_key_ms = 0; new_layer_buf[0] = '\0';
             is_editing_mode = false; editing_macro_index = -1;
         }
 
@@ -1205,52 +1404,56 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
         // --- 保存ボタン ---
         if (ImGui::Button(u8"変更をファイルに保存")) {
-            SaveMacrosToFile("macros.txt");
+            // 書き込みは保存用のスレッドが行う（ここでは待たない）
+            g_saver.SaveSoon();
         }
+        ImGui::SameLine();
+        ImGui::TextDisabled(g_saver.IsDirty() ? u8"未保存の変更あり（自動保存待ち）" : u8"保存済み");
 
         ImGui::Text(u8"【登録済みショートカット一覧】");
 
-        for (int i = 0; i < global_macros.size(); i++) {
-            ImGui::PushID(i);
-            if (ImGui::Button(u8"削除")) { 
-                global_macros.erase(global_macros.begin() + i); 
-                i--; ImGui::PopID(); continue; 
+        MacroListClicks clicks = DrawMacroList(g_macroList, global_macros, g_layers.Current());
+        if (clicks.editIndex >= 0) {
+            // 現在のデータを入力エリアにコピーする
+            const int i = clicks.editIndex;
+            new_hotkeys = global_macros[i].hotkeys;
+            strncpy_s(new_hotstring_buf, global_macros[i].hotstring.c_str(), sizeof(new_hotstring_buf) - 1);
+            new_sequence = global_macros[i].sequence;
+            new_sequence_timeout_ms = global_macros[i].sequenceTimeoutMs;
+            // デュアルロールキーは特殊タブでも編集できるようにする
+            sp_dual_role = global_macros[i].holdKey != 0;
+            sp_tap_timeout_ms = global_macros[i].tapTimeoutMs;
+            sp_permissive_hold = global_macros[i].permissiveHold;
+            sp_hold_key_idx = 0;
+            for (int h = 0; h < (int)hold_keys.size(); h++) {
+                if (hold_keys[h].code == global_macros[i].holdKey) sp_hold_key_idx = h;
             }
-            ImGui::SameLine();
-
-            // 編集ボタンを追加
-            if (ImGui::Button(u8"編集")) {
-                // 現在のデータを入力エリアにコピーする
-                new_hotkeys = global_macros[i].hotkeys;
-                new_actions = global_macros[i].actions;
-                
-                // モードを「編集」に切り替える
-                is_editing_mode = true;
-                editing_macro_index = i;
-                
-                // 画面の上（作成エリア）へ意識が向くようにスクロールさせることも可能
-                ImGui::SetScrollHereY(0.0f); 
+            if (sp_dual_role) {
+                sp_new_hotkeys = global_macros[i].hotkeys;
+                sp_new_actions = global_macros[i].actions;
             }
-            ImGui::SameLine();
-            
-            std::string hkStr = "";
-            for (auto k : global_macros[i].hotkeys) hkStr += VkCodeToString(k) + "+";
-            if (!hkStr.empty()) hkStr.pop_back();
-            
-            if (ImGui::CollapsingHeader((u8"起動: " + hkStr).c_str())) {
-                for (const auto& act : global_macros[i].actions) {
-                    if (act.type == ACTION_COMBO) {
-                        std::string keys = ""; for(auto k: act.comboKeys) keys += VkCodeToString(k) + "+";
-                        if(!keys.empty()) keys.pop_back();
-                        ImGui::BulletText(u8"キー: %s", keys.c_str());
-                    } else if (act.type == ACTION_TEXT) {
-                        ImGui::BulletText(u8"文字: %s", act.text.c_str());
-                    } else {
-                        ImGui::BulletText(u8"待機: %d ms", act.waitMs);
-                    }
-                }
+            new_actions = global_macros[i].actions;
+            new_concurrency = global_macros[i].concurrency;
+            new_allow_repeat = global_macros[i].allowAutoRepeat;
+            new_hold_ms = global_macros[i].holdMs;
+            new_inter_key_ms = global_macros[i].interKeyMs;
+            strncpy_s(new_layer_buf, global_macros[i].layer.c_str(), sizeof(new_layer_buf) - 1);
+
+            // モードを「編集」に切り替える
+            is_editing_mode = true;
+            editing_macro_index = i;
+        }
+
+        const int delete_index = clicks.deleteIndex;
+        if (delete_index >= 0) {
+            global_macros.erase(global_macros.begin() + delete_index);
+            EraseMacroListEntry(g_macroList, delete_index);
+            // 編集中のマクロより前を消したら添字をずらす
+            if (is_editing_mode && editing_macro_index != -1) {
+                if (editing_macro_index == delete_index) { is_editing_mode = false; editing_macro_index = -1; }
+                else if (editing_macro_index > delete_index) editing_macro_index--;
             }
-            ImGui::PopID(); // PushIDに対応するPopID
+            RebuildMacroTable();
         }
 
         ImGui::End();
@@ -1271,6 +1474,9 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
 
     // --- 3. 終了処理 ---
     UnHook(); 
+    g_executor.Stop();
+    g_saver.Stop(); // 未保存の変更があればここで書き出す
+    g_logWriter.Stop();
     ImGui_ImplDX11_Shutdown();
     ImGui_ImplWin32_Shutdown();
     ImGui::DestroyContext();
@@ -0,0 +1,22 @@
+#pragma once
+
+// 眠らずに時刻だけ進める時計（待機を含むマクロを一瞬で実行するテスト・計測用）
+
+#include <atomic>
+
+#include "engine/macro_clock.h"
+
+class FakeMacroClock : public IMacroClock {
+public:
+    FakeMacroClock() : now_(1000000000) {}
+
+    int64_t NowNs() override { return now_.load(); }
+    void SleepUntil(int64_t deadlineNs) override {
+        int64_t now = now_.load();
+        while (now < deadlineNs && !now_.compare_exchange_weak(now, deadlineNs)) {}
+    }
+    void Advance(int64_t ns) { now_.fetch_add(ns); }
+
+private:
+    std::atomic<int64_t> now_;
+};
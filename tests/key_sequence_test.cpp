@@ -0,0 +1,132 @@
+// キー列（リーダーキー）の照合
+// 一致したときの発動、一致しなかったときの送り直し、マクロ表が差し替わったときの扱いを確かめる。
+
+#include <vector>
+
+#include "engine/key_sequence.h"
+#include "engine/macro_table.h"
+#include "tests/test_util.h"
+
+static const int64_t kMs = 1000000;
+
+static Macro MakeSequenceMacro(std::vector<VkCode> sequence) {
+    Macro m;
+    m.sequence = sequence;
+    m.sequenceTimeoutMs = 500;
+    m.actions.push_back({ ACTION_TEXT, {}, "x", 0 });
+    return m;
+}
+
+static bool IsKey(const InputEvent& ev, VkCode vk, bool down) {
+    return ev.code == vk && ev.type == (down ? EVENT_KEY_DOWN : EVENT_KEY_UP);
+}
+
+static void TestFireAndReplay() {
+    std::vector<Macro> macros;
+    macros.push_back(MakeSequenceMacro({ VKC_NONCONVERT, 'J', 'K' }));
+    std::unique_ptr<MacroTable> table = BuildMacroTable(macros);
+    const DispatchTable& d = *table->layers[0];
+
+    KeySequenceTracker tracker;
+    KeySequenceOutput out;
+    CHECK(tracker.OnKeyDown(d.sequences, d.generation, VKC_NONCONVERT, false, 0, out));
+    CHECK(tracker.OnKeyUp(VKC_NONCONVERT));
+    CHECK(tracker.OnKeyDown(d.sequences, d.generation, 'J', false, 10 * kMs, out));
+    CHECK(tracker.OnKeyDown(d.sequences, d.generation, 'K', false, 20 * kMs, out));
+    CHECK_EQ(out.fireMacro, 0);
+    CHECK(!tracker.Pending());
+
+    // 続きが一致しなければ、止めていたキーと今のキーを順に送り直す
+    CHECK(tracker.OnKeyDown(d.sequences, d.generation, VKC_NONCONVERT, false, 100 * kMs, out));
+    CHECK(tracker.OnKeyDown(d.sequences, d.generation, 'X', false, 110 * kMs, out));
+    CHECK_EQ(out.fireMacro, -1);
+    CHECK_EQ(out.replayCount, 2u);
+    if (out.replayCount == 2) {
+        CHECK(IsKey(out.replay[0], VKC_NONCONVERT, true));
+        CHECK(IsKey(out.replay[1], 'X', true));
+    }
+}
+
+// 差し替え後の表が前の表と同じアドレスに作られても、通し番号で差し替えに気付く
+static void TestTableSwapAtSameAddress() {
+    std::vector<Macro> first;
+    first.push_back(MakeSequenceMacro({ 'A', 'B' }));
+    std::vector<Macro> second;
+    second.push_back(MakeSequenceMacro({ 'C', 'D' }));
+    second.push_back(MakeSequenceMacro({ 'A', 'B' }));
+
+    std::unique_ptr<MacroTable> table = BuildMacroTable(first);
+    DispatchTable& d = *table->layers[0];
+    KeySequenceTracker tracker;
+    KeySequenceOutput out;
+    CHECK(tracker.OnKeyDown(d.sequences, d.generation, 'A', false, 0, out));
+    CHECK(tracker.Pending());
+
+    // 同じ DispatchTable を作り直す（解放された表のアドレスに次の表が置かれたのと同じ状況）
+    std::unique_ptr<MacroTable> next = BuildMacroTable(second);
+    uint64_t oldGeneration = d.generation;
+    d.sequences = next->layers[0]->sequences;
+    d.generation = next->layers[0]->generation;
+    CHECK(d.generation != oldGeneration);
+
+    // 古い表で途中まで一致した A は送り直し、古いマクロ番号では発動しない
+    CHECK(tracker.OnKeyDown(d.sequences, d.generation, 'B', false, 10 * kMs, out));
+    CHECK_EQ(out.fireMacro, -1);
+    CHECK(out.replayCount >= 2);
+    if (out.replayCount >= 2) {
+        CHECK(IsKey(out.replay[0], 'A', true));
+        CHECK(IsKey(out.replay[out.replayCount - 1], 'B', true));
+    }
+}
+
+// 状態を作るたびに遷移表が伸びる（作り直しで移動する）ので、多数のキー列でも正しく引けること
+static void TestManyStates() {
+    std::vector<Macro> macros;
+    for (uint32_t n = 0; n < 300; n++) {
+        macros.push_back(MakeSequenceMacro({ (VkCode)('A' + n % 26), (VkCode)('A' + n / 26 % 26), (VkCode)('0' + n % 10), VKC_F1 }));
+    }
+    KeySequenceTrie trie;
+    trie.Build(macros);
+
+    KeySequenceTracker tracker;
+    KeySequenceOutput out;
+    for (uint32_t n = 0; n < macros.size(); n++) {
+        int64_t t = n * 1000 * kMs;
+        for (size_t i = 0; i < macros[n].sequence.size(); i++) {
+            CHECK(tracker.OnKeyDown(trie, 1, macros[n].sequence[i], false, t + (int64_t)i * kMs, out));
+        }
+        CHECK_EQ(out.fireMacro, (int)n);
+        for (VkCode vk : macros[n].sequence) tracker.OnKeyUp(vk);
+    }
+}
+
+// 範囲外のキーを含むキー列は、途中までの状態も作らない（先頭のキーを止めたり、離す操作を捨てたりしない）
+static void TestOutOfRangeKey() {
+    std::vector<Macro> macros;
+    macros.push_back(MakeSequenceMacro({ 'A', 0x100 }));
+    KeySequenceTrie trie;
+    trie.Build(macros);
+    CHECK(trie.Empty());
+
+    KeySequenceTracker tracker;
+    KeySequenceOutput out;
+    CHECK(!tracker.OnKeyDown(trie, 1, 'A', false, 0, out));
+    CHECK_EQ(out.fireMacro, -1);
+    CHECK(!tracker.Pending());
+    CHECK(!tracker.OnKeyUp('A'));
+
+    // 同じキーで始まる正しいキー列はそのまま働く
+    macros.push_back(MakeSequenceMacro({ 'A', 'B' }));
+    trie.Build(macros);
+    CHECK(tracker.OnKeyDown(trie, 2, 'A', false, 10 * kMs, out));
+    CHECK(tracker.OnKeyDown(trie, 2, 'B', false, 20 * kMs, out));
+    CHECK_EQ(out.fireMacro, 1);
+}
+
+int main() {
+    TestFireAndReplay();
+    TestTableSwapAtSameAddress();
+    TestManyStates();
+    TestOutOfRangeKey();
+    return TestResult();
+}
@@ -0,0 +1,72 @@
+// 変換済みマクロ表のキャッシュ
+// 保存した設定ファイルを読み直した一覧と、同時に書いたキャッシュの一覧が同じになることと、
+// 元ファイルと合わない・壊れたキャッシュを使わないことを確かめる。
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "engine/macro_cache.h"
+#include "engine/macro_file.h"
+#include "engine/macro_table.h"
+#include "tests/test_util.h"
+
+static Macro MakeMacro(std::vector<VkCode> hotkeys, const char* text) {
+    Macro m;
+    m.hotkeys = hotkeys;
+    if (text) m.actions.push_back({ ACTION_TEXT, {}, text, 0 });
+    return m;
+}
+
+// 編集中の一覧には、保存されないマクロ（発動条件や実行内容の無いもの）が混じっていることがある
+static void TestCacheMatchesSavedFile() {
+    std::vector<Macro> macros;
+    macros.push_back(MakeMacro({ 'A' }, "first"));
+    macros.push_back(MakeMacro({}, "no trigger"));
+    macros.push_back(MakeMacro({ 'B' }, nullptr));
+    macros.push_back(MakeMacro({ VKC_CONTROL, 'C' }, "last"));
+    std::unique_ptr<MacroTable> table = BuildMacroTable(macros);
+
+    std::string source = SerializeMacros(macros);
+    MacroCacheKey key = { source.size(), 1, HashMacroSource(source.data(), source.size()) };
+    std::string cache = BuildMacroCache(key, macros, table->macros);
+
+    std::vector<Macro> parsed;
+    ParseMacros(source.data(), source.size(), parsed);
+    std::vector<Macro> cached;
+    std::unique_ptr<MacroTable> cachedTable;
+    CHECK(ReadMacroCache(cache.data(), cache.size(), key, cached, cachedTable));
+    CHECK_EQ(parsed.size(), (size_t)2);
+    CHECK_EQ(cached.size(), parsed.size());
+    for (size_t i = 0; i < cached.size() && i < parsed.size(); i++) {
+        CHECK(cached[i].hotkeys == parsed[i].hotkeys);
+        CHECK(cached[i].actions.size() == 1 && cached[i].actions[0].text == parsed[i].actions[0].text);
+    }
+    if (cachedTable && cachedTable->macros.size() == 2) {
+        CHECK_EQ(cachedTable->macros[1]->id, 1u);
+        CHECK(cachedTable->macros[1]->hotkeys == parsed[1].hotkeys);
+    }
+}
+
+static void TestRejectsStaleCache() {
+    std::vector<Macro> macros;
+    macros.push_back(MakeMacro({ 'A' }, "text"));
+    std::unique_ptr<MacroTable> table = BuildMacroTable(macros);
+    MacroCacheKey key = { 100, 2, 3 };
+    std::string cache = BuildMacroCache(key, macros, table->macros);
+
+    std::vector<Macro> out;
+    std::unique_ptr<MacroTable> outTable;
+    MacroCacheKey other = key;
+    other.sourceHash++;
+    CHECK(!ReadMacroCache(cache.data(), cache.size(), other, out, outTable));
+    CHECK(!ReadMacroCache(cache.data(), cache.size() - 1, key, out, outTable));
+    CHECK(out.empty() && !outTable);
+    CHECK(ReadMacroCache(cache.data(), cache.size(), key, out, outTable));
+}
+
+int main() {
+    TestCacheMatchesSavedFile();
+    TestRejectsStaleCache();
+    return TestResult();
+}
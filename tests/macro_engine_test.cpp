@@ -0,0 +1,144 @@
+// ホットキー判定とマクロ実行を、記録するだけのシンクと自前のキー状態でヘッドレスに確かめる
+
+#include "engine/key_state.h"
+#include "engine/macro_engine.h"
+#include "engine/macro_table.h"
+#include "tests/fake_clock.h"
+#include "tests/test_util.h"
+
+static Macro MakeComboMacro(std::vector<VkCode> hotkeys, std::vector<VkCode> combo) {
+    Macro m;
+    m.hotkeys = hotkeys;
+    m.actions.push_back({ ACTION_COMBO, combo, "", 0 });
+    return m;
+}
+
+static void TestTrigger() {
+    std::vector<Macro> macros;
+    macros.push_back(MakeComboMacro({ VKC_CONTROL, 'A' }, { 'B' }));
+    macros.push_back(MakeComboMacro({ 'A' }, { 'C' }));
+
+    KeyStateBitmap keys;
+    // Ctrl を押さずに A → 2つ目
+    keys.OnKeyEvent('A', true);
+    CHECK(FindTriggeredMacro(macros, 'A', keys) == &macros[1]);
+    keys.OnKeyEvent('A', false);
+
+    // 左 Ctrl を押したまま A → 共通の Ctrl として1つ目
+    keys.OnKeyEvent(VKC_LCONTROL, true);
+    keys.OnKeyEvent('A', true);
+    CHECK(keys.IsKeyDown(VKC_CONTROL));
+    CHECK(FindTriggeredMacro(macros, 'A', keys) == &macros[0]);
+    CHECK(FindTriggeredMacro(macros, 'Z', keys) == nullptr);
+}
+
+static void TestExecuteCombo() {
+    std::vector<MacroAction> actions;
+    actions.push_back({ ACTION_COMBO, { VKC_CONTROL, 'C' }, "", 0 });
+    actions.push_back({ ACTION_WAIT, {}, "", 100 });
+    actions.push_back({ ACTION_TEXT, {}, "a\xE3\x81\x82", 0 }); // "aあ"
+
+    EventStream stream;
+    CompileActions(actions, stream);
+
+    RecordingInputSink sink;
+    KeyStateBitmap keys;
+    FakeMacroClock clock;
+    ExecutionEnv env = { &sink, &keys, &clock, nullptr };
+    int64_t start = clock.NowNs();
+    ExecutionResult result = ExecuteEventStream(stream, env);
+
+    const std::vector<InputEvent>& ev = sink.Events();
+    CHECK_EQ(ev.size(), (size_t)8);
+    CHECK_EQ(result.events, 8u);
+    CHECK(!result.cancelled);
+    if (ev.size() == 8) {
+        CHECK(ev[0].type == EVENT_KEY_DOWN && ev[0].code == VKC_CONTROL);
+        CHECK(ev[1].type == EVENT_KEY_DOWN && ev[1].code == 'C');
+        CHECK(ev[2].type == EVENT_KEY_UP && ev[2].code == VKC_CONTROL);
+        CHECK(ev[3].type == EVENT_KEY_UP && ev[3].code == 'C');
+        CHECK(ev[4].type == EVENT_UNICODE_DOWN && ev[4].code == 'a');
+        CHECK(ev[6].type == EVENT_UNICODE_DOWN && ev[6].code == 0x3042);
+    }
+    // 落ち着くまでの 10ms + 5ms、押しっぱなし 10ms、待機 100ms
+    CHECK_EQ(clock.NowNs() - start, (int64_t)125000000);
+}
+
+static void TestReleaseHeldModifiers() {
+    std::vector<MacroAction> actions;
+    actions.push_back({ ACTION_COMBO, { 'V' }, "", 0 });
+
+    RecordingInputSink sink;
+    KeyStateBitmap keys;
+    keys.OnKeyEvent(VKC_LSHIFT, true);
+    ExecutionResult result = ExecuteMacro(actions, sink, keys);
+
+    // Shift を離してから V を押し、押されたままの Shift を戻す
+    const std::vector<InputEvent>& ev = sink.Events();
+    CHECK(result.submissions >= 3u);
+    size_t vDown = ev.size(), shiftUp = ev.size(), shiftDown = ev.size();
+    for (size_t i = 0; i < ev.size(); i++) {
+        if (ev[i].code == 'V' && ev[i].type == EVENT_KEY_DOWN) vDown = i;
+        if (ev[i].code == VKC_LSHIFT && ev[i].type == EVENT_KEY_UP) shiftUp = i;
+        if (ev[i].code == VKC_LSHIFT && ev[i].type == EVENT_KEY_DOWN) shiftDown = i;
+    }
+    CHECK(shiftUp < vDown);
+    CHECK(vDown < shiftDown && shiftDown < ev.size());
+}
+
+// 1:1 の置き換え (KeyRemapTable) にするのは、起動キーを他のマクロが使っておらず、実行の指定が既定のときだけ
+static void TestRemapPromotion() {
+    // A → B だけなら置き換え（索引には入らない）
+    std::vector<Macro> macros;
+    macros.push_back(MakeComboMacro({ 'A' }, { 'B' }));
+    std::unique_ptr<MacroTable> table = BuildMacroTable(macros);
+    KeyStateBitmap keys;
+    keys.OnKeyEvent('A', true);
+    CHECK_EQ(table->layers[0]->remap.to['A'], (VkCode)'B');
+    CHECK_EQ(table->layers[0]->index.FindTriggered('A', keys.Snapshot()), -1);
+
+    // A → B と Ctrl+A: 置き換えにすると Ctrl+A が発動しなくなるので、どちらも索引で扱う
+    macros.insert(macros.begin(), MakeComboMacro({ VKC_CONTROL, 'A' }, { 'C' }));
+    table = BuildMacroTable(macros);
+    const DispatchTable& d = *table->layers[0];
+    CHECK(d.remap.Empty());
+    CHECK_EQ(d.index.FindTriggered('A', keys.Snapshot()), 1);
+    keys.OnKeyEvent(VKC_LCONTROL, true);
+    CHECK_EQ(d.index.FindTriggered('A', keys.Snapshot()), 0);
+
+    // レイヤーの A → B も、基本レイヤーの Ctrl+A と同じ表に入るので置き換えにしない
+    macros[1].layer = "nav";
+    table = BuildMacroTable(macros);
+    CHECK_EQ(table->layers.size(), (size_t)2);
+    if (table->layers.size() == 2) CHECK(table->layers[1]->remap.Empty());
+
+    // 既定以外の実行の指定や、ほかの発動条件を持つマクロは置き換えにしない
+    Macro remap = MakeComboMacro({ 'A' }, { 'B' });
+    CHECK_EQ(RemapTarget(remap), (VkCode)'B');
+    Macro m = remap;
+    m.concurrency = CONCURRENCY_QUEUE_ONE;
+    CHECK_EQ(RemapTarget(m), (VkCode)0);
+    m = remap;
+    m.allowAutoRepeat = true;
+    CHECK_EQ(RemapTarget(m), (VkCode)0);
+    m = remap;
+    m.holdMs = 50;
+    CHECK_EQ(RemapTarget(m), (VkCode)0);
+    m = remap;
+    m.interKeyMs = 5;
+    CHECK_EQ(RemapTarget(m), (VkCode)0);
+    m = remap;
+    m.hotstring = "abc";
+    CHECK_EQ(RemapTarget(m), (VkCode)0);
+    m = remap;
+    m.sequence.push_back('J');
+    CHECK_EQ(RemapTarget(m), (VkCode)0);
+}
+
+int main() {
+    TestTrigger();
+    TestExecuteCombo();
+    TestReleaseHeldModifiers();
+    TestRemapPromotion();
+    return TestResult();
+}
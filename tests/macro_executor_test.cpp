@@ -0,0 +1,123 @@
+// 実行方針 (MacroConcurrency) の確認と、中断して再実行 (CONCURRENCY_RESTART) の競合の負荷テスト
+// 眠らない時計で実行をほぼ一瞬にし、発動と実行の終わりが重なる瞬間を何度も作ります。
+
+#include <mutex>
+#include <thread>
+
+#include "engine/key_state.h"
+#include "engine/macro_executor.h"
+#include "tests/fake_clock.h"
+#include "tests/test_util.h"
+
+// 最後に送られたイベントだけを覚えるシンク（実行スレッドから呼ばれる）
+class LastEventSink : public IInputSink {
+public:
+    void Send(const InputEvent* events, size_t count) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (count > 0) last_ = events[count - 1];
+        sent_ += count;
+    }
+    InputEvent Last() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return last_;
+    }
+    size_t Sent() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sent_;
+    }
+
+private:
+    std::mutex mutex_;
+    InputEvent last_ = {};
+    size_t sent_ = 0;
+};
+
+// A を押して離し、待ってから "z" を入力するマクロ（最後まで実行されたら z を離すイベントで終わる）
+static CompiledMacroPtr MakeMacro(MacroConcurrency concurrency) {
+    Macro m;
+    m.hotkeys.push_back('Q');
+    m.actions.push_back({ ACTION_COMBO, { 'A' }, "", 0 });
+    m.actions.push_back({ ACTION_WAIT, {}, "", 50 });
+    m.actions.push_back({ ACTION_TEXT, {}, "z", 0 });
+    m.concurrency = concurrency;
+    return CompileMacro(m, 0);
+}
+
+static void WaitIdle(MacroExecutor& executor, const CompiledMacro& macro) {
+    for (;;) {
+        MacroExecutor::Stats s = executor.GetStats();
+        if (s.queued == 0 && s.running == 0 && macro.runState.pending.load() == 0) return;
+        std::this_thread::yield();
+    }
+}
+
+static bool EndedWithText(LastEventSink& sink) {
+    InputEvent last = sink.Last();
+    return last.type == EVENT_UNICODE_UP && last.code == 'z';
+}
+
+static void TestDropIgnoresWhileRunning() {
+    LastEventSink sink;
+    KeyStateBitmap keys;
+    FakeMacroClock clock;
+    MacroExecutor executor(sink, keys, clock);
+    CompiledMacroPtr macro = MakeMacro(CONCURRENCY_DROP);
+
+    // 実行スレッドを起動する前に積むので、2回目は必ず「実行待ち」と重なる
+    CHECK(executor.Submit(macro));
+    CHECK(!executor.Submit(macro));
+    CHECK(!executor.Submit(macro, true)); // キーリピートは無視
+    executor.Start(1);
+    WaitIdle(executor, *macro);
+    CHECK_EQ(macro->runState.runs.load(), (uint64_t)1);
+    CHECK_EQ(executor.GetStats().ignored, (uint64_t)2);
+}
+
+static void TestQueueOneRunsTwice() {
+    LastEventSink sink;
+    KeyStateBitmap keys;
+    FakeMacroClock clock;
+    MacroExecutor executor(sink, keys, clock);
+    CompiledMacroPtr macro = MakeMacro(CONCURRENCY_QUEUE_ONE);
+
+    CHECK(executor.Submit(macro));
+    CHECK(executor.Submit(macro));
+    CHECK(!executor.Submit(macro)); // 予約は1回分だけ
+    executor.Start(1);
+    WaitIdle(executor, *macro);
+    CHECK_EQ(macro->runState.runs.load(), (uint64_t)2);
+    CHECK(EndedWithText(sink));
+}
+
+// 再実行を積んだ直後に実行中の回が終わっても、積んだ再実行が中止されずに最後まで実行されること
+static void StressRestart() {
+    LastEventSink sink;
+    KeyStateBitmap keys;
+    FakeMacroClock clock;
+    MacroExecutor executor(sink, keys, clock);
+    executor.Start(2);
+    CompiledMacroPtr macro = MakeMacro(CONCURRENCY_RESTART);
+
+    const int kRounds = 20000;
+    int lost = 0;
+    for (int round = 0; round < kRounds; round++) {
+        // 1～4 回続けて発動し、間を少しずつずらして実行の終わりと重ねる
+        int burst = 1 + round % 4;
+        for (int i = 0; i < burst; i++) {
+            CHECK(executor.Submit(macro));
+            for (int spin = 0; spin < (round * 7 + i) % 64; spin++) std::this_thread::yield();
+        }
+        WaitIdle(executor, *macro);
+        if (!EndedWithText(sink)) lost++;
+    }
+    executor.Stop();
+    CHECK_EQ(lost, 0);
+    CHECK(macro->runState.runs.load() >= (uint64_t)kRounds);
+}
+
+int main() {
+    TestDropIgnoresWhileRunning();
+    TestQueueOneRunsTwice();
+    StressRestart();
+    return TestResult();
+}
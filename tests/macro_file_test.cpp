@@ -0,0 +1,261 @@
+// 設定ファイル (v1 / v2) の読み書き
+// 乱数で作ったマクロ一覧を SerializeMacros → ParseMacros で往復させて元と一致することと、
+// 壊れた・途中で切れた内容を読んでも落ちないことを確かめる。
+
+#include <string>
+#include <vector>
+
+#include "engine/macro_file.h"
+#include "engine/macro_layers.h"
+#include "tests/test_util.h"
+
+// 決まった種から作る乱数（失敗したときに同じ入力を再現できるように）
+class TestRandom {
+public:
+    explicit TestRandom(uint64_t seed) : state_(seed ? seed : 1) {}
+    uint32_t Below(uint32_t n) {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 7;
+        state_ ^= state_ << 17;
+        return (uint32_t)(state_ % n);
+    }
+
+private:
+    uint64_t state_;
+};
+
+static VkCode RandomKey(TestRandom& rng) { return (VkCode)(1 + rng.Below(254)); }
+
+// 任意のバイト列（改行・カンマ・NUL・不正な UTF-8 を含む）
+static std::string RandomBytes(TestRandom& rng, size_t maxLength) {
+    static const char special[] = { '\n', '\r', ',', ':', ' ', '\0', '#' };
+    std::string s(rng.Below((uint32_t)maxLength + 1), ' ');
+    for (char& c : s) c = rng.Below(4) == 0 ? special[rng.Below(sizeof(special))] : (char)rng.Below(256);
+    return s;
+}
+
+// 前後に空白が無く、改行を含まない名前（レイヤー名）
+static std::string RandomName(TestRandom& rng) {
+    static const char* names[] = { "編集", "nav", "a b", "Fn-2", "数字" };
+    return names[rng.Below(5)];
+}
+
+static Macro RandomMacro(TestRandom& rng) {
+    Macro m;
+    // 発動条件は少なくとも1つ
+    do {
+        m.hotkeys.clear();
+        m.hotstring.clear();
+        m.sequence.clear();
+        if (rng.Below(4) != 0) {
+            for (uint32_t i = 1 + rng.Below(3); i > 0; i--) m.hotkeys.push_back(RandomKey(rng));
+        }
+        if (rng.Below(4) == 0) m.hotstring = RandomBytes(rng, 12);
+        if (rng.Below(4) == 0) {
+            for (uint32_t i = 1 + rng.Below(4); i > 0; i--) m.sequence.push_back(RandomKey(rng));
+            m.sequenceTimeoutMs = 1 + (int)rng.Below(5000);
+        }
+    } while (m.hotkeys.empty() && m.hotstring.empty() && m.sequence.empty());
+    if (m.hotkeys.size() == 1 && rng.Below(4) == 0) {
+        m.holdKey = RandomKey(rng);
+        m.tapTimeoutMs = 1 + (int)rng.Below(1000);
+        m.permissiveHold = rng.Below(2) == 0;
+    }
+    if (rng.Below(3) == 0) m.layer = RandomName(rng);
+    m.concurrency = (MacroConcurrency)rng.Below(4);
+    m.allowAutoRepeat = rng.Below(2) == 0;
+    m.holdMs = (int)rng.Below(100);
+    m.interKeyMs = (int)rng.Below(3) * 5;
+
+    for (uint32_t n = 1 + rng.Below(6); n > 0; n--) {
+        MacroAction a;
+        a.type = (MacroActionType)rng.Below(6);
+        a.waitMs = 0;
+        switch (a.type) {
+        case ACTION_COMBO:
+            for (uint32_t i = rng.Below(4); i > 0; i--) a.comboKeys.push_back(RandomKey(rng));
+            break;
+        case ACTION_TEXT:
+            a.text = RandomBytes(rng, 40);
+            break;
+        case ACTION_WAIT:
+            a.waitMs = (int)rng.Below(100000);
+            break;
+        case ACTION_RAW:
+            for (uint32_t i = 1 + rng.Below(8); i > 0; i--) {
+                RawKeyEvent ev = { RandomKey(rng), (uint8_t)rng.Below(2), (uint8_t)rng.Below(2), rng.Below(3) ? 0u : rng.Below(2000) };
+                a.rawEvents.push_back(ev);
+            }
+            break;
+        default:
+            a.text = RandomName(rng);
+            break;
+        }
+        m.actions.push_back(a);
+    }
+    return m;
+}
+
+static bool SameAction(const MacroAction& a, const MacroAction& b) {
+    if (a.type != b.type || a.comboKeys != b.comboKeys || a.text != b.text || a.waitMs != b.waitMs) return false;
+    if (a.rawEvents.size() != b.rawEvents.size()) return false;
+    for (size_t i = 0; i < a.rawEvents.size(); i++) {
+        const RawKeyEvent& x = a.rawEvents[i];
+        const RawKeyEvent& y = b.rawEvents[i];
+        if (x.code != y.code || x.down != y.down || x.extended != y.extended || x.delayMs != y.delayMs) return false;
+    }
+    return true;
+}
+
+static bool SameMacro(const Macro& a, const Macro& b) {
+    if (a.hotkeys != b.hotkeys || a.hotstring != b.hotstring || a.sequence != b.sequence || a.layer != b.layer) return false;
+    if (!a.sequence.empty() && a.sequenceTimeoutMs != b.sequenceTimeoutMs) return false;
+    if (a.holdKey != b.holdKey) return false;
+    if (a.holdKey != 0 && (a.tapTimeoutMs != b.tapTimeoutMs || a.permissiveHold != b.permissiveHold)) return false;
+    if (a.concurrency != b.concurrency || a.allowAutoRepeat != b.allowAutoRepeat) return false;
+    if (a.holdMs != b.holdMs || a.interKeyMs != b.interKeyMs) return false;
+    if (a.actions.size() != b.actions.size()) return false;
+    for (size_t i = 0; i < a.actions.size(); i++) {
+        if (!SameAction(a.actions[i], b.actions[i])) return false;
+    }
+    return true;
+}
+
+static void TestRoundTrip() {
+    for (uint64_t seed = 1; seed <= 2000; seed++) {
+        TestRandom rng(seed);
+        std::vector<Macro> macros(rng.Below(8));
+        for (Macro& m : macros) m = RandomMacro(rng);
+
+        std::string text = SerializeMacros(macros);
+        std::vector<Macro> parsed;
+        ParseMacros(text.data(), text.size(), parsed);
+
+        // 読み直した一覧は、レイヤーごとにまとめた SavedMacroOrder の順になる
+        std::vector<size_t> order = SavedMacroOrder(macros);
+        bool same = parsed.size() == macros.size() && order.size() == macros.size();
+        for (size_t i = 0; same && i < macros.size(); i++) same = SameMacro(macros[order[i]], parsed[i]);
+        if (!same) std::fprintf(stderr, "round trip differs (seed %llu)\n", (unsigned long long)seed);
+        CHECK(same);
+        if (!same) return;
+
+        // 2回目の書き出しは1回目と同じ内容になる
+        CHECK(SerializeMacros(parsed) == text);
+    }
+}
+
+// 書き出した内容を途中で切ったり、バイトを書き換えたりしても読み込みが落ちず、
+// 残ったマクロはどれも発動条件と実行内容を持つ
+static void TestCorruptedInput() {
+    for (uint64_t seed = 1; seed <= 500; seed++) {
+        TestRandom rng(seed);
+        std::vector<Macro> macros(1 + rng.Below(6));
+        for (Macro& m : macros) m = RandomMacro(rng);
+        std::string text = SerializeMacros(macros);
+
+        // 切り詰めた内容は、ちょうどその長さのバッファに入れて読む（範囲外を読めば ASan で分かる）
+        std::string truncated = text.substr(0, rng.Below((uint32_t)text.size() + 1));
+        std::vector<char> exact(truncated.begin(), truncated.end());
+        std::vector<Macro> parsed;
+        ParseMacros(exact.data(), exact.size(), parsed);
+        for (const Macro& m : parsed) CHECK(!m.actions.empty());
+
+        for (uint32_t i = 1 + rng.Below(16); i > 0; i--) text[rng.Below((uint32_t)text.size())] = (char)rng.Below(256);
+        exact.assign(text.begin(), text.end());
+        ParseMacros(exact.data(), exact.size(), parsed);
+        for (const Macro& m : parsed) CHECK(!m.actions.empty());
+
+        // v1 として読んでも落ちない
+        std::string v1 = text.substr(text.find('\n') + 1);
+        exact.assign(v1.begin(), v1.end());
+        ParseMacros(exact.data(), exact.size(), parsed);
+    }
+}
+
+static void TestV1() {
+    // 同じホットキーの行は1つのマクロにまとまり、BOM と CRLF を受け付ける
+    const std::string v1 = "\xEF\xBB\xBF" "0x11, 0x41, COMBO, 17:67\r\n"
+                           "0x11, 0x41, WAIT, 100\r\n"
+                           "# comment\r\n"
+                           "0x12, TEXT, hello\r\n"
+                           "0x11, 0x41, POLICY, restart\r\n"
+                           "0x11, 0x41, TEXT, a, b\r\n";
+    std::vector<Macro> macros;
+    ParseMacros(v1.data(), v1.size(), macros);
+    CHECK_EQ(macros.size(), (size_t)2);
+    if (macros.size() == 2) {
+        CHECK(macros[0].hotkeys == std::vector<VkCode>({ 0x11, 0x41 }));
+        CHECK_EQ(macros[0].actions.size(), (size_t)2);
+        CHECK(macros[0].concurrency == CONCURRENCY_RESTART);
+        CHECK(macros[0].actions[0].comboKeys == std::vector<VkCode>({ 17, 67 }));
+        // v1 の種類とデータは最後の2つのカンマで区切るので、カンマを含む TEXT の行は読めない
+        CHECK(macros[1].actions[0].text == "hello");
+    }
+    if (macros.size() != 2) return;
+
+    // v2 で書き直すと、カンマや改行を含む TEXT もそのまま残る
+    macros[1].actions[0].text = "a, b\nc";
+    std::string v2 = SerializeMacros(macros);
+    std::vector<Macro> parsed;
+    ParseMacros(v2.data(), v2.size(), parsed);
+    CHECK_EQ(parsed.size(), (size_t)2);
+    if (parsed.size() == 2) CHECK(parsed[1].actions[0].text == "a, b\nc");
+}
+
+// UI で入力したレイヤー名は、保存して読み直しても同じ名前（同じ LayerId）になる
+static void TestLayerNames() {
+    const char* typed[] = { " 編集 ", "nav\t", "  ", "a b", "x\ny" };
+    for (const char* name : typed) {
+        Macro m;
+        m.hotkeys.push_back('A');
+        m.layer = NormalizeLayerName(name);
+        MacroAction toggle = { ACTION_LAYER_TOGGLE, {}, m.layer.empty() ? std::string("base") : m.layer, 0 };
+        m.actions.push_back(toggle);
+
+        std::string text = SerializeMacros(std::vector<Macro>(1, m));
+        std::vector<Macro> parsed;
+        ParseMacros(text.data(), text.size(), parsed);
+        CHECK_EQ(parsed.size(), (size_t)1);
+        if (parsed.size() != 1) continue;
+        CHECK(parsed[0].layer == m.layer);
+        CHECK_EQ(LayerId(parsed[0].actions[0].text), LayerId(toggle.text));
+    }
+    CHECK(NormalizeLayerName(" 編集 ") == "編集");
+    CHECK(NormalizeLayerName("  ").empty());
+    CHECK(NormalizeLayerName("x\ny") == "x");
+}
+
+// レイヤーが入り混じった一覧も、基本レイヤー → レイヤーごとに1つのまとまりで書く（まとまりの中は元の順）
+static void TestLayerGrouping() {
+    const char* layers[] = { "", "nav", "", "編集", "nav", "" };
+    std::vector<Macro> macros;
+    for (size_t i = 0; i < 6; i++) {
+        Macro m;
+        m.hotkeys.push_back((VkCode)('A' + i));
+        m.layer = layers[i];
+        m.actions.push_back({ ACTION_COMBO, { 'X' }, "", 0 });
+        macros.push_back(m);
+    }
+    std::string text = SerializeMacros(macros);
+    CHECK_EQ(text.find("LAYER nav\n"), text.rfind("LAYER nav\n"));
+    CHECK(text.find("LAYER nav\n") < text.find("LAYER 編集\n"));
+    CHECK(text.find("LAYER\n") == std::string::npos);
+
+    std::vector<Macro> parsed;
+    ParseMacros(text.data(), text.size(), parsed);
+    const VkCode expected[] = { 'A', 'C', 'F', 'B', 'E', 'D' };
+    CHECK_EQ(parsed.size(), (size_t)6);
+    for (size_t i = 0; i < parsed.size() && i < 6; i++) {
+        CHECK_EQ(parsed[i].hotkeys[0], expected[i]);
+        CHECK(parsed[i].layer == macros[expected[i] - 'A'].layer);
+    }
+}
+
+int main() {
+    TestRoundTrip();
+    TestLayerGrouping();
+    TestCorruptedInput();
+    TestV1();
+    TestLayerNames();
+    return TestResult();
+}
@@ -0,0 +1,77 @@
+// レイヤーの積み重ね (LayerStackPublisher) の切り替えと、別のスレッドからの読み出し
+
+#include <atomic>
+#include <thread>
+
+#include "engine/macro_layers.h"
+#include "tests/test_util.h"
+
+static void TestSwitching() {
+    LayerStackPublisher layers;
+    CHECK_EQ(layers.Current().count, 0u);
+
+    layers.Push(1);
+    layers.Toggle(2);
+    LayerStack s = layers.Current();
+    CHECK(s.count == 2 && s.ids[0] == 1 && s.ids[1] == 2);
+
+    // 既に有効なレイヤーを積むと一番上へ移る
+    layers.Push(1);
+    s = layers.Current();
+    CHECK(s.count == 2 && s.ids[0] == 2 && s.ids[1] == 1);
+
+    layers.Toggle(1);
+    layers.Remove(3); // 有効でなければ何もしない
+    s = layers.Current();
+    CHECK(s.count == 1 && s.ids[0] == 2);
+
+    // 積みきれないときは一番下のレイヤーを外す
+    for (uint32_t id = 10; id < 10 + kMaxActiveLayers; id++) layers.Push(id);
+    s = layers.Current();
+    CHECK_EQ(s.count, (uint32_t)kMaxActiveLayers);
+    CHECK(!s.Contains(2) && s.ids[0] == 10 && s.ids[kMaxActiveLayers - 1] == 10 + kMaxActiveLayers - 1);
+
+    layers.Push(0); // 基本レイヤーは積まない
+    CHECK(!layers.Current().Contains(0));
+}
+
+// 切り替えと同時に読んでも、途中まで書き換えた積み重ね（同じレイヤーが2回出てくるなど）は見えない
+// 確率的なテストで、1 CPU の環境では重なりがほとんど起きない
+static void TestConcurrentRead() {
+    LayerStackPublisher layers;
+    std::atomic<bool> done(false);
+    std::atomic<int> torn(0);
+
+    std::thread reader([&] {
+        while (!done.load(std::memory_order_acquire)) {
+            LayerStack s = layers.Current();
+            bool ok = s.count <= kMaxActiveLayers;
+            for (uint32_t i = 0; ok && i < s.count; i++) {
+                if (s.ids[i] == 0 || s.ids[i] > kMaxActiveLayers) ok = false;
+                for (uint32_t j = 0; j < i; j++) {
+                    if (s.ids[i] == s.ids[j]) ok = false;
+                }
+            }
+            if (!ok) torn.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    // 書き込むのは1つのスレッド（フックのスレッドの代わり）だけ
+    uint32_t state = 1;
+    for (int i = 0; i < 50000; i++) {
+        state = state * 1103515245u + 12345u;
+        uint32_t id = 1 + (state >> 16) % kMaxActiveLayers;
+        if ((state >> 8) % 4 == 0) layers.Toggle(id);
+        else layers.Push(id);
+        if (i % 64 == 0) std::this_thread::yield();
+    }
+    done.store(true, std::memory_order_release);
+    reader.join();
+    CHECK_EQ(torn.load(), 0);
+}
+
+int main() {
+    TestSwitching();
+    TestConcurrentRead();
+    return TestResult();
+}
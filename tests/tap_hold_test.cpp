@@ -0,0 +1,222 @@
+// タップとホールドで役割の変わるキー（デュアルロールキー）の判定
+// イベントの時刻を指定して TapHoldTracker に渡し（タイマーの呼び出しも時刻で模擬する）、
+// フックがする手順の並びを確かめる。
+
+#include <string>
+#include <vector>
+
+#include "engine/macro_table.h"
+#include "engine/tap_hold.h"
+#include "tests/test_util.h"
+
+static const int64_t kMs = 1000000;
+
+// key を短く押すと combo、押し続けると holdKey
+static Macro MakeDualRole(VkCode key, VkCode holdKey, std::vector<VkCode> combo, bool permissive = true) {
+    Macro m;
+    m.hotkeys.push_back(key);
+    m.holdKey = holdKey;
+    m.tapTimeoutMs = 200;
+    m.permissiveHold = permissive;
+    m.actions.push_back({ ACTION_COMBO, combo, "", 0 });
+    return m;
+}
+
+// 時刻を決めてイベントを渡し、結果を文字列にして並べる
+//   p+C : 止めずにそのまま通した
+//   s+C : 送る (TAP_HOLD_SEND)        h+C : ホールドの代わりのキー (TAP_HOLD_HOLD_KEY)
+//   d+C : 判定に通し直す (TAP_HOLD_DISPATCH)  m0 : マクロ 0 を実行側に積む (TAP_HOLD_MACRO)
+class Timeline {
+public:
+    explicit Timeline(const std::vector<Macro>& macros) : table_(BuildMacroTable(macros)) {}
+
+    std::string Down(VkCode vk, int64_t ms, bool isRepeat = false) { return Key(vk, true, isRepeat, ms); }
+    std::string Up(VkCode vk, int64_t ms) { return Key(vk, false, false, ms); }
+    // フックのタイマーが ms の時刻に呼ばれた
+    std::string Timeout(int64_t ms) {
+        const DispatchTable& d = *table_->layers[0];
+        TapHoldOutput out;
+        tracker_.OnTimeout(d.tapHold, d.generation, ms * kMs, out);
+        return Describe(out);
+    }
+    const TapHoldTracker& Tracker() const { return tracker_; }
+
+private:
+    std::string Key(VkCode vk, bool down, bool isRepeat, int64_t ms) {
+        const DispatchTable& d = *table_->layers[0];
+        TapHoldOutput out;
+        bool block = tracker_.OnKeyEvent(d.tapHold, d.generation, vk, down, isRepeat, ms * kMs, out);
+        if (!block) return std::string(down ? "p+" : "p-") + Name(vk);
+        return Describe(out);
+    }
+
+    static std::string Name(VkCode vk) {
+        if (vk == VKC_ESCAPE) return "Esc";
+        if (vk == VKC_LCONTROL) return "LCtrl";
+        if (vk == VKC_NONCONVERT) return "NC";
+        if (vk >= VKC_F1 && vk <= VKC_F1 + 8) return "F" + std::to_string(vk - VKC_F1 + 1);
+        return std::string(1, (char)vk);
+    }
+
+    static std::string Describe(const TapHoldOutput& out) {
+        static const char prefix[] = { 's', 'h', 'd', 'm' };
+        std::string s;
+        for (uint32_t i = 0; i < out.count; i++) {
+            const TapHoldStep& step = out.steps[i];
+            if (!s.empty()) s += ' ';
+            s += prefix[step.type];
+            if (step.type == TAP_HOLD_MACRO) {
+                s += std::to_string(step.macro);
+            } else {
+                s += step.event.type == EVENT_KEY_DOWN ? '+' : '-';
+                s += Name(step.event.code);
+            }
+        }
+        return s;
+    }
+
+    std::unique_ptr<MacroTable> table_;
+    TapHoldTracker tracker_;
+};
+
+// 無変換: タップで Esc、ホールドで左Ctrl (200ms)。F1: タップでマクロ（TEXT）、ホールドで左Ctrl
+static std::vector<Macro> DualRoleMacros(bool permissive) {
+    std::vector<Macro> macros;
+    macros.push_back(MakeDualRole(VKC_NONCONVERT, VKC_LCONTROL, { VKC_ESCAPE }, permissive));
+    Macro text = MakeDualRole(VKC_F1, VKC_LCONTROL, {}, permissive);
+    text.actions[0] = { ACTION_TEXT, {}, "hi", 0 };
+    macros.push_back(text);
+    return macros;
+}
+
+static void TestTap() {
+    Timeline t(DualRoleMacros(true));
+    CHECK_EQ(t.Down(VKC_NONCONVERT, 0), "");
+    CHECK_EQ(t.Down(VKC_NONCONVERT, 30, true), ""); // 判定待ちの間のキーリピート
+    CHECK_EQ(t.Up(VKC_NONCONVERT, 199), "s+Esc s-Esc");
+    CHECK(!t.Tracker().Busy());
+
+    // COMBO 以外のタップはマクロとして積む
+    CHECK_EQ(t.Down(VKC_F1, 1000), "");
+    CHECK_EQ(t.Up(VKC_F1, 1050), "m1");
+    CHECK_EQ(t.Timeout(1300), "");
+}
+
+static void TestHold() {
+    // 次のイベントが来なくても、タイマーでホールドに決まる
+    Timeline t(DualRoleMacros(true));
+    CHECK_EQ(t.Down(VKC_NONCONVERT, 0), "");
+    CHECK(t.Tracker().Undecided());
+    CHECK_EQ(t.Tracker().DeadlineNs(), 200 * kMs);
+    CHECK_EQ(t.Timeout(199), ""); // 早すぎるタイマーでは決めない
+    CHECK_EQ(t.Timeout(200), "h+LCtrl");
+    CHECK(!t.Tracker().Undecided());
+    CHECK_EQ(t.Down(VKC_NONCONVERT, 230, true), ""); // ホールド中のキーリピート
+    CHECK_EQ(t.Down('C', 250), "p+C");
+    CHECK_EQ(t.Up('C', 260), "p-C");
+    CHECK_EQ(t.Up(VKC_NONCONVERT, 300), "h-LCtrl");
+    CHECK(!t.Tracker().Busy());
+
+    // タイマーより先に、タップの時間を過ぎて次のキーが届いた
+    CHECK_EQ(t.Down(VKC_NONCONVERT, 1000), "");
+    CHECK_EQ(t.Down('C', 1250), "h+LCtrl d+C");
+    CHECK_EQ(t.Up('C', 1260), "p-C");
+    CHECK_EQ(t.Up(VKC_NONCONVERT, 1300), "h-LCtrl");
+
+    // 止めていたキーがあるままタイマーでホールドに決まると、止めていたキーは後から判定に通す
+    CHECK_EQ(t.Down(VKC_NONCONVERT, 2000), "");
+    CHECK_EQ(t.Down('C', 2050), "");
+    CHECK_EQ(t.Down('C', 2100, true), ""); // 判定待ちの間は他のキーのキーリピートも捨てる
+    CHECK_EQ(t.Timeout(2200), "h+LCtrl d+C");
+    CHECK_EQ(t.Up('C', 2260), "p-C");
+    CHECK_EQ(t.Up(VKC_NONCONVERT, 2300), "h-LCtrl");
+}
+
+static void TestPermissiveHold() {
+    // 後から押したキーを、判定待ちのキーより先に離した → タップの時間内でもホールド
+    Timeline t(DualRoleMacros(true));
+    CHECK_EQ(t.Down(VKC_NONCONVERT, 0), "");
+    CHECK_EQ(t.Down('C', 50), "");
+    CHECK_EQ(t.Up('C', 80), "h+LCtrl d+C d-C");
+    CHECK_EQ(t.Up(VKC_NONCONVERT, 100), "h-LCtrl");
+
+    // 同じ順番でも permissiveHold でなければ、タップの時間内に離せばタップ
+    Timeline strict(DualRoleMacros(false));
+    CHECK_EQ(strict.Down(VKC_NONCONVERT, 0), "");
+    CHECK_EQ(strict.Down('C', 50), "");
+    CHECK_EQ(strict.Up('C', 80), "");
+    CHECK_EQ(strict.Up(VKC_NONCONVERT, 100), "s+Esc s-Esc d+C d-C");
+}
+
+static void TestInterrupt() {
+    // 後から押したキーより先に判定待ちのキーを離した（打ち急ぎ） → タップの後に押したキー
+    Timeline t(DualRoleMacros(true));
+    CHECK_EQ(t.Down(VKC_NONCONVERT, 0), "");
+    CHECK_EQ(t.Down('C', 50), "");
+    CHECK_EQ(t.Up(VKC_NONCONVERT, 80), "s+Esc s-Esc d+C");
+    CHECK_EQ(t.Up('C', 100), "p-C");
+
+    // タップのマクロも、止めていたキーより先に積む
+    CHECK_EQ(t.Down(VKC_F1, 1000), "");
+    CHECK_EQ(t.Down('C', 1010), "");
+    CHECK_EQ(t.Up(VKC_F1, 1020), "m1 d+C");
+    CHECK_EQ(t.Up('C', 1030), "p-C");
+
+    // 判定待ちのキーより前から押していたキーを離しただけなら、判定を待たずに通す
+    CHECK_EQ(t.Down('A', 2000), "p+A");
+    CHECK_EQ(t.Down(VKC_NONCONVERT, 2010), "");
+    CHECK_EQ(t.Up('A', 2020), "p-A");
+    CHECK_EQ(t.Up(VKC_NONCONVERT, 2030), "s+Esc s-Esc");
+
+    // 判定待ちの間に別のデュアルロールキーを押した: 前のキーがタップに決まってから、後のキーの判定を始める
+    CHECK_EQ(t.Down(VKC_NONCONVERT, 3000), "");
+    CHECK_EQ(t.Down(VKC_F1, 3010), "");
+    CHECK_EQ(t.Up(VKC_NONCONVERT, 3020), "s+Esc s-Esc");
+    CHECK(t.Tracker().Undecided());
+    CHECK_EQ(t.Tracker().DeadlineNs(), 3210 * kMs);
+    CHECK_EQ(t.Timeout(3210), "h+LCtrl");
+    CHECK_EQ(t.Up(VKC_F1, 3300), "h-LCtrl");
+    CHECK(!t.Tracker().Busy());
+}
+
+// 止めておける数いっぱいまでタップが続いても、タップのイベントを1つも落とさない
+static void TestFullPendingTaps() {
+    std::vector<Macro> macros;
+    const VkCode combo[8] = { 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H' };
+    for (VkCode k = 0; k < 9; k++) {
+        macros.push_back(MakeDualRole((VkCode)(VKC_F1 + k), VKC_LCONTROL, std::vector<VkCode>(combo, combo + 8), false));
+    }
+    std::unique_ptr<MacroTable> table = BuildMacroTable(macros);
+    const DispatchTable& d = *table->layers[0];
+
+    TapHoldTracker tracker;
+    TapHoldOutput out;
+    int64_t t = 0;
+    CHECK(tracker.OnKeyEvent(d.tapHold, d.generation, VKC_F1, true, false, t, out));
+    // F2～F9 の押す・離すで、止めておける数 (kMaxTapHoldPending) が埋まる
+    for (VkCode k = 1; k < 9; k++) {
+        CHECK(tracker.OnKeyEvent(d.tapHold, d.generation, (VkCode)(VKC_F1 + k), true, false, t += kMs, out));
+        CHECK(tracker.OnKeyEvent(d.tapHold, d.generation, (VkCode)(VKC_F1 + k), false, false, t += kMs, out));
+        CHECK_EQ(out.count, 0u);
+    }
+    // F1 を離すと、9個のキーすべてがタップに決まる
+    CHECK(tracker.OnKeyEvent(d.tapHold, d.generation, VKC_F1, false, false, t += kMs, out));
+    CHECK_EQ(out.count, 9u * 16u);
+    CHECK(out.count <= kMaxTapHoldOutput);
+    for (uint32_t i = 0; i < out.count; i++) {
+        uint32_t n = i % 16;
+        VkCode expected = n < 8 ? combo[n] : combo[15 - n];
+        const TapHoldStep& step = out.steps[i];
+        CHECK(step.type == TAP_HOLD_SEND && step.event.code == expected && (step.event.type == EVENT_KEY_DOWN) == (n < 8));
+    }
+    CHECK(!tracker.Busy());
+}
+
+int main() {
+    TestTap();
+    TestHold();
+    TestPermissiveHold();
+    TestInterrupt();
+    TestFullPendingTaps();
+    return TestResult();
+}
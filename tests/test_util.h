@@ -0,0 +1,53 @@
+#pragma once
+
+// テスト用の最小限の確認マクロ
+// 各テストは1つの実行ファイルで、失敗した確認を表示して、失敗が1つでもあれば 1 を返します。
+//
+//   int main() {
+//       CHECK(1 + 1 == 2);
+//       CHECK_EQ(Add(1, 2), 3);
+//       return TestResult();
+//   }
+
+#include <cstdio>
+#include <iostream>
+
+// 1バイトの整数は文字ではなく数値として表示する
+template <typename T>
+const T& TestPrintable(const T& value) { return value; }
+inline int TestPrintable(char value) { return value; }
+inline int TestPrintable(signed char value) { return value; }
+inline int TestPrintable(unsigned char value) { return value; }
+
+inline int& TestFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            TestFailures()++;                                                        \
+        }                                                                            \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                   \
+    do {                                                                             \
+        auto checkActual_ = (actual);                                                \
+        auto checkExpected_ = (expected);                                            \
+        if (!(checkActual_ == checkExpected_)) {                                     \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK_EQ(" #actual ", " #expected ") failed: " \
+                      << TestPrintable(checkActual_) << " != " << TestPrintable(checkExpected_) << std::endl; \
+            TestFailures()++;                                                        \
+        }                                                                            \
+    } while (0)
+
+inline int TestResult() {
+    if (TestFailures() == 0) {
+        std::printf("OK\n");
+        return 0;
+    }
+    std::fprintf(stderr, "%d check(s) failed\n", TestFailures());
+    return 1;
+}